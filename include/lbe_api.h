@@ -0,0 +1,36 @@
+#ifndef LBE_API_H
+#define LBE_API_H
+
+/*
+ * Version and symbol visibility of liblbe142x. The shared library is built
+ * with hidden visibility, only declarations marked LBE_API are exported.
+ * Programs using the Windows DLL define LBE142X_DLL before including the
+ * headers; static builds need nothing.
+ */
+
+#define LBE142X_VERSION_MAJOR 1
+#define LBE142X_VERSION_MINOR 0
+#define LBE142X_VERSION_PATCH 0
+
+#define LBE142X_VERSION ((LBE142X_VERSION_MAJOR << 16) | (LBE142X_VERSION_MINOR << 8) | LBE142X_VERSION_PATCH)
+
+#if defined(_WIN32)
+#if defined(LBE142X_BUILDING_DLL)
+#define LBE_API __declspec(dllexport)
+#elif defined(LBE142X_DLL)
+#define LBE_API __declspec(dllimport)
+#else
+#define LBE_API
+#endif
+#elif defined(__GNUC__)
+#define LBE_API __attribute__((visibility("default")))
+#else
+#define LBE_API
+#endif
+
+/* LBE142X_VERSION of the library actually loaded, which may be newer than
+ * the headers a program was built against */
+LBE_API unsigned int lbe_version(void);
+LBE_API const char* lbe_version_string(void);
+
+#endif // LBE_API_H
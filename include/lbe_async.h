@@ -0,0 +1,38 @@
+#ifndef LBE_ASYNC_H
+#define LBE_ASYNC_H
+
+#include "lbe_device.h"
+#include "lbe_cmd.h"
+
+/*
+ * Asynchronous command submission (GNU/Linux only). Requests are queued and
+ * run by a small shared worker pool; commands for the same device are run
+ * one at a time and in submission order, different devices run in parallel.
+ * Completions are handed back to the submitting thread: the fd from
+ * lbe_async_get_fd() becomes readable (poll/epoll) when some are ready, and
+ * lbe_async_dispatch() then invokes their callbacks.
+ *
+ * Only the engine is thread safe. A device handle passed to
+ * lbe_async_submit() must not be used directly until its requests complete.
+ */
+
+#define LBE_ASYNC_DEFAULT_WORKERS 4
+#define LBE_ASYNC_MAX_WORKERS 64
+
+/* result is 0, LBE_CMD_ERR_IO or LBE_CMD_ERR_INVALID; status is only
+ * meaningful for a successful LBE_CMD_STATUS */
+typedef void (*lbe_async_cb)(struct lbe_device* dev, const struct lbe_cmd *cmd, int result,
+		const struct lbe_status *status, void *arg);
+
+struct lbe_async;
+
+struct lbe_async* lbe_async_new(int workers);
+void lbe_async_free(struct lbe_async *as);
+int lbe_async_get_fd(struct lbe_async *as);
+int lbe_async_submit(struct lbe_async *as, struct lbe_device* dev, const struct lbe_cmd *cmd,
+		lbe_async_cb cb, void *arg);
+int lbe_async_dispatch(struct lbe_async *as);
+int lbe_async_pending(struct lbe_async *as);
+int lbe_async_wait(struct lbe_async *as, int timeout_ms);
+
+#endif // LBE_ASYNC_H
@@ -0,0 +1,36 @@
+#ifndef LBE_CLOCK_H
+#define LBE_CLOCK_H
+
+/*
+ * Nanosecond timestamps used by the library and the tools: the performance
+ * counter on Windows, clock_gettime() elsewhere. Not installed.
+ */
+
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <windows.h>
+
+static inline uint64_t lbe_now_ns(void) {
+	static LARGE_INTEGER freq;
+	LARGE_INTEGER counter;
+
+	if (!freq.QuadPart) QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&counter);
+	return (uint64_t)((double)counter.QuadPart * 1e9 / (double)freq.QuadPart);
+}
+#else
+#include <time.h>
+
+static inline uint64_t lbe_clock_ns(clockid_t clock) {
+	struct timespec ts;
+
+	clock_gettime(clock, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* CLOCK_MONOTONIC */
+static inline uint64_t lbe_now_ns(void) { return lbe_clock_ns(CLOCK_MONOTONIC); }
+#endif
+
+#endif // LBE_CLOCK_H
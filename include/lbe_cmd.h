@@ -0,0 +1,46 @@
+#ifndef LBE_CMD_H
+#define LBE_CMD_H
+
+#include "lbe_device.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Line oriented command protocol shared by lbe142xd and its clients.
+ * One command per line, named after the CLI options without the dashes:
+ *   f1 <freq>, f1t <freq>, f2 <freq>, f2t <freq>, out <0|1>, pll <0|1>,
+ *   pps <0|1>, pwr1 <0|1>, pwr2 <0|1>, blink, status
+ * Replies are a single line: "OK", "OK <key=value ...>" for status or
+ * "ERR <reason>".
+ */
+
+#define LBE_CMD_LINE_MAX 256
+
+/* lbe_cmd_execute() error codes */
+#define LBE_CMD_ERR_IO      (-1) // feature report failed
+#define LBE_CMD_ERR_INVALID (-2) // command not valid for this model/value
+
+enum lbe_cmd_op {
+	LBE_CMD_NONE = 0,
+	LBE_CMD_SET_FREQ,
+	LBE_CMD_SET_FREQ_TEMP,
+	LBE_CMD_OUTPUTS,
+	LBE_CMD_PLL,
+	LBE_CMD_PPS,
+	LBE_CMD_POWER,
+	LBE_CMD_BLINK,
+	LBE_CMD_STATUS
+};
+
+struct lbe_cmd {
+	enum lbe_cmd_op op;
+	int output;     // 1 or 2 for frequency/power commands
+	uint32_t value; // frequency in Hz or 0/1 flag
+};
+
+int lbe_cmd_parse(const char *line, struct lbe_cmd *cmd);
+int lbe_cmd_execute(struct lbe_device* dev, const struct lbe_cmd *cmd, struct lbe_status *status);
+int lbe_cmd_format_status(const struct lbe_status *status, char *buf, size_t len);
+int lbe_cmd_run_line(struct lbe_device* dev, const char *line, char *reply, size_t len);
+
+#endif // LBE_CMD_H
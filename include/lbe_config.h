@@ -0,0 +1,47 @@
+#ifndef LBE_CONFIG_H
+#define LBE_CONFIG_H
+
+#include "lbe_device.h"
+#include "lbe_cmd.h"
+#include <stdint.h>
+
+/*
+ * Declarative device configuration. Only the fields flagged in `set` are
+ * managed; lbe_apply_config() reads the live status once and only sends the
+ * reports needed to reach the target state.
+ *
+ * Config files hold one "key = value" per line, '#' starts a comment:
+ *   f1, f2          frequency in Hz
+ *   persist         1 to save frequencies to flash, 0 (default) for temporary;
+ *                   with 1, f1/f2 are written even when already running
+ *   out, pll, pps, pwr1, pwr2   0/1, same meaning as the CLI options
+ */
+
+#define LBE_CONFIG_F1      (1U << 0)
+#define LBE_CONFIG_F2      (1U << 1)
+#define LBE_CONFIG_OUTPUTS (1U << 2)
+#define LBE_CONFIG_FLL     (1U << 3)
+#define LBE_CONFIG_PPS     (1U << 4)
+#define LBE_CONFIG_PWR1    (1U << 5)
+#define LBE_CONFIG_PWR2    (1U << 6)
+
+#define LBE_CONFIG_MAX_CMDS 8
+
+struct lbe_config {
+	unsigned int set;
+	int persist;
+	uint32_t frequency1;
+	uint32_t frequency2;
+	int outputs_enabled;
+	int fll_enabled;
+	int pps_enabled;
+	int out1_power_low;
+	int out2_power_low;
+};
+
+int lbe_config_load(const char *path, struct lbe_config *cfg);
+int lbe_config_diff(const struct lbe_config *cfg, const struct lbe_status *status, enum lbe_model model,
+		struct lbe_cmd *cmds, int max);
+int lbe_apply_config(struct lbe_device* dev, const struct lbe_config *cfg);
+
+#endif // LBE_CONFIG_H
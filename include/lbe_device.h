@@ -1,6 +1,8 @@
 #ifndef LBE_DEVICE_H
 #define LBE_DEVICE_H
 
+#include "lbe_api.h"
+#include <stddef.h>
 #include <stdint.h>
 
 struct lbe_device;
@@ -23,17 +25,73 @@ struct lbe_status {
     int out2_power_low;
 };
 
-struct lbe_device* lbe_open_device(void);
-void lbe_close_device(struct lbe_device* dev);
-enum lbe_model lbe_get_model(struct lbe_device* dev);
-int lbe_get_device_status(struct lbe_device* dev, struct lbe_status* status);
-int lbe_set_frequency(struct lbe_device* dev, int output, uint32_t frequency);
-int lbe_set_outputs_enable(struct lbe_device* dev, int enable);
-int lbe_blink_leds(struct lbe_device* dev);
-int lbe_set_frequency_temp(struct lbe_device* dev, int output, uint32_t frequency);
-int lbe_set_pll_mode(struct lbe_device* dev, int fll_mode);
-int lbe_set_fll_mode(struct lbe_device* dev, int fll_mode);
-int lbe_set_1pps(struct lbe_device* dev, int enable);
-int lbe_set_power_level(struct lbe_device* dev, int output, int low_power);
+/* Feature reports in the hidraw layout: byte 0 is the command code for SET
+ * reports and the report id for the status GET */
+#define LBE_REPORT_SIZE 60
+#define LBE_STATUS_REPORT_ID 0x4B
+
+/* A SET report encoded ahead of time by lbe_prepare_*() */
+struct lbe_report {
+	uint8_t buf[LBE_REPORT_SIZE];
+};
+
+#define LBE_PATH_MAX 64
+#define LBE_SERIAL_MAX 64
+
+struct lbe_device_info {
+    char path[LBE_PATH_MAX];     // node passed to lbe_open_device_path(), e.g. /dev/hidraw3
+    char usb_path[LBE_PATH_MAX]; // USB bus-port path, e.g. 1-2.3
+    char serial[LBE_SERIAL_MAX];
+    uint16_t vendor_id;
+    uint16_t product_id;
+    enum lbe_model model;
+};
+
+/*
+ * Advisory cross-process lock on a unit. It is keyed on the device node, so
+ * every process opening the same unit contends for it. Status readers take
+ * it shared, command sequences take it exclusive. Transports without
+ * locking support (libusb, simulator) always succeed.
+ */
+enum lbe_lock_mode {
+	LBE_LOCK_UNLOCKED = 0,
+	LBE_LOCK_SHARED,
+	LBE_LOCK_EXCLUSIVE
+};
+
+#define LBE_LOCK_WAIT_FOREVER -1
+
+struct lbe_lock_stats {
+	uint64_t acquired;
+	uint64_t contended;      // acquisitions that had to wait
+	uint64_t timeouts;
+	uint64_t wait_ns;        // total time spent waiting
+	uint64_t max_wait_ns;
+};
+
+LBE_API int lbe_enumerate_devices(struct lbe_device_info *list, int max);
+LBE_API struct lbe_device* lbe_open_device(void);
+/* path is a lbe_device_info path; NULL opens the first unit, like lbe_open_device() */
+LBE_API struct lbe_device* lbe_open_device_path(const char *path);
+LBE_API const char* lbe_get_path(struct lbe_device* dev);
+LBE_API void lbe_close_device(struct lbe_device* dev);
+LBE_API enum lbe_model lbe_get_model(struct lbe_device* dev);
+LBE_API int lbe_get_device_status(struct lbe_device* dev, struct lbe_status* status);
+LBE_API int lbe_get_raw_report(struct lbe_device* dev, uint8_t *buf, size_t len);
+LBE_API void lbe_decode_status(enum lbe_model model, const uint8_t *report, struct lbe_status* status);
+LBE_API void lbe_decode_device_report(struct lbe_device* dev, const uint8_t *report, struct lbe_status* status);
+LBE_API int lbe_set_frequency(struct lbe_device* dev, int output, uint32_t frequency);
+LBE_API int lbe_set_outputs_enable(struct lbe_device* dev, int enable);
+LBE_API int lbe_blink_leds(struct lbe_device* dev);
+LBE_API int lbe_set_frequency_temp(struct lbe_device* dev, int output, uint32_t frequency);
+LBE_API int lbe_set_pll_mode(struct lbe_device* dev, int fll_mode);
+LBE_API int lbe_set_1pps(struct lbe_device* dev, int enable);
+LBE_API int lbe_set_power_level(struct lbe_device* dev, int output, int low_power);
+LBE_API int lbe_prepare_frequency_temp(struct lbe_device* dev, int output, uint32_t frequency, struct lbe_report *report);
+LBE_API int lbe_prepare_outputs_enable(struct lbe_device* dev, int enable, struct lbe_report *report);
+LBE_API int lbe_send_prepared(struct lbe_device* dev, const struct lbe_report *report);
+LBE_API int lbe_lock_device(struct lbe_device* dev, enum lbe_lock_mode mode, int timeout_ms);
+LBE_API int lbe_unlock_device(struct lbe_device* dev);
+LBE_API void lbe_get_lock_stats(struct lbe_device* dev, struct lbe_lock_stats *stats);
 
 #endif // LBE_DEVICE_H
@@ -0,0 +1,59 @@
+#ifndef LBE_EVENTS_H
+#define LBE_EVENTS_H
+
+#include "lbe_device.h"
+#include <stdint.h>
+
+/*
+ * Edge-triggered change detection on top of lbe_get_device_status().
+ * Feed every sample to lbe_events_update(); callbacks only fire when a
+ * tracked field differs from the previous sample, together with how long
+ * the previous state lasted.
+ */
+
+enum lbe_event_type {
+	LBE_EVENT_GPS_LOCK_LOST = 0,
+	LBE_EVENT_GPS_LOCK_ACQUIRED,
+	LBE_EVENT_PLL_LOCK_LOST,
+	LBE_EVENT_PLL_LOCK_ACQUIRED,
+	LBE_EVENT_ANTENNA_SHORT,
+	LBE_EVENT_ANTENNA_OK,
+	LBE_EVENT_OUTPUTS_DISABLED,
+	LBE_EVENT_OUTPUTS_ENABLED,
+	LBE_EVENT_PPS_DISABLED,
+	LBE_EVENT_PPS_ENABLED,
+	LBE_EVENT_MODE_CHANGED,      // new_value 0 = PLL, 1 = FLL
+	LBE_EVENT_POWER_CHANGED,     // new_value 0 = normal, 1 = low
+	LBE_EVENT_FREQUENCY_CHANGED,
+	LBE_EVENT_COUNT
+};
+
+#define LBE_EVENT_MASK(type) (1U << (type))
+#define LBE_EVENT_MASK_ALL   ((1U << LBE_EVENT_COUNT) - 1)
+
+struct lbe_event {
+	enum lbe_event_type type;
+	uint64_t timestamp_ns;      // timestamp of the sample that showed the change
+	uint64_t prior_duration_ns; // how long the previous state was held
+	int output;                 // 1 or 2 for power/frequency events, 0 otherwise
+	uint32_t old_value;
+	uint32_t new_value;
+};
+
+typedef void (*lbe_event_cb)(const struct lbe_event *event, void *arg);
+
+#define LBE_EVENT_FIELDS 10
+
+struct lbe_event_tracker {
+	uint32_t mask;
+	int have_prev;
+	struct lbe_status prev;
+	uint64_t since_ns[LBE_EVENT_FIELDS]; // when each tracked field last changed
+};
+
+void lbe_events_init(struct lbe_event_tracker *tracker, uint32_t mask);
+int lbe_events_update(struct lbe_event_tracker *tracker, const struct lbe_status *status,
+		uint64_t timestamp_ns, lbe_event_cb cb, void *arg);
+const char* lbe_event_name(enum lbe_event_type type);
+
+#endif // LBE_EVENTS_H
@@ -0,0 +1,61 @@
+#ifndef LBE_FAILOVER_H
+#define LBE_FAILOVER_H
+
+#include "lbe_device.h"
+#include "lbe_histogram.h"
+#include <signal.h>
+#include <stdint.h>
+
+/*
+ * Primary/standby reference supervisor (GNU/Linux only). Both units are
+ * polled on a fixed schedule; exactly one has its outputs enabled. A unit is
+ * unhealthy when its GPS or PLL lock bit is clear or its status read fails.
+ *
+ * Hysteresis: the active unit must be unhealthy for fail_samples polls in a
+ * row before outputs move, and a unit must be healthy for recover_samples
+ * polls in a row before outputs may move (back) to it. The worst-case
+ * reaction time is therefore about fail_samples / rate_hz plus two reports.
+ */
+
+#define LBE_FAILOVER_PRIMARY 0
+#define LBE_FAILOVER_STANDBY 1
+
+struct lbe_failover_opts {
+	double rate_hz;               // polls per second of each unit
+	uint32_t fail_samples;        // consecutive bad polls before switching away
+	uint32_t recover_samples;     // consecutive good polls before a unit is eligible
+	int revert;                   // move back to the primary once it is eligible
+	volatile sig_atomic_t *stop;  // optional, set from a signal handler
+	int lock;                     // take the device lock exclusive around each output report
+	int lock_wait_ms;             // bounded wait for it, a timeout counts as a report error
+};
+
+struct lbe_failover_switch {
+	int from;                     // LBE_FAILOVER_PRIMARY or LBE_FAILOVER_STANDBY
+	int to;
+	int reverted;                 // back to a recovered primary, not a failure
+	int read_failed;              // the failed unit stopped answering
+	uint8_t raw_status;           // last status of the unit switched away from
+	uint64_t detect_ns;           // CLOCK_MONOTONIC of the first bad/good poll in the streak
+	uint64_t decide_ns;           // poll that completed the streak
+	uint64_t switched_ns;         // both output reports completed
+	int errors;                   // output reports that failed
+};
+
+struct lbe_failover_stats {
+	uint64_t polls;
+	uint64_t read_errors;
+	uint64_t switches;
+	uint64_t switch_errors;
+	uint64_t deadline_misses;     // polls started a full period late
+	struct lbe_histogram detect_to_switch; // ns, failures only
+	struct lbe_histogram decide_to_switch; // ns, time spent sending the reports
+	double elapsed_s;
+};
+
+typedef void (*lbe_failover_cb)(const struct lbe_failover_switch *sw, void *arg);
+
+int lbe_failover_run(struct lbe_device* units[2], const struct lbe_failover_opts *opts,
+		lbe_failover_cb cb, void *arg, struct lbe_failover_stats *stats);
+
+#endif // LBE_FAILOVER_H
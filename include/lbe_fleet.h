@@ -0,0 +1,44 @@
+#ifndef LBE_FLEET_H
+#define LBE_FLEET_H
+
+#include "lbe_device.h"
+#include "lbe_cmd.h"
+
+/*
+ * Multi-device support (GNU/Linux only): select units out of an enumeration
+ * and run the same job on all of them from a pool of worker threads, so
+ * configuring N units takes about as long as configuring one.
+ *
+ * Selectors are comma separated terms:
+ *   all            every unit found
+ *   serial:<str>   USB serial number
+ *   path:<node>    device node, e.g. path:/dev/hidraw3
+ *   usb:<port>     USB bus-port path, e.g. usb:1-2.3
+ *   <value>        any of the above, or the node name without /dev/
+ */
+
+#define LBE_FLEET_MAX_DEVICES 64
+
+struct lbe_fleet_result {
+	struct lbe_device_info info;
+	int result;          // 0 on success, -1 if the device or a command failed
+	int commands_ok;
+	int commands_failed;
+	int have_status;     // status holds the last status read by the job
+	struct lbe_status status;
+	double elapsed_ms;   // open + job + close
+};
+
+typedef int (*lbe_fleet_job)(struct lbe_device* dev, void *arg, struct lbe_fleet_result *result);
+
+int lbe_select_devices(const char *selector, const struct lbe_device_info *all, int count,
+		struct lbe_device_info *out, int max);
+int lbe_fleet_run(const struct lbe_device_info *devices, int count, int workers,
+		lbe_fleet_job job, void *arg, struct lbe_fleet_result *results);
+int lbe_fleet_exec_commands(struct lbe_device* dev, const struct lbe_cmd *cmds, int ncmds,
+		struct lbe_fleet_result *result);
+int lbe_fleet_run_commands(const struct lbe_device_info *devices, int count, int workers,
+		const struct lbe_cmd *cmds, int ncmds, enum lbe_lock_mode lock_mode, int lock_wait_ms,
+		struct lbe_fleet_result *results);
+
+#endif // LBE_FLEET_H
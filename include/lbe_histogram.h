@@ -0,0 +1,35 @@
+#ifndef LBE_HISTOGRAM_H
+#define LBE_HISTOGRAM_H
+
+#include "lbe_api.h"
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Log-linear latency histogram: values below 16 are exact, above that every
+ * power of two is split into 16 buckets (~6% resolution) up to 2^40 ns.
+ * Recording is a couple of shifts and an increment, no allocation.
+ */
+
+#define LBE_HIST_SUB_BITS  4
+#define LBE_HIST_SUB_COUNT (1 << LBE_HIST_SUB_BITS)
+#define LBE_HIST_MAX_BITS  40
+#define LBE_HIST_BUCKETS   ((LBE_HIST_MAX_BITS - LBE_HIST_SUB_BITS + 1) * LBE_HIST_SUB_COUNT)
+
+struct lbe_histogram {
+	uint64_t count;
+	uint64_t min;
+	uint64_t max;
+	uint64_t sum;
+	uint64_t buckets[LBE_HIST_BUCKETS];
+};
+
+LBE_API void lbe_histogram_init(struct lbe_histogram *h);
+LBE_API void lbe_histogram_add(struct lbe_histogram *h, uint64_t value);
+LBE_API void lbe_histogram_merge(struct lbe_histogram *dst, const struct lbe_histogram *src);
+LBE_API uint64_t lbe_histogram_percentile(const struct lbe_histogram *h, double percentile);
+LBE_API double lbe_histogram_mean(const struct lbe_histogram *h);
+LBE_API uint64_t lbe_histogram_bucket_upper(int index);
+LBE_API void lbe_histogram_print(FILE *out, const char *label, const struct lbe_histogram *h);
+
+#endif // LBE_HISTOGRAM_H
@@ -0,0 +1,30 @@
+#ifndef LBE_HOTPLUG_H
+#define LBE_HOTPLUG_H
+
+#include "lbe_device.h"
+
+/*
+ * udev_monitor based hotplug watcher (GNU/Linux only).
+ * Keeps an in-memory table of attached LBE-142x units that is seeded by one
+ * enumeration and then updated from add/remove events, so long-running users
+ * pick up re-plugged units without scanning again.
+ */
+
+#define LBE_HOTPLUG_MAX_DEVICES 32
+
+enum lbe_hotplug_event {
+	LBE_HOTPLUG_ADDED = 0,
+	LBE_HOTPLUG_REMOVED
+};
+
+typedef void (*lbe_hotplug_cb)(enum lbe_hotplug_event event, const struct lbe_device_info *info, void *arg);
+
+struct lbe_hotplug;
+
+struct lbe_hotplug* lbe_hotplug_new(void);
+void lbe_hotplug_free(struct lbe_hotplug* hp);
+int lbe_hotplug_get_fd(struct lbe_hotplug* hp);
+int lbe_hotplug_process(struct lbe_hotplug* hp, lbe_hotplug_cb cb, void *arg);
+int lbe_hotplug_get_devices(struct lbe_hotplug* hp, struct lbe_device_info *list, int max);
+
+#endif // LBE_HOTPLUG_H
@@ -0,0 +1,16 @@
+#ifndef LBE_IPC_H
+#define LBE_IPC_H
+
+#include <stddef.h>
+
+/* Unix-domain socket transport between lbe142xd and thin clients.
+ * Requests and replies use the line protocol described in lbe_cmd.h. */
+
+#define LBE_IPC_SOCKET_NAME "lbe142xd.sock"
+
+int lbe_ipc_default_path(char *buf, size_t len);
+int lbe_ipc_listen(const char *path);
+int lbe_ipc_connect(const char *path);
+int lbe_ipc_request(int fd, const char *line, char *reply, size_t len);
+
+#endif // LBE_IPC_H
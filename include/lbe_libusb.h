@@ -0,0 +1,33 @@
+#ifndef LBE_LIBUSB_H
+#define LBE_LIBUSB_H
+
+#include "lbe_device.h"
+#include <stdint.h>
+
+/*
+ * libusb transport: HID feature reports as control transfers. It is the
+ * only transport on Windows. On GNU/Linux it is built with
+ * -DLBE_WITH_LIBUSB=ON and used instead of hidraw when LBE142X_TRANSPORT=libusb.
+ * There it claims the interface, so the unit's hidraw node is gone until the
+ * device is closed.
+ *
+ * Unlike the hidraw ioctls, every transfer has a timeout, and status reads
+ * can be queued asynchronously.
+ */
+
+#define LBE_LIBUSB_DEFAULT_TIMEOUT_MS 5000
+
+/* result is 0 with report in the hidraw layout, -1 on failure or timeout */
+typedef void (*lbe_libusb_status_cb)(int result, const uint8_t *report, void *arg);
+
+LBE_API int lbe_libusb_enumerate(struct lbe_device_info *list, int max);
+/* port_path is a bus-port path such as "1-2.3", NULL for the first unit */
+LBE_API struct lbe_device* lbe_libusb_open(const char *port_path);
+LBE_API int lbe_libusb_set_timeout(struct lbe_device *dev, unsigned int timeout_ms);
+
+/* Queue a status read, cb runs from lbe_libusb_handle_events(). Bypasses
+ * the per-device ordering of the synchronous calls. */
+LBE_API int lbe_libusb_submit_status(struct lbe_device *dev, lbe_libusb_status_cb cb, void *arg);
+LBE_API int lbe_libusb_handle_events(struct lbe_device *dev, int timeout_ms);
+
+#endif // LBE_LIBUSB_H
@@ -0,0 +1,25 @@
+#ifndef LBE_LOG_H
+#define LBE_LOG_H
+
+#include "lbe_api.h"
+#include <stdarg.h>
+
+/*
+ * Library diagnostics. Messages are single lines without a trailing newline.
+ * Without a handler they are written to stderr. lbe_set_log_handler() is
+ * meant to be called once at startup, before other threads use the library.
+ */
+
+enum lbe_log_level {
+	LBE_LOG_ERROR = 0,
+	LBE_LOG_WARNING,
+	LBE_LOG_INFO,
+	LBE_LOG_DEBUG
+};
+
+typedef void (*lbe_log_fn)(enum lbe_log_level level, const char *msg, void *arg);
+
+/* fn == NULL restores the stderr default */
+LBE_API void lbe_set_log_handler(lbe_log_fn fn, void *arg);
+
+#endif // LBE_LOG_H
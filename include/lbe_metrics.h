@@ -0,0 +1,35 @@
+#ifndef LBE_METRICS_H
+#define LBE_METRICS_H
+
+#include "lbe_device.h"
+#include "lbe_poller.h"
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+ * Prometheus/OpenMetrics exporter (GNU/Linux only). A background
+ * lbe_poller thread keeps a snapshot of every unit up to date. A scrape of
+ * /metrics only formats that snapshot, so scrapes never add USB traffic.
+ * The HTTP side is deliberately minimal: one connection at a time,
+ * GET only, Connection: close.
+ */
+
+#define LBE_METRICS_DEFAULT_LISTEN "127.0.0.1:9142"
+#define LBE_METRICS_DEFAULT_MIN_HZ 1.0
+#define LBE_METRICS_DEFAULT_MAX_HZ 20.0
+
+struct lbe_metrics_opts {
+	const char *listen;           // "<host>:<port>", "[<ipv6>]:<port>"
+	struct lbe_poller_opts poll;  // poll.stop also stops the server
+};
+
+struct lbe_metrics;
+
+struct lbe_metrics* lbe_metrics_new(struct lbe_device **devs, int count, const struct lbe_metrics_opts *opts);
+void lbe_metrics_free(struct lbe_metrics *m);
+/* Serve scrapes until *opts->poll.stop is set */
+int lbe_metrics_run(struct lbe_metrics *m);
+/* Write the current snapshot in the Prometheus (0.0.4) or OpenMetrics text format */
+int lbe_metrics_write(struct lbe_metrics *m, FILE *out, int openmetrics);
+
+#endif // LBE_METRICS_H
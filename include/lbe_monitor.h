@@ -0,0 +1,61 @@
+#ifndef LBE_MONITOR_H
+#define LBE_MONITOR_H
+
+#include "lbe_device.h"
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * timerfd driven status polling (GNU/Linux only). The device stays open and
+ * the 0x4B report is read once per timer tick; ticks that expire while a read
+ * is still in progress are counted as missed instead of being queued.
+ */
+
+#define LBE_MONITOR_MAX_RATE 10000.0
+
+struct lbe_sample {
+	uint64_t mono_ns; // CLOCK_MONOTONIC when the report was received
+	uint64_t real_ns; // CLOCK_REALTIME when the report was received
+	struct lbe_status status;
+	uint8_t report[LBE_REPORT_SIZE]; // raw report status was decoded from
+};
+
+/* Fixed size little-endian record written by --monitor --binary */
+struct lbe_sample_record {
+	uint64_t mono_ns;
+	uint64_t real_ns;
+	uint32_t frequency1;
+	uint32_t frequency2;
+	uint8_t raw_status;
+	uint8_t flags; // bit 0 FLL, bit 1 OUT1 low power, bit 2 OUT2 low power
+	uint8_t reserved[6];
+};
+
+struct lbe_monitor_opts {
+	double rate_hz;
+	uint64_t count;                    // stop after count samples, 0 = until stopped
+	volatile sig_atomic_t *stop;       // optional, set from a signal handler
+	int lock;                          // take the device lock shared around each read
+	int lock_wait_ms;                  // bounded wait for it, a tick is skipped on timeout
+};
+
+struct lbe_monitor_stats {
+	uint64_t ticks;        // timer expirations, missed ones included
+	uint64_t samples;
+	uint64_t missed_ticks;
+	uint64_t errors;
+	uint64_t lock_timeouts;  // ticks skipped because a writer held the lock
+	double elapsed_s;
+	double achieved_hz;
+};
+
+/* Return non-zero from the callback to stop monitoring */
+typedef int (*lbe_sample_cb)(const struct lbe_sample *sample, void *arg);
+
+int lbe_monitor_run(struct lbe_device* dev, const struct lbe_monitor_opts *opts,
+		lbe_sample_cb cb, void *arg, struct lbe_monitor_stats *stats);
+void lbe_sample_to_record(const struct lbe_sample *sample, struct lbe_sample_record *record);
+int lbe_sample_print(FILE *out, const struct lbe_sample *sample);
+
+#endif // LBE_MONITOR_H
@@ -0,0 +1,70 @@
+#ifndef LBE_POLLER_H
+#define LBE_POLLER_H
+
+#include "lbe_device.h"
+#include "lbe_histogram.h"
+#include <signal.h>
+#include <stdint.h>
+
+/*
+ * Adaptive status polling of several units from one thread (GNU/Linux only).
+ * Each unit has its own interval. It grows by `backoff` after every poll
+ * whose raw status and frequencies match the previous one, up to
+ * 1 / min_hz. It drops to 1 / max_hz on any change, on a read error, or
+ * when lbe_poller_kick() announces a command. A stable fleet is then polled
+ * at min_hz, and a unit that is changing is watched at max_hz.
+ *
+ * A change happened at some point after the previous poll, so detect_ns
+ * records the time between the two polls. It is an upper bound on the
+ * detection latency.
+ */
+
+#define LBE_POLLER_MAX_DEVICES 64
+#define LBE_POLLER_DEFAULT_BACKOFF 2.0
+
+struct lbe_poller_opts {
+	double min_hz;                // slowest rate, used while a unit is stable
+	double max_hz;                // fastest rate, right after a change
+	double backoff;               // interval multiplier per stable poll, > 1
+	volatile sig_atomic_t *stop;  // optional, set from a signal handler
+	int lock;                     // take the device lock shared around each read
+	int lock_wait_ms;             // bounded wait for it, the poll is retried on timeout
+};
+
+struct lbe_poller_sample {
+	int index;                    // position in the device array
+	struct lbe_device *dev;
+	uint64_t mono_ns;             // when the read completed
+	uint64_t real_ns;
+	uint64_t read_ns;             // feature report round trip
+	int failed;                   // the read failed, status is not valid
+	struct lbe_status status;
+	int changed;                  // differs from the previous successful poll
+	uint64_t interval_ns;         // time since the previous poll of this unit
+};
+
+struct lbe_poller_stats {
+	uint64_t polls;
+	uint64_t changes;
+	uint64_t errors;
+	uint64_t kicks;
+	uint64_t lock_timeouts;
+	double achieved_hz;           // polls / elapsed time
+	uint64_t interval_ns;         // current interval
+	struct lbe_histogram detect_ns; // upper bound of the detection latency per change
+};
+
+/* Return non-zero to stop polling */
+typedef int (*lbe_poller_cb)(const struct lbe_poller_sample *sample, void *arg);
+
+struct lbe_poller;
+
+struct lbe_poller* lbe_poller_new(struct lbe_device **devs, int count, const struct lbe_poller_opts *opts);
+void lbe_poller_free(struct lbe_poller *p);
+/* Poll unit index (-1: all) now and at max_hz again, e.g. before a command.
+ * Safe from any thread and from a signal handler. */
+void lbe_poller_kick(struct lbe_poller *p, int index);
+int lbe_poller_run(struct lbe_poller *p, lbe_poller_cb cb, void *arg);
+const struct lbe_poller_stats* lbe_poller_get_stats(struct lbe_poller *p, int index);
+
+#endif // LBE_POLLER_H
@@ -0,0 +1,95 @@
+#ifndef LBE_RECORD_H
+#define LBE_RECORD_H
+
+#include "lbe_device.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Append-only recording of raw 0x4B status reports.
+ *
+ * The data file is a header followed by blocks of up to
+ * LBE_REC_BLOCK_SAMPLES samples (or LBE_REC_BLOCK_NS of wall time). Each
+ * block starts with a key frame (timestamps + full report). It continues with
+ * delta frames holding only the byte runs that changed, and run frames
+ * covering stretches of identical reports. Timestamps are stored as
+ * delta-of-delta of CLOCK_MONOTONIC. Wall time is rebuilt from the block's key
+ * frame. An unchanged sample costs one varint of that delta: one byte under
+ * 64 ns of jitter, two under about 8 us, three under about 0.5 ms.
+ *
+ * Every completed block gets a fixed size entry in "<file>.idx" holding its
+ * offset, time span and GPS/PLL lock summary. Readers can then seek by time
+ * and skip blocks whose lock state did not change without decoding them.
+ * Blocks are written whole, so a crash loses at most the block in progress.
+ */
+
+#define LBE_REC_MAGIC "LBEREC1"
+#define LBE_REC_VERSION 1
+#define LBE_REC_HEADER_SIZE 32
+#define LBE_REC_INDEX_ENTRY_SIZE 48
+#define LBE_REC_INDEX_SUFFIX ".idx"
+#define LBE_REC_BLOCK_SAMPLES 4096
+#define LBE_REC_BLOCK_NS (60 * 1000000000ULL)
+
+/* Lock summary bits of an index entry */
+#define LBE_REC_LOCK_GPS 0x01
+#define LBE_REC_LOCK_PLL 0x02
+
+struct lbe_rec_sample {
+	uint64_t mono_ns;
+	uint64_t real_ns;
+	uint8_t report[LBE_REPORT_SIZE];
+};
+
+struct lbe_rec_index_entry {
+	uint64_t offset;         // block start in the data file
+	uint64_t length;         // block size in bytes
+	uint64_t first_mono_ns;
+	uint64_t first_real_ns;
+	uint64_t last_real_ns;
+	uint32_t samples;
+	uint8_t lock_any;        // LBE_REC_LOCK_* bits set in at least one sample
+	uint8_t lock_all;        // LBE_REC_LOCK_* bits set in every sample
+};
+
+uint8_t lbe_rec_lock_bits(uint8_t raw_status);
+
+/* Writer: appends to an existing recording of the same model, after
+ * dropping any block that did not make it into the index */
+struct lbe_rec_writer;
+
+struct lbe_rec_writer* lbe_rec_writer_open(const char *path, enum lbe_model model);
+int lbe_rec_writer_add(struct lbe_rec_writer *w, const struct lbe_rec_sample *sample);
+int lbe_rec_writer_close(struct lbe_rec_writer *w, uint64_t *samples, uint64_t *bytes);
+
+/* Reader */
+struct lbe_rec_reader;
+
+struct lbe_rec_reader* lbe_rec_reader_open(const char *path);
+void lbe_rec_reader_close(struct lbe_rec_reader *r);
+enum lbe_model lbe_rec_reader_model(const struct lbe_rec_reader *r);
+size_t lbe_rec_reader_index(const struct lbe_rec_reader *r, const struct lbe_rec_index_entry **entries);
+/* block == the index size seeks to the first block the index does not cover */
+int lbe_rec_reader_seek_block(struct lbe_rec_reader *r, size_t block);
+int lbe_rec_reader_seek(struct lbe_rec_reader *r, uint64_t real_ns);
+int lbe_rec_reader_next(struct lbe_rec_reader *r, struct lbe_rec_sample *sample);
+
+/* Threaded recorder (GNU/Linux only): the poller pushes samples into a
+ * single-producer/single-consumer lock-free ring, a writer thread drains it
+ * into an lbe_rec_writer. push never blocks; a full ring drops the sample. */
+struct lbe_recorder;
+
+struct lbe_recorder_stats {
+	uint64_t samples;        // written to the file
+	uint64_t overruns;       // dropped because the ring was full
+	uint64_t bytes;          // data file bytes appended
+	int write_error;
+};
+
+#define LBE_RECORDER_DEFAULT_RING 16384
+
+struct lbe_recorder* lbe_recorder_start(const char *path, enum lbe_model model, uint32_t ring_size);
+int lbe_recorder_push(struct lbe_recorder *rec, const struct lbe_rec_sample *sample);
+int lbe_recorder_stop(struct lbe_recorder *rec, struct lbe_recorder_stats *stats);
+
+#endif // LBE_RECORD_H
@@ -0,0 +1,45 @@
+#ifndef LBE_SCHEDULE_H
+#define LBE_SCHEDULE_H
+
+#include "lbe_device.h"
+#include <signal.h>
+#include <stdint.h>
+
+/*
+ * Sends a prepared report at a CLOCK_REALTIME instant (GNU/Linux only).
+ * lbe_schedule_prepare() does the slow work up front: it locks memory,
+ * prefaults the stack and optionally moves the thread to SCHED_FIFO on one
+ * CPU. lbe_schedule_send() then sleeps with clock_nanosleep(TIMER_ABSTIME),
+ * busy-waits the last spin_us and issues the report.
+ *
+ * issue_error_ns is how late the report was handed to the transport. That is
+ * the host's part of the alignment. USB and the unit add a fixed latency on
+ * top, which report_ns bounds.
+ */
+
+#define LBE_SCHEDULE_DEFAULT_SPIN_US 200
+
+struct lbe_schedule_opts {
+	int lock_memory;              // mlockall(MCL_CURRENT | MCL_FUTURE)
+	int rt_priority;              // SCHED_FIFO priority 1-99, 0 keeps the current policy
+	int cpu;                      // pin to this CPU, -1 for no pinning
+	uint32_t spin_us;             // wake this early and busy-wait the rest
+	volatile sig_atomic_t *stop;  // optional, aborts a pending wait
+};
+
+struct lbe_schedule_result {
+	uint64_t target_ns;           // CLOCK_REALTIME
+	uint64_t issued_ns;           // CLOCK_REALTIME right before the transport call
+	int64_t wake_error_ns;        // end of the sleep relative to target - spin_us
+	int64_t issue_error_ns;       // issued_ns - target_ns
+	uint64_t report_ns;           // transport call duration
+};
+
+void lbe_schedule_opts_init(struct lbe_schedule_opts *opts);
+int lbe_schedule_prepare(const struct lbe_schedule_opts *opts);
+int lbe_schedule_send(struct lbe_device *dev, const struct lbe_report *report, uint64_t at_ns,
+		const struct lbe_schedule_opts *opts, struct lbe_schedule_result *res);
+/* "2026-10-17T12:00:00.25Z" (Z optional, 'T' or ' '), "@<epoch s>" or "+<s from now>" */
+int lbe_parse_utc(const char *text, uint64_t *real_ns);
+
+#endif // LBE_SCHEDULE_H
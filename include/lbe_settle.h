@@ -0,0 +1,45 @@
+#ifndef LBE_SETTLE_H
+#define LBE_SETTLE_H
+
+#include "lbe_device.h"
+#include <stdint.h>
+
+/*
+ * Set-and-confirm: poll the status report until the requested frequencies
+ * read back and LBE_PLL_LOCK_BIT is set. Polling starts fast and backs off
+ * while the report stays the same. Any change in the report (frequency
+ * taken over, lock dropped) resets the interval to the minimum, so a relock
+ * is seen soon after it happens without hammering the unit during a long
+ * settle. The measured settle time is late by at most max_poll_us.
+ */
+
+#define LBE_SETTLE_DEFAULT_TIMEOUT_MS 10000
+#define LBE_SETTLE_MIN_POLL_US 500
+#define LBE_SETTLE_MAX_POLL_US 10000
+
+struct lbe_settle_opts {
+	uint32_t timeout_ms;
+	uint32_t min_poll_us;
+	uint32_t max_poll_us;
+	uint32_t confirm_polls;  // matching polls in a row required, at least 1
+};
+
+struct lbe_settle_result {
+	uint64_t settle_ns;      // from the start (the SET for lbe_set_frequency_wait) to the first matching poll
+	uint32_t polls;
+	int timed_out;
+	struct lbe_status status; // last status read
+};
+
+LBE_API void lbe_settle_opts_init(struct lbe_settle_opts *opts);
+
+/* f1/f2 of 0 are not checked. Returns 0 once settled, -1 on a read error
+ * or when timeout_ms passes first (result->timed_out set). */
+LBE_API int lbe_wait_settled(struct lbe_device* dev, uint32_t f1, uint32_t f2,
+		const struct lbe_settle_opts *opts, struct lbe_settle_result *result);
+
+/* lbe_set_frequency(_temp) followed by lbe_wait_settled() on that output */
+LBE_API int lbe_set_frequency_wait(struct lbe_device* dev, int output, uint32_t frequency, int temp,
+		const struct lbe_settle_opts *opts, struct lbe_settle_result *result);
+
+#endif // LBE_SETTLE_H
@@ -0,0 +1,104 @@
+#ifndef LBE_SHM_H
+#define LBE_SHM_H
+
+#include "lbe_device.h"
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/*
+ * Status page shared through POSIX shared memory (GNU/Linux only).
+ * One publisher (lbe-142x --publish) polls the device and rewrites the page
+ * under a seqlock; any number of readers map it read-only and take
+ * consistent snapshots without system calls or USB traffic.
+ *
+ * The reader side is header-only:
+ *
+ *   const struct lbe_shm_page *page = lbe_shm_map(LBE_SHM_DEFAULT_NAME);
+ *   struct lbe_shm_data d;
+ *   lbe_shm_read(page, &d);
+ *   if (lbe_shm_is_fresh(&d, now_mono_ns) && d.status.pll_locked) ...
+ *
+ * A publisher removes the name when it exits, so a reader that sees
+ * publisher_pid == 0 should unmap and retry lbe_shm_map() later.
+ */
+
+#define LBE_SHM_DEFAULT_NAME "/lbe142x-status"
+#define LBE_SHM_MAGIC 0x3142454CU // "LEB1" little-endian
+#define LBE_SHM_VERSION 1
+
+/* A sample older than this many publish intervals is considered stale */
+#define LBE_SHM_STALE_INTERVALS 3
+
+struct lbe_shm_data {
+	uint64_t mono_ns;        // CLOCK_MONOTONIC when the status was read
+	uint64_t real_ns;        // CLOCK_REALTIME when the status was read
+	uint64_t interval_ns;    // publisher poll period
+	uint64_t samples;        // statuses published so far
+	uint32_t publisher_pid;  // 0 once the publisher has exited
+	uint32_t model;          // enum lbe_model
+	struct lbe_status status;
+};
+
+struct lbe_shm_page {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size;           // sizeof(struct lbe_shm_page) of the publisher
+	uint32_t seq;            // odd while an update is in progress
+	struct lbe_shm_data data;
+};
+
+/* Map an existing page read-only, NULL if absent or incompatible */
+static inline const struct lbe_shm_page* lbe_shm_map(const char *name) {
+	struct lbe_shm_page *page;
+	int fd = shm_open(name, O_RDONLY | O_CLOEXEC, 0);
+
+	if (fd < 0) return NULL;
+	page = mmap(NULL, sizeof(*page), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (page == MAP_FAILED) return NULL;
+	if (page->magic != LBE_SHM_MAGIC || page->version != LBE_SHM_VERSION ||
+	    page->size != sizeof(*page)) {
+		munmap(page, sizeof(*page));
+		return NULL;
+	}
+	return page;
+}
+
+static inline void lbe_shm_unmap(const struct lbe_shm_page *page) {
+	if (page) munmap((void *)page, sizeof(*page));
+}
+
+/* Consistent snapshot of the page, retried while the publisher writes */
+static inline void lbe_shm_read(const struct lbe_shm_page *page, struct lbe_shm_data *out) {
+	uint32_t seq1, seq2;
+
+	do {
+		seq1 = __atomic_load_n(&page->seq, __ATOMIC_ACQUIRE);
+		if (seq1 & 1) {
+			seq2 = seq1 + 1;
+			continue;
+		}
+		memcpy(out, &page->data, sizeof(*out));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		seq2 = __atomic_load_n(&page->seq, __ATOMIC_RELAXED);
+	} while (seq1 != seq2);
+}
+
+/* now_mono_ns is the reader's CLOCK_MONOTONIC (vDSO, no system call) */
+static inline int lbe_shm_is_fresh(const struct lbe_shm_data *data, uint64_t now_mono_ns) {
+	return data->publisher_pid != 0 && data->samples != 0 &&
+	       now_mono_ns - data->mono_ns <= LBE_SHM_STALE_INTERVALS * data->interval_ns;
+}
+
+/* Publisher side, implemented in lbe_shm_linux.c */
+struct lbe_sample;
+struct lbe_shm_publisher;
+
+struct lbe_shm_publisher* lbe_shm_publisher_new(const char *name, enum lbe_model model, uint64_t interval_ns);
+void lbe_shm_publish(struct lbe_shm_publisher *pub, const struct lbe_sample *sample);
+void lbe_shm_publisher_free(struct lbe_shm_publisher *pub);
+
+#endif // LBE_SHM_H
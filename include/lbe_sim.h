@@ -0,0 +1,50 @@
+#ifndef LBE_SIM_H
+#define LBE_SIM_H
+
+#include "lbe_device.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Software model of an LBE-1420/1421 speaking the hidraw report layout:
+ * SET reports carry the command code in byte 0, the status is feature
+ * report 0x4B. Frequencies have a flash copy and a running copy so temporary
+ * changes behave like on the real unit. Used by the uhid emulator and by
+ * the in-process simulator transport (lbe_open_simulator()).
+ *
+ * Time only moves through lbe_sim_tick(), so a caller driving the clock gets
+ * deterministic lock behaviour. With relock_ns set, a frequency or loop mode
+ * change drops PLL lock until that much time has passed.
+ */
+
+#define LBE_SIM_REPORT_SIZE 60
+
+struct lbe_sim {
+	enum lbe_model model;
+	uint32_t flash_frequency[2];
+	uint32_t frequency[2];
+	int outputs_enabled;
+	int fll_enabled;
+	int pps_enabled;
+	int power_low[2];
+	int gps_locked;
+	int pll_locked;
+	int antenna_ok;
+	uint64_t relock_ns;
+	uint64_t now_ns;
+	uint64_t relock_deadline_ns;
+	uint64_t get_reports;
+	uint64_t set_reports;
+	uint64_t flash_writes;
+};
+
+LBE_API void lbe_sim_init(struct lbe_sim *sim, enum lbe_model model);
+LBE_API int lbe_sim_get_feature(struct lbe_sim *sim, uint8_t *buf, size_t len);
+LBE_API int lbe_sim_set_feature(struct lbe_sim *sim, const uint8_t *buf, size_t len);
+LBE_API void lbe_sim_tick(struct lbe_sim *sim, uint64_t now_ns);
+
+/* Device handle backed by sim, which must outlive it. Every report is
+ * delayed by latency_us to stand in for the USB round trip. */
+LBE_API struct lbe_device* lbe_open_simulator(struct lbe_sim *sim, unsigned int latency_us);
+
+#endif // LBE_SIM_H
@@ -0,0 +1,34 @@
+#ifndef LBE_STATS_H
+#define LBE_STATS_H
+
+#include "lbe_device.h"
+#include "lbe_histogram.h"
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Per-command report statistics, kept by every device handle. A report is
+ * counted under its first byte once it reaches the transport: the command
+ * code for SET reports (lbe_set_*(), lbe_send_prepared()), or
+ * LBE_STATUS_REPORT_ID for status reads. A status read that reuses a
+ * concurrent one is not counted again.
+ */
+
+#define LBE_CMD_STATS_MAX 18
+
+struct lbe_cmd_stats {
+	uint8_t code;
+	uint64_t calls;
+	uint64_t errors;
+	uint64_t bytes;                   // moved by the reports that succeeded
+	struct lbe_histogram latency_ns;  // transport round trip, sum is the total
+};
+
+/* Fills at most max entries in code order, returns how many were filled */
+LBE_API int lbe_get_cmd_stats(struct lbe_device* dev, struct lbe_cmd_stats *list, int max);
+LBE_API void lbe_reset_cmd_stats(struct lbe_device* dev);
+
+LBE_API const char* lbe_cmd_code_name(uint8_t code);
+LBE_API void lbe_cmd_stats_print(FILE *out, const struct lbe_cmd_stats *list, int count);
+
+#endif // LBE_STATS_H
@@ -0,0 +1,65 @@
+#ifndef LBE_SWEEP_H
+#define LBE_SWEEP_H
+
+#include "lbe_device.h"
+#include <signal.h>
+#include <stdint.h>
+
+/*
+ * Frequency sweep/hop engine (GNU/Linux only). Steps one output through a
+ * list of temporary frequencies (never written to flash), issuing each step at
+ * an absolute CLOCK_MONOTONIC deadline so dwell errors do not accumulate.
+ */
+
+struct lbe_hop {
+	uint32_t frequency;
+	uint32_t dwell_us; // time until the next hop is due
+};
+
+struct lbe_sweep_stats {
+	uint64_t hops;
+	uint64_t errors;
+	uint64_t deadline_misses;  // hops issued after the next deadline had already passed
+	uint64_t latency_min_ns;   // per-hop feature report latency
+	uint64_t latency_max_ns;
+	uint64_t latency_sum_ns;
+	uint64_t lateness_max_ns;  // worst issue time past its deadline
+	double elapsed_s;
+	double hop_rate;           // achieved hops per second
+};
+
+int lbe_sweep_build(uint32_t start, uint32_t stop, uint32_t step, uint32_t dwell_us,
+		struct lbe_hop **hops, uint32_t *count);
+int lbe_hop_list_load(const char *path, uint32_t default_dwell_us, struct lbe_hop **hops, uint32_t *count);
+int lbe_sweep_run(struct lbe_device* dev, int output, const struct lbe_hop *hops, uint32_t count,
+		uint32_t loops, volatile sig_atomic_t *stop, struct lbe_sweep_stats *stats);
+
+/*
+ * Plan files hold a hop list as ready-to-send reports for one model and
+ * output. They are memory-mapped, so even millions of hops open instantly,
+ * and playback neither encodes nor allocates. All fields are little-endian:
+ * a 32 byte header ("LBEPLAN" NUL, u16 version, u8 model, u8 output,
+ * u32 record size, u64 hop count, u64 total dwell in us) followed by one
+ * 64 byte record per hop (u32 dwell_us, then the LBE_REPORT_SIZE report).
+ * Playback stops at the first record that is not a temporary frequency
+ * change within the model's range, so a damaged file cannot write flash.
+ */
+#define LBE_PLAN_VERSION 1
+
+struct lbe_plan;
+
+struct lbe_plan_info {
+	enum lbe_model model;
+	int output;
+	uint64_t count;
+	uint64_t total_dwell_us;
+};
+
+int lbe_plan_write(const char *path, enum lbe_model model, int output, const struct lbe_hop *hops, uint32_t count);
+struct lbe_plan* lbe_plan_open(const char *path);
+void lbe_plan_close(struct lbe_plan *plan);
+void lbe_plan_get_info(const struct lbe_plan *plan, struct lbe_plan_info *info);
+int lbe_plan_run(struct lbe_device* dev, const struct lbe_plan *plan, uint32_t loops,
+		volatile sig_atomic_t *stop, struct lbe_sweep_stats *stats);
+
+#endif // LBE_SWEEP_H
@@ -0,0 +1,39 @@
+#ifndef LBE_THREAD_H
+#define LBE_THREAD_H
+
+/*
+ * Minimal mutex/condition variable layer used inside the library: pthreads
+ * on POSIX, SRW locks and condition variables on Windows. Not installed.
+ */
+
+#ifdef _WIN32
+#include <windows.h>
+
+typedef SRWLOCK lbe_mutex_t;
+typedef CONDITION_VARIABLE lbe_cond_t;
+
+static inline void lbe_mutex_init(lbe_mutex_t *m) { InitializeSRWLock(m); }
+static inline void lbe_mutex_destroy(lbe_mutex_t *m) { (void)m; }
+static inline void lbe_mutex_lock(lbe_mutex_t *m) { AcquireSRWLockExclusive(m); }
+static inline void lbe_mutex_unlock(lbe_mutex_t *m) { ReleaseSRWLockExclusive(m); }
+static inline void lbe_cond_init(lbe_cond_t *c) { InitializeConditionVariable(c); }
+static inline void lbe_cond_destroy(lbe_cond_t *c) { (void)c; }
+static inline void lbe_cond_wait(lbe_cond_t *c, lbe_mutex_t *m) { SleepConditionVariableSRW(c, m, INFINITE, 0); }
+static inline void lbe_cond_broadcast(lbe_cond_t *c) { WakeAllConditionVariable(c); }
+#else
+#include <pthread.h>
+
+typedef pthread_mutex_t lbe_mutex_t;
+typedef pthread_cond_t lbe_cond_t;
+
+static inline void lbe_mutex_init(lbe_mutex_t *m) { pthread_mutex_init(m, NULL); }
+static inline void lbe_mutex_destroy(lbe_mutex_t *m) { pthread_mutex_destroy(m); }
+static inline void lbe_mutex_lock(lbe_mutex_t *m) { pthread_mutex_lock(m); }
+static inline void lbe_mutex_unlock(lbe_mutex_t *m) { pthread_mutex_unlock(m); }
+static inline void lbe_cond_init(lbe_cond_t *c) { pthread_cond_init(c, NULL); }
+static inline void lbe_cond_destroy(lbe_cond_t *c) { pthread_cond_destroy(c); }
+static inline void lbe_cond_wait(lbe_cond_t *c, lbe_mutex_t *m) { pthread_cond_wait(c, m); }
+static inline void lbe_cond_broadcast(lbe_cond_t *c) { pthread_cond_broadcast(c); }
+#endif
+
+#endif // LBE_THREAD_H
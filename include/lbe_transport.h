@@ -0,0 +1,30 @@
+#ifndef LBE_TRANSPORT_H
+#define LBE_TRANSPORT_H
+
+#include "lbe_device.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Feature report transport under struct lbe_device. Reports always use the
+ * hidraw layout (LBE_REPORT_SIZE bytes, see lbe_device.h); transports
+ * translate to their wire format.
+ */
+
+struct lbe_transport_ops {
+	const char *name;
+	int (*get_feature)(void *ctx, uint8_t *buf, size_t len); // buf[0] holds the report id
+	int (*set_feature)(void *ctx, const uint8_t *buf, size_t len);
+	void (*close)(void *ctx);
+	// Optional. Waits up to timeout_ms (LBE_LOCK_WAIT_FOREVER: no limit) and
+	// stores the time spent waiting; returns 0 at once, 1 after waiting, -1 on
+	// failure or timeout (errno ETIMEDOUT)
+	int (*lock)(void *ctx, enum lbe_lock_mode mode, int timeout_ms, uint64_t *waited_ns);
+};
+
+LBE_API struct lbe_device* lbe_open_transport(const struct lbe_transport_ops *ops, void *ctx,
+		enum lbe_model model, const char *path);
+LBE_API const char* lbe_get_transport_name(struct lbe_device* dev);
+LBE_API void* lbe_get_transport_ctx(struct lbe_device* dev);
+
+#endif // LBE_TRANSPORT_H
@@ -0,0 +1,274 @@
+#define _GNU_SOURCE
+
+#include "lbe_device.h"
+#include "lbe_clock.h"
+#include "lbe_cmd.h"
+#include "lbe_hotplug.h"
+#include "lbe_ipc.h"
+#include <sys/socket.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+
+#define MAX_CLIENTS 64
+#define CLIENT_BUF_SIZE 1024
+#define LOCK_WAIT_MS 1000
+#define REPLY_TIMEOUT_MS 1000
+
+struct client {
+	int fd;
+	size_t len;
+	char buf[CLIENT_BUF_SIZE];
+};
+
+static volatile sig_atomic_t running = 1;
+
+// Device handle owned by the daemon, reopened lazily after an I/O failure
+static struct lbe_device *dev;
+
+// Cross-process device lock taken around each request, from --lock-wait / --no-lock
+static int lock_wait_ms = LOCK_WAIT_MS;
+static int use_lock = 1;
+
+static void on_hotplug(enum lbe_hotplug_event event, const struct lbe_device_info *info, void *arg) {
+	(void)arg;
+
+	if (event == LBE_HOTPLUG_REMOVED) {
+		fprintf(stderr, "lbe142xd: %s removed\n", info->path);
+		if (dev && strcmp(lbe_get_path(dev), info->path) == 0) {
+			lbe_close_device(dev);
+			dev = NULL;
+		}
+	} else {
+		fprintf(stderr, "lbe142xd: %s added\n", info->path);
+		if (!dev) {
+			dev = lbe_open_device_path(info->path);
+		}
+	}
+}
+
+static void on_signal(int sig) {
+	(void)sig;
+	running = 0;
+}
+
+static void print_usage(void) {
+	printf("Usage: lbe142xd [OPTIONS]\n");
+	printf("Options:\n");
+	printf("  --socket <path> Listen on <path> (default $XDG_RUNTIME_DIR/%s)\n", LBE_IPC_SOCKET_NAME);
+	printf("  --lock-wait <ms> Fail a request when another process holds the device longer (default %d)\n", LOCK_WAIT_MS);
+	printf("  --no-lock Do not take the cross-process device lock\n");
+	printf("  --help Show this help\n");
+}
+
+/* A client that stops reading is dropped after REPLY_TIMEOUT_MS instead of
+ * stalling the loop for everyone else */
+static int send_reply(int fd, const char *reply) {
+	char buf[LBE_CMD_LINE_MAX + 2];
+	struct pollfd pfd = { fd, POLLOUT, 0 };
+	uint64_t deadline_ns = lbe_now_ns() + REPLY_TIMEOUT_MS * 1000000ULL;
+	size_t off = 0;
+	int n = snprintf(buf, sizeof(buf), "%s\n", reply);
+
+	if (n < 0) return -1;
+	if ((size_t)n >= sizeof(buf)) n = sizeof(buf) - 1;
+	while (off < (size_t)n) {
+		uint64_t now = lbe_now_ns();
+		ssize_t w;
+		int res;
+
+		if (now >= deadline_ns) return -1;
+		res = poll(&pfd, 1, (int)((deadline_ns - now + 999999) / 1000000));
+		if (res < 0 && errno == EINTR) continue;
+		if (res <= 0) return -1;
+
+		w = send(fd, buf + off, (size_t)n - off, MSG_NOSIGNAL | MSG_DONTWAIT);
+		if (w < 0) {
+			if (errno == EINTR || errno == EAGAIN) continue;
+			return -1;
+		}
+		off += (size_t)w;
+	}
+	return 0;
+}
+
+static int handle_line(int fd, const char *line) {
+	char reply[LBE_CMD_LINE_MAX];
+	struct lbe_cmd cmd;
+	int locked = 0;
+	int res;
+
+	if (!dev) {
+		dev = lbe_open_device();
+		if (!dev) {
+			return send_reply(fd, "ERR device not available");
+		}
+		fprintf(stderr, "lbe142xd: opened LBE-%s\n", lbe_get_model(dev) == LBE_1420 ? "1420" : "1421");
+	}
+
+	// Status reads share the unit, anything else holds it for the whole request
+	if (use_lock && lbe_cmd_parse(line, &cmd) == 0) {
+		enum lbe_lock_mode mode = cmd.op == LBE_CMD_STATUS ? LBE_LOCK_SHARED : LBE_LOCK_EXCLUSIVE;
+
+		if (lbe_lock_device(dev, mode, lock_wait_ms) < 0) {
+			return send_reply(fd, "ERR device locked by another process");
+		}
+		locked = 1;
+	}
+
+	res = lbe_cmd_run_line(dev, line, reply, sizeof(reply));
+	if (locked) {
+		lbe_unlock_device(dev);
+	}
+	if (res == LBE_CMD_ERR_IO) {
+		// Most likely unplugged; drop the handle so the next request re-enumerates
+		fprintf(stderr, "lbe142xd: device I/O failed, closing handle\n");
+		lbe_close_device(dev);
+		dev = NULL;
+	}
+	return send_reply(fd, reply);
+}
+
+/* Returns -1 when the client must be dropped */
+static int handle_client(struct client *c) {
+	ssize_t r;
+	char *start, *nl;
+
+	r = recv(c->fd, c->buf + c->len, sizeof(c->buf) - c->len, 0);
+	if (r < 0) return (errno == EINTR || errno == EAGAIN) ? 0 : -1;
+	if (r == 0) return -1;
+	c->len += (size_t)r;
+
+	start = c->buf;
+	while ((nl = memchr(start, '\n', c->len - (size_t)(start - c->buf))) != NULL) {
+		*nl = '\0';
+		if (nl > start && nl[-1] == '\r') nl[-1] = '\0';
+		if (*start && handle_line(c->fd, start) < 0) return -1;
+		start = nl + 1;
+	}
+
+	c->len -= (size_t)(start - c->buf);
+	memmove(c->buf, start, c->len);
+	if (c->len == sizeof(c->buf)) {
+		send_reply(c->fd, "ERR line too long");
+		return -1;
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	char socket_path[PATH_MAX];
+	struct client clients[MAX_CLIENTS];
+	struct pollfd pfds[MAX_CLIENTS + 2];
+	struct lbe_hotplug *hotplug;
+	int nclients = 0;
+	int nfds;
+	int listen_fd;
+
+	if (lbe_ipc_default_path(socket_path, sizeof(socket_path)) < 0) {
+		fprintf(stderr, "Failed to build default socket path\n");
+		return 1;
+	}
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+			snprintf(socket_path, sizeof(socket_path), "%s", argv[++i]);
+		} else if (strcmp(argv[i], "--lock-wait") == 0 && i + 1 < argc) {
+			lock_wait_ms = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--no-lock") == 0) {
+			use_lock = 0;
+		} else if (strcmp(argv[i], "--help") == 0) {
+			print_usage();
+			return 0;
+		} else {
+			fprintf(stderr, "Unknown option: %s\n", argv[i]);
+			print_usage();
+			return 1;
+		}
+	}
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+	signal(SIGPIPE, SIG_IGN);
+
+	listen_fd = lbe_ipc_listen(socket_path);
+	if (listen_fd < 0) {
+		return 1;
+	}
+	fprintf(stderr, "lbe142xd: listening on %s\n", socket_path);
+
+	// Without udev events we still recover through the reopen on I/O failure
+	hotplug = lbe_hotplug_new();
+	if (!hotplug) {
+		fprintf(stderr, "lbe142xd: hotplug monitoring disabled\n");
+	}
+
+	// Open eagerly so the first client does not pay for enumeration
+	dev = lbe_open_device();
+
+	while (running) {
+		int n;
+
+		pfds[0].fd = listen_fd;
+		pfds[0].events = POLLIN;
+		for (int i = 0; i < nclients; i++) {
+			pfds[i + 1].fd = clients[i].fd;
+			pfds[i + 1].events = POLLIN;
+		}
+		nfds = nclients + 1;
+		if (hotplug) {
+			pfds[nfds].fd = lbe_hotplug_get_fd(hotplug);
+			pfds[nfds].events = POLLIN;
+			pfds[nfds].revents = 0;
+			nfds++;
+		}
+
+		n = poll(pfds, (nfds_t)nfds, -1);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			perror("poll");
+			break;
+		}
+
+		if (hotplug && (pfds[nfds - 1].revents & POLLIN)) {
+			lbe_hotplug_process(hotplug, on_hotplug, NULL);
+		}
+
+		// Service existing clients first; compacting the array keeps pfds aligned
+		for (int i = nclients - 1; i >= 0; i--) {
+			if (!pfds[i + 1].revents) continue;
+			if (handle_client(&clients[i]) < 0) {
+				close(clients[i].fd);
+				clients[i] = clients[--nclients];
+			}
+		}
+
+		if (pfds[0].revents & POLLIN) {
+			int fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+			if (fd < 0) {
+				if (errno != EINTR && errno != EAGAIN) perror("accept");
+			} else if (nclients == MAX_CLIENTS) {
+				send_reply(fd, "ERR too many clients");
+				close(fd);
+			} else {
+				clients[nclients].fd = fd;
+				clients[nclients].len = 0;
+				nclients++;
+			}
+		}
+	}
+
+	for (int i = 0; i < nclients; i++) {
+		close(clients[i].fd);
+	}
+	close(listen_fd);
+	unlink(socket_path);
+	lbe_hotplug_free(hotplug);
+	lbe_close_device(dev);
+	return 0;
+}
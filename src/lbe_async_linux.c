@@ -0,0 +1,255 @@
+#ifdef __linux__
+
+#include "lbe_async.h"
+#include "lbe_internal.h"
+#include <sys/eventfd.h>
+#include <pthread.h>
+#include <poll.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+struct async_req {
+	struct lbe_device *dev;
+	struct lbe_cmd cmd;
+	lbe_async_cb cb;
+	void *arg;
+	int result;
+	struct lbe_status status;
+	struct async_req *next;
+};
+
+struct req_queue {
+	struct async_req *head;
+	struct async_req *tail;
+};
+
+struct lbe_async {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	pthread_t threads[LBE_ASYNC_MAX_WORKERS];
+	int nthreads;
+	int stopping;
+	int efd;
+	struct req_queue queued;
+	struct req_queue done;
+	int pending;                                // submitted, not yet dispatched
+	struct lbe_device *busy[LBE_ASYNC_MAX_WORKERS]; // device each worker is on
+};
+
+static void queue_push(struct req_queue *q, struct async_req *req) {
+	req->next = NULL;
+	if (q->tail) {
+		q->tail->next = req;
+	} else {
+		q->head = req;
+	}
+	q->tail = req;
+}
+
+static int device_busy(const struct lbe_async *as, const struct lbe_device *dev) {
+	for (int i = 0; i < as->nthreads; i++) {
+		if (as->busy[i] == dev) return 1;
+	}
+	return 0;
+}
+
+/* Oldest queued request whose device is idle; keeps per-device order */
+static struct async_req* take_runnable(struct lbe_async *as) {
+	struct async_req *prev = NULL;
+
+	for (struct async_req *req = as->queued.head; req; prev = req, req = req->next) {
+		if (device_busy(as, req->dev)) continue;
+		if (prev) {
+			prev->next = req->next;
+		} else {
+			as->queued.head = req->next;
+		}
+		if (as->queued.tail == req) as->queued.tail = prev;
+		return req;
+	}
+	return NULL;
+}
+
+struct worker_arg {
+	struct lbe_async *as;
+	int slot;
+};
+
+static void* async_worker(void *p) {
+	struct lbe_async *as = ((struct worker_arg *)p)->as;
+	int slot = ((struct worker_arg *)p)->slot;
+	const uint64_t one = 1;
+
+	free(p);
+	pthread_mutex_lock(&as->lock);
+	for (;;) {
+		struct async_req *req = take_runnable(as);
+
+		if (!req) {
+			if (as->stopping && !as->queued.head) break;
+			pthread_cond_wait(&as->cond, &as->lock);
+			continue;
+		}
+		as->busy[slot] = req->dev;
+		pthread_mutex_unlock(&as->lock);
+
+		req->result = lbe_cmd_execute(req->dev, &req->cmd, &req->status);
+
+		pthread_mutex_lock(&as->lock);
+		as->busy[slot] = NULL;
+		queue_push(&as->done, req);
+		if (write(as->efd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+			lbe_log_errno("eventfd write");
+		}
+		// The device is free again, a request queued behind it may now run
+		pthread_cond_broadcast(&as->cond);
+	}
+	pthread_mutex_unlock(&as->lock);
+	return NULL;
+}
+
+/* workers <= 0 uses LBE_ASYNC_DEFAULT_WORKERS */
+struct lbe_async* lbe_async_new(int workers) {
+	struct lbe_async *as;
+
+	if (workers <= 0) workers = LBE_ASYNC_DEFAULT_WORKERS;
+	if (workers > LBE_ASYNC_MAX_WORKERS) workers = LBE_ASYNC_MAX_WORKERS;
+
+	as = calloc(1, sizeof(struct lbe_async));
+	if (!as) return NULL;
+
+	as->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (as->efd < 0) {
+		lbe_log_errno("eventfd");
+		free(as);
+		return NULL;
+	}
+	pthread_mutex_init(&as->lock, NULL);
+	pthread_cond_init(&as->cond, NULL);
+
+	for (int i = 0; i < workers; i++) {
+		struct worker_arg *arg = malloc(sizeof(struct worker_arg));
+
+		if (!arg) break;
+		arg->as = as;
+		arg->slot = i;
+		if (pthread_create(&as->threads[i], NULL, async_worker, arg) != 0) {
+			lbe_log_errno("pthread_create");
+			free(arg);
+			break;
+		}
+		as->nthreads++;
+	}
+	if (as->nthreads == 0) {
+		lbe_async_free(as);
+		return NULL;
+	}
+	return as;
+}
+
+/* Runs everything still queued and dispatches it before returning */
+void lbe_async_free(struct lbe_async *as) {
+	if (!as) return;
+
+	pthread_mutex_lock(&as->lock);
+	as->stopping = 1;
+	pthread_cond_broadcast(&as->cond);
+	pthread_mutex_unlock(&as->lock);
+	for (int i = 0; i < as->nthreads; i++) {
+		pthread_join(as->threads[i], NULL);
+	}
+	lbe_async_dispatch(as);
+
+	pthread_cond_destroy(&as->cond);
+	pthread_mutex_destroy(&as->lock);
+	close(as->efd);
+	free(as);
+}
+
+int lbe_async_get_fd(struct lbe_async *as) {
+	return as->efd;
+}
+
+int lbe_async_submit(struct lbe_async *as, struct lbe_device* dev, const struct lbe_cmd *cmd,
+		lbe_async_cb cb, void *arg) {
+	struct async_req *req = malloc(sizeof(struct async_req));
+
+	if (!req) return -1;
+	memset(req, 0, sizeof(*req));
+	req->dev = dev;
+	req->cmd = *cmd;
+	req->cb = cb;
+	req->arg = arg;
+
+	pthread_mutex_lock(&as->lock);
+	if (as->stopping) {
+		pthread_mutex_unlock(&as->lock);
+		free(req);
+		return -1;
+	}
+	queue_push(&as->queued, req);
+	as->pending++;
+	pthread_cond_signal(&as->cond);
+	pthread_mutex_unlock(&as->lock);
+	return 0;
+}
+
+/* Invoke callbacks for every completed request, returns how many ran.
+ * Callbacks may submit further requests. */
+int lbe_async_dispatch(struct lbe_async *as) {
+	struct async_req *req;
+	uint64_t count;
+	int n = 0;
+
+	if (read(as->efd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+		lbe_log_errno("eventfd read");
+	}
+
+	pthread_mutex_lock(&as->lock);
+	req = as->done.head;
+	as->done.head = as->done.tail = NULL;
+	pthread_mutex_unlock(&as->lock);
+
+	while (req) {
+		struct async_req *next = req->next;
+
+		if (req->cb) req->cb(req->dev, &req->cmd, req->result, &req->status, req->arg);
+		free(req);
+		req = next;
+		n++;
+	}
+
+	pthread_mutex_lock(&as->lock);
+	as->pending -= n;
+	pthread_mutex_unlock(&as->lock);
+	return n;
+}
+
+/* Requests submitted whose callback has not run yet */
+int lbe_async_pending(struct lbe_async *as) {
+	int n;
+
+	pthread_mutex_lock(&as->lock);
+	n = as->pending;
+	pthread_mutex_unlock(&as->lock);
+	return n;
+}
+
+/* Convenience loop for callers without their own event loop: wait up to
+ * timeout_ms (-1 forever) for completions and dispatch them */
+int lbe_async_wait(struct lbe_async *as, int timeout_ms) {
+	struct pollfd pfd = { .fd = as->efd, .events = POLLIN };
+	int res = poll(&pfd, 1, timeout_ms);
+
+	if (res < 0) {
+		if (errno == EINTR) return 0;
+		lbe_log_errno("poll");
+		return -1;
+	}
+	return res ? lbe_async_dispatch(as) : 0;
+}
+
+#endif // __linux__
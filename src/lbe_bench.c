@@ -0,0 +1,290 @@
+/*
+ * lbe-142x-bench: measures the host side cost of each feature report type
+ * (hidraw ioctl on GNU/Linux, libusb control transfer on Windows). Run it
+ * against real hardware, a lbe-142x-uhid emulated unit, or with --sim against
+ * the in-process simulator to time the encode/decode path on its own. Builds
+ * with the libusb transport can compare it against hidraw with --libusb, and
+ * measure pipelined status reads with --async.
+ */
+
+#include "lbe_device.h"
+#include "lbe_clock.h"
+#include "lbe_common.h"
+#include "lbe_histogram.h"
+#include "lbe_sim.h"
+#include "lbe_transport.h"
+#if defined(_WIN32) || defined(LBE_WITH_LIBUSB)
+#include "lbe_libusb.h"
+#define HAVE_LIBUSB 1
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#define DEFAULT_ITERATIONS 1000
+#define WARMUP_ITERATIONS 10
+
+enum bench_op {
+	BENCH_STATUS = 0,
+	BENCH_FREQ_TEMP,
+	BENCH_POWER,
+	BENCH_BLINK,
+	BENCH_OP_COUNT
+};
+
+static const char *const op_names[BENCH_OP_COUNT] = { "status", "freq-temp", "power", "blink" };
+
+struct bench_ctx {
+	struct lbe_device *dev;
+	struct lbe_status initial; // values written back so the unit state does not change
+};
+
+static void print_usage(void) {
+	printf("Usage: lbe-142x-bench [OPTIONS]\n");
+	printf("Options:\n");
+	printf("  --iterations <n> Calls per command type (default %d)\n", DEFAULT_ITERATIONS);
+	printf("  --ops <list> Comma separated subset of status,freq-temp,power,blink (default all)\n");
+	printf("  --device <path> Benchmark this device instead of the first one found\n");
+	printf("  --sim <1420|1421> Benchmark the in-process simulator instead of hardware\n");
+	printf("  --sim-latency-us <us> Simulated round trip per report (default 0)\n");
+#ifdef HAVE_LIBUSB
+	printf("  --libusb Open the unit through libusb (--device takes a bus-port path such as 1-2.3)\n");
+	printf("  --usb-timeout <ms> libusb transfer timeout (default %d)\n", LBE_LIBUSB_DEFAULT_TIMEOUT_MS);
+	printf("  --async <depth> Also time status reads with <depth> libusb transfers in flight\n");
+#endif
+	printf("  --help Show this help\n");
+}
+
+static int run_op(struct bench_ctx *ctx, enum bench_op op) {
+	struct lbe_status status;
+
+	switch (op) {
+	case BENCH_STATUS:
+		return lbe_get_device_status(ctx->dev, &status);
+	case BENCH_FREQ_TEMP:
+		return lbe_set_frequency_temp(ctx->dev, 1, ctx->initial.frequency1);
+	case BENCH_POWER:
+		return lbe_set_power_level(ctx->dev, 1, ctx->initial.out1_power_low);
+	case BENCH_BLINK:
+		return lbe_blink_leds(ctx->dev);
+	default:
+		return -1;
+	}
+}
+
+static int parse_ops(const char *list, int *enabled) {
+	const char *p = list;
+
+	memset(enabled, 0, BENCH_OP_COUNT * sizeof(*enabled));
+	while (*p) {
+		size_t len = strcspn(p, ",");
+		int found = 0;
+
+		for (int op = 0; op < BENCH_OP_COUNT; op++) {
+			if (strlen(op_names[op]) == len && strncmp(p, op_names[op], len) == 0) {
+				enabled[op] = 1;
+				found = 1;
+			}
+		}
+		if (!found) {
+			fprintf(stderr, "Unknown op: %.*s\n", (int)len, p);
+			return -1;
+		}
+		p += len;
+		if (*p == ',') p++;
+	}
+	return 0;
+}
+
+#ifdef HAVE_LIBUSB
+struct async_bench {
+	struct lbe_device *dev;
+	long remaining;
+	long in_flight;
+	uint64_t errors;
+	struct lbe_histogram hist;
+};
+
+struct async_slot {
+	struct async_bench *bench;
+	uint64_t submitted_ns;
+};
+
+static void async_done(int result, const uint8_t *report, void *arg);
+
+static int submit_slot(struct async_slot *slot) {
+	struct async_bench *b = slot->bench;
+
+	slot->submitted_ns = lbe_now_ns();
+	if (lbe_libusb_submit_status(b->dev, async_done, slot) < 0) {
+		b->errors++;
+		return -1;
+	}
+	b->remaining--;
+	b->in_flight++;
+	return 0;
+}
+
+/* Latency is submit to completion, so it includes the time spent queued */
+static void async_done(int result, const uint8_t *report, void *arg) {
+	struct async_slot *slot = arg;
+	struct async_bench *b = slot->bench;
+
+	(void)report;
+	if (result < 0) b->errors++;
+	lbe_histogram_add(&b->hist, lbe_now_ns() - slot->submitted_ns);
+	b->in_flight--;
+	if (b->remaining > 0) submit_slot(slot);
+}
+
+static int run_async(struct lbe_device *dev, long iterations, int depth) {
+	struct async_slot *slots = calloc((size_t)depth, sizeof(struct async_slot));
+	struct async_bench b;
+	uint64_t start;
+	double total_s;
+
+	if (!slots) return -1;
+	memset(&b, 0, sizeof(b));
+	b.dev = dev;
+	b.remaining = iterations;
+	lbe_histogram_init(&b.hist);
+
+	start = lbe_now_ns();
+	for (int i = 0; i < depth && b.remaining > 0; i++) {
+		slots[i].bench = &b;
+		if (submit_slot(&slots[i]) < 0) break;
+	}
+	while (b.in_flight > 0) {
+		if (lbe_libusb_handle_events(dev, 1000) < 0) break;
+	}
+	total_s = (lbe_now_ns() - start) / 1e9;
+	free(slots);
+
+	lbe_histogram_print(stdout, "status-async", &b.hist);
+	printf("%-14s %8.0f ops/s, %llu errors, %d in flight\n", "",
+		total_s > 0 ? (double)b.hist.count / total_s : 0.0, (unsigned long long)b.errors, depth);
+	return b.in_flight ? -1 : 0;
+}
+#endif
+
+int main(int argc, char *argv[]) {
+	static struct lbe_histogram hist[BENCH_OP_COUNT];
+	int enabled[BENCH_OP_COUNT] = { 1, 1, 1, 1 };
+	uint64_t errors[BENCH_OP_COUNT] = { 0 };
+	double total_s[BENCH_OP_COUNT] = { 0 };
+	const char *path = NULL;
+	struct lbe_sim sim;
+	int use_sim = 0;
+	unsigned int sim_latency_us = 0;
+	long iterations = DEFAULT_ITERATIONS;
+	struct bench_ctx ctx;
+#ifdef HAVE_LIBUSB
+	int use_libusb = 0;
+	long usb_timeout_ms = -1;
+	int async_depth = 0;
+#endif
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+			iterations = atol(argv[++i]);
+		} else if (strcmp(argv[i], "--ops") == 0 && i + 1 < argc) {
+			if (parse_ops(argv[++i], enabled) < 0) return 1;
+		} else if (strcmp(argv[i], "--device") == 0 && i + 1 < argc) {
+			path = argv[++i];
+		} else if (strcmp(argv[i], "--sim") == 0 && i + 1 < argc) {
+			lbe_sim_init(&sim, atoi(argv[++i]) == 1420 ? LBE_1420 : LBE_1421_DUALOUT);
+			use_sim = 1;
+		} else if (strcmp(argv[i], "--sim-latency-us") == 0 && i + 1 < argc) {
+			sim_latency_us = (unsigned int)strtoul(argv[++i], NULL, 10);
+#ifdef HAVE_LIBUSB
+		} else if (strcmp(argv[i], "--libusb") == 0) {
+			use_libusb = 1;
+		} else if (strcmp(argv[i], "--usb-timeout") == 0 && i + 1 < argc) {
+			usb_timeout_ms = atol(argv[++i]);
+		} else if (strcmp(argv[i], "--async") == 0 && i + 1 < argc) {
+			async_depth = atoi(argv[++i]);
+#endif
+		} else if (strcmp(argv[i], "--help") == 0) {
+			print_usage();
+			return 0;
+		} else {
+			fprintf(stderr, "Unknown option: %s\n", argv[i]);
+			print_usage();
+			return 1;
+		}
+	}
+	if (iterations <= 0) {
+		fprintf(stderr, "Invalid iteration count\n");
+		return 1;
+	}
+
+	if (use_sim) {
+		ctx.dev = lbe_open_simulator(&sim, sim_latency_us);
+#ifdef HAVE_LIBUSB
+	} else if (use_libusb) {
+		ctx.dev = lbe_libusb_open(path);
+#endif
+	} else {
+		ctx.dev = path ? lbe_open_device_path(path) : lbe_open_device();
+	}
+	if (!ctx.dev) {
+		fprintf(stderr, "Failed to open LBE-142x device\n");
+		return 1;
+	}
+#ifdef HAVE_LIBUSB
+	if (strcmp(lbe_get_transport_name(ctx.dev), "libusb") == 0) {
+		if (usb_timeout_ms >= 0) lbe_libusb_set_timeout(ctx.dev, (unsigned int)usb_timeout_ms);
+	} else if (async_depth > 0 || usb_timeout_ms >= 0) {
+		fprintf(stderr, "--async and --usb-timeout need a libusb device (--libusb)\n");
+		lbe_close_device(ctx.dev);
+		return 1;
+	}
+#endif
+	if (lbe_get_device_status(ctx.dev, &ctx.initial) < 0) {
+		lbe_close_device(ctx.dev);
+		return 1;
+	}
+
+	printf("Benchmarking LBE-%s over %s, %ld iterations per command\n",
+		lbe_get_model(ctx.dev) == LBE_1420 ? "1420" : "1421", lbe_get_transport_name(ctx.dev), iterations);
+
+	for (int op = 0; op < BENCH_OP_COUNT; op++) {
+		uint64_t start;
+
+		if (!enabled[op]) continue;
+		lbe_histogram_init(&hist[op]);
+		for (int i = 0; i < WARMUP_ITERATIONS; i++) {
+			run_op(&ctx, (enum bench_op)op);
+		}
+
+		start = lbe_now_ns();
+		for (long i = 0; i < iterations; i++) {
+			uint64_t t0 = lbe_now_ns();
+
+			if (run_op(&ctx, (enum bench_op)op) < 0) errors[op]++;
+			lbe_histogram_add(&hist[op], lbe_now_ns() - t0);
+		}
+		total_s[op] = (lbe_now_ns() - start) / 1e9;
+	}
+
+	for (int op = 0; op < BENCH_OP_COUNT; op++) {
+		if (!enabled[op]) continue;
+		lbe_histogram_print(stdout, op_names[op], &hist[op]);
+		printf("%-14s %8.0f ops/s, %llu errors\n", "",
+			total_s[op] > 0 ? (double)hist[op].count / total_s[op] : 0.0,
+			(unsigned long long)errors[op]);
+	}
+#ifdef HAVE_LIBUSB
+	if (async_depth > 0 && run_async(ctx.dev, iterations, async_depth) < 0) {
+		fprintf(stderr, "Asynchronous status reads did not complete\n");
+	}
+#endif
+
+	lbe_close_device(ctx.dev);
+	return 0;
+}
@@ -0,0 +1,174 @@
+#include "lbe_cmd.h"
+#include "lbe_common.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+/* Split buf in place on whitespace, returns the number of tokens found */
+static int split_tokens(char *buf, char **tokens, int max) {
+	int n = 0;
+
+	while (*buf) {
+		while (isspace((unsigned char)*buf)) *buf++ = '\0';
+		if (!*buf) break;
+		if (n == max) return n + 1;
+		tokens[n++] = buf;
+		while (*buf && !isspace((unsigned char)*buf)) buf++;
+	}
+	return n;
+}
+
+static int parse_u32(const char *s, uint32_t *value) {
+	char *end;
+	unsigned long v;
+
+	if (!s || !isdigit((unsigned char)*s)) return -1;
+	v = strtoul(s, &end, 10);
+	if (*end != '\0' || v > 0xFFFFFFFFUL) return -1;
+	*value = (uint32_t)v;
+	return 0;
+}
+
+int lbe_cmd_parse(const char *line, struct lbe_cmd *cmd) {
+	char buf[LBE_CMD_LINE_MAX];
+	char *tokens[2] = { NULL, NULL };
+	char *name, *arg;
+	int needs_arg = 1;
+	size_t n = strlen(line);
+
+	memset(cmd, 0, sizeof(*cmd));
+	if (n >= sizeof(buf)) return -1;
+	memcpy(buf, line, n + 1);
+
+	if (split_tokens(buf, tokens, 2) > 2) return -1;
+	name = tokens[0];
+	arg = tokens[1];
+	if (!name) return -1;
+
+	if (strcmp(name, "f1") == 0 || strcmp(name, "f2") == 0) {
+		cmd->op = LBE_CMD_SET_FREQ;
+		cmd->output = name[1] - '0';
+	} else if (strcmp(name, "f1t") == 0 || strcmp(name, "f2t") == 0) {
+		cmd->op = LBE_CMD_SET_FREQ_TEMP;
+		cmd->output = name[1] - '0';
+	} else if (strcmp(name, "out") == 0) {
+		cmd->op = LBE_CMD_OUTPUTS;
+	} else if (strcmp(name, "pll") == 0) {
+		cmd->op = LBE_CMD_PLL;
+	} else if (strcmp(name, "pps") == 0) {
+		cmd->op = LBE_CMD_PPS;
+	} else if (strcmp(name, "pwr1") == 0 || strcmp(name, "pwr2") == 0) {
+		cmd->op = LBE_CMD_POWER;
+		cmd->output = name[3] - '0';
+	} else if (strcmp(name, "blink") == 0) {
+		cmd->op = LBE_CMD_BLINK;
+		needs_arg = 0;
+	} else if (strcmp(name, "status") == 0) {
+		cmd->op = LBE_CMD_STATUS;
+		needs_arg = 0;
+	} else {
+		return -1;
+	}
+
+	if (!needs_arg) {
+		return arg ? -1 : 0;
+	}
+	if (parse_u32(arg, &cmd->value) < 0) return -1;
+
+	// Everything except the frequency setters takes a 0/1 flag
+	if (cmd->op != LBE_CMD_SET_FREQ && cmd->op != LBE_CMD_SET_FREQ_TEMP && cmd->value > 1) {
+		return -1;
+	}
+	return 0;
+}
+
+int lbe_cmd_execute(struct lbe_device* dev, const struct lbe_cmd *cmd, struct lbe_status *status) {
+	enum lbe_model model = lbe_get_model(dev);
+	unsigned long max_freq = (model == LBE_1420) ? LBE_1420_MAX_FREQ : LBE_1421_MAX_FREQ;
+	struct lbe_status tmp;
+	int res;
+
+	switch (cmd->op) {
+	case LBE_CMD_SET_FREQ:
+	case LBE_CMD_SET_FREQ_TEMP:
+		if ((cmd->output != 1 && cmd->output != 2) || (cmd->output == 2 && model == LBE_1420)) {
+			return LBE_CMD_ERR_INVALID;
+		}
+		if (cmd->value < 1 || cmd->value > max_freq) {
+			return LBE_CMD_ERR_INVALID;
+		}
+		if (cmd->op == LBE_CMD_SET_FREQ) {
+			res = lbe_set_frequency(dev, cmd->output, cmd->value);
+		} else {
+			res = lbe_set_frequency_temp(dev, cmd->output, cmd->value);
+		}
+		break;
+	case LBE_CMD_OUTPUTS:
+		res = lbe_set_outputs_enable(dev, cmd->value);
+		break;
+	case LBE_CMD_PLL:
+		res = lbe_set_pll_mode(dev, cmd->value);
+		break;
+	case LBE_CMD_PPS:
+		if (model != LBE_1421_DUALOUT) return LBE_CMD_ERR_INVALID;
+		res = lbe_set_1pps(dev, cmd->value);
+		break;
+	case LBE_CMD_POWER:
+		if ((cmd->output != 1 && cmd->output != 2) || (cmd->output == 2 && model == LBE_1420)) {
+			return LBE_CMD_ERR_INVALID;
+		}
+		res = lbe_set_power_level(dev, cmd->output, cmd->value);
+		break;
+	case LBE_CMD_BLINK:
+		res = lbe_blink_leds(dev);
+		break;
+	case LBE_CMD_STATUS:
+		res = lbe_get_device_status(dev, status ? status : &tmp);
+		break;
+	default:
+		return LBE_CMD_ERR_INVALID;
+	}
+
+	return res < 0 ? LBE_CMD_ERR_IO : 0;
+}
+
+int lbe_cmd_format_status(const struct lbe_status *status, char *buf, size_t len) {
+	return snprintf(buf, len,
+		"raw=0x%02X gps=%d pll=%d ant=%d out=%d f1=%u f2=%u fll=%d pps=%d pwr1=%d pwr2=%d",
+		status->raw_status,
+		(status->raw_status & LBE_GPS_LOCK_BIT) != 0,
+		status->pll_locked,
+		status->antenna_ok,
+		status->outputs_enabled,
+		status->frequency1,
+		status->frequency2,
+		status->fll_enabled,
+		status->pps_enabled,
+		status->out1_power_low,
+		status->out2_power_low);
+}
+
+int lbe_cmd_run_line(struct lbe_device* dev, const char *line, char *reply, size_t len) {
+	struct lbe_cmd cmd;
+	struct lbe_status status;
+	int res;
+
+	if (lbe_cmd_parse(line, &cmd) < 0) {
+		snprintf(reply, len, "ERR invalid command");
+		return LBE_CMD_ERR_INVALID;
+	}
+
+	res = lbe_cmd_execute(dev, &cmd, &status);
+	if (res == LBE_CMD_ERR_INVALID) {
+		snprintf(reply, len, "ERR not supported by this device or value out of range");
+	} else if (res < 0) {
+		snprintf(reply, len, "ERR device I/O failed");
+	} else if (cmd.op == LBE_CMD_STATUS) {
+		size_t n = (size_t)snprintf(reply, len, "OK ");
+		if (n < len) lbe_cmd_format_status(&status, reply + n, len - n);
+	} else {
+		snprintf(reply, len, "OK");
+	}
+	return res;
+}
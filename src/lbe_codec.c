@@ -0,0 +1,160 @@
+#include "lbe_codec.h"
+#include "lbe_common.h"
+#include "lbe_internal.h"
+#include <string.h>
+
+static const struct lbe_codec codecs[] = {
+	{
+		.model = LBE_1420,
+		.name = "LBE-1420",
+		.outputs = 1,
+		.flags = 0,
+		.max_frequency = LBE_1420_MAX_FREQ,
+		.set_frequency = { LBE_1420_SET_F1 },
+		.set_frequency_temp = { LBE_1420_SET_F1_TEMP },
+		.set_power = { LBE_1420_SET_PWR1 },
+		.frequency_offset = 1,
+		.outputs_on = 0x01,
+		.status_frequency = { 6 },
+		.status_fll = 18,
+		.status_power = { 10 },
+	},
+	{
+		.model = LBE_1421_DUALOUT,
+		.name = "LBE-1421",
+		.outputs = 2,
+		.flags = LBE_CODEC_HAS_PPS | LBE_CODEC_PLL_BIT | LBE_CODEC_OUTPUTS_BITS,
+		.max_frequency = LBE_1421_MAX_FREQ,
+		.set_frequency = { LBE_1421_SET_F1, LBE_1421_SET_F2 },
+		.set_frequency_temp = { LBE_1421_SET_F1_TEMP, LBE_1421_SET_F2_TEMP },
+		.set_power = { LBE_1421_SET_PWR1, LBE_1421_SET_PWR2 },
+		.frequency_offset = 5,
+		.outputs_on = 0x03,
+		.status_frequency = { 6, 14 },
+		.status_fll = 18,
+		.status_power = { 19, 20 },
+	},
+};
+
+/*
+ * The Windows tool has always sent the LBE-1421 power command (0x0D) to an
+ * LBE-1420 and read its pwr1 flag at the LBE-1421 offset, not the 0x07 and
+ * byte 10 used over hidraw. It is kept as is behind libusb until it has been
+ * checked on a real LBE-1420.
+ */
+static const struct lbe_codec codec_1420_libusb = {
+	.model = LBE_1420,
+	.name = "LBE-1420",
+	.outputs = 1,
+	.flags = 0,
+	.max_frequency = LBE_1420_MAX_FREQ,
+	.set_frequency = { LBE_1420_SET_F1 },
+	.set_frequency_temp = { LBE_1420_SET_F1_TEMP },
+	.set_power = { LBE_1421_SET_PWR1 },
+	.frequency_offset = 1,
+	.outputs_on = 0x01,
+	.status_frequency = { 6 },
+	.status_fll = 18,
+	.status_power = { 19 },
+};
+
+/* Unknown models get the LBE-1421 layout, as the decoder always did */
+const struct lbe_codec* lbe_codec_get(enum lbe_model model) {
+	for (size_t i = 0; i < sizeof(codecs) / sizeof(codecs[0]); i++) {
+		if (codecs[i].model == model) {
+			return &codecs[i];
+		}
+	}
+	return &codecs[1];
+}
+
+const struct lbe_codec* lbe_codec_get_libusb(enum lbe_model model) {
+	return model == LBE_1420 ? &codec_1420_libusb : lbe_codec_get(model);
+}
+
+static int check_output(const struct lbe_codec *codec, int output) {
+	if (output >= 1 && output <= codec->outputs) {
+		return 0;
+	}
+	if (codec->outputs == 1) {
+		lbe_log(LBE_LOG_ERROR, "%s only supports output 1", codec->name);
+	} else {
+		lbe_log(LBE_LOG_ERROR, "Invalid output selection");
+	}
+	return -1;
+}
+
+static void put_u32(uint8_t *p, uint32_t value) {
+	p[0] = (value >>  0) & 0xff;
+	p[1] = (value >>  8) & 0xff;
+	p[2] = (value >> 16) & 0xff;
+	p[3] = (value >> 24) & 0xff;
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+int lbe_codec_frequency(const struct lbe_codec *codec, int output, uint32_t frequency, int temp, uint8_t *buf) {
+	memset(buf, 0, LBE_REPORT_SIZE);
+	if (check_output(codec, output) < 0) {
+		return -1;
+	}
+	buf[0] = temp ? codec->set_frequency_temp[output - 1] : codec->set_frequency[output - 1];
+	put_u32(&buf[codec->frequency_offset], frequency);
+	return 0;
+}
+
+int lbe_codec_power(const struct lbe_codec *codec, int output, int low_power, uint8_t *buf) {
+	memset(buf, 0, LBE_REPORT_SIZE);
+	if (check_output(codec, output) < 0) {
+		return -1;
+	}
+	buf[0] = codec->set_power[output - 1];
+	buf[1] = low_power ? 0x01 : 0x00;
+	return 0;
+}
+
+int lbe_codec_pps(const struct lbe_codec *codec, int enable, uint8_t *buf) {
+	memset(buf, 0, LBE_REPORT_SIZE);
+	if (!(codec->flags & LBE_CODEC_HAS_PPS)) {
+		lbe_log(LBE_LOG_ERROR, "1PPS control is only supported on LBE-1421");
+		return -1;
+	}
+	buf[0] = LBE_1421_SET_PPS;
+	buf[1] = enable ? 0x01 : 0x00;
+	return 0;
+}
+
+void lbe_codec_outputs_enable(const struct lbe_codec *codec, int enable, uint8_t *buf) {
+	memset(buf, 0, LBE_REPORT_SIZE);
+	buf[0] = LBE_142X_EN_OUT;
+	buf[1] = enable ? codec->outputs_on : 0x00;
+}
+
+void lbe_codec_pll_mode(int fll_mode, uint8_t *buf) {
+	memset(buf, 0, LBE_REPORT_SIZE);
+	buf[0] = LBE_142X_SET_PLL;
+	buf[1] = fll_mode ? 0x01 : 0x00;
+}
+
+void lbe_codec_blink(uint8_t *buf) {
+	memset(buf, 0, LBE_REPORT_SIZE);
+	buf[0] = LBE_142X_BLINK_OUT;
+}
+
+void lbe_codec_decode(const struct lbe_codec *codec, const uint8_t *buf, struct lbe_status *status) {
+	uint8_t raw = buf[1];
+
+	status->raw_status = raw;
+	status->frequency1 = codec->status_frequency[0] ? get_u32(&buf[codec->status_frequency[0]]) : 0;
+	status->frequency2 = codec->status_frequency[1] ? get_u32(&buf[codec->status_frequency[1]]) : 0;
+	status->fll_enabled = buf[codec->status_fll] != 0;
+	status->out1_power_low = codec->status_power[0] ? buf[codec->status_power[0]] != 0 : 0;
+	status->out2_power_low = codec->status_power[1] ? buf[codec->status_power[1]] != 0 : 0;
+	status->antenna_ok = (raw & LBE_ANT_OK_BIT) != 0;
+	status->pll_locked = (codec->flags & LBE_CODEC_PLL_BIT) ? (raw & LBE_PLL_LOCK_BIT) != 0 : 0;
+	status->pps_enabled = (codec->flags & LBE_CODEC_HAS_PPS) ? (raw & LBE_PPS_EN_BIT) != 0 : 0;
+	// The LBE-1420 seems to report outputs as always on, even with the vendor software
+	status->outputs_enabled = (codec->flags & LBE_CODEC_OUTPUTS_BITS) ? (raw & 0x7F) == 0x7F : 1;
+}
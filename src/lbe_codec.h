@@ -0,0 +1,56 @@
+#ifndef LBE_CODEC_H
+#define LBE_CODEC_H
+
+/*
+ * Report layouts of each model, not part of the public API. Every SET
+ * report and the status decoder are driven by one descriptor per model,
+ * picked when the device is opened, instead of per-command model branches.
+ */
+
+#include "lbe_device.h"
+#include <stdint.h>
+
+#define LBE_CODEC_MAX_OUTPUTS 2
+
+/* Descriptor flags */
+#define LBE_CODEC_HAS_PPS      0x01 // 1PPS output can be switched
+#define LBE_CODEC_PLL_BIT      0x02 // LBE_PLL_LOCK_BIT is meaningful
+#define LBE_CODEC_OUTPUTS_BITS 0x04 // outputs_enabled follows the status bits
+
+struct lbe_codec {
+	enum lbe_model model;
+	const char *name;
+	int outputs;
+	unsigned int flags;
+	uint32_t max_frequency;
+
+	// SET reports, indexed by output - 1
+	uint8_t set_frequency[LBE_CODEC_MAX_OUTPUTS];
+	uint8_t set_frequency_temp[LBE_CODEC_MAX_OUTPUTS];
+	uint8_t set_power[LBE_CODEC_MAX_OUTPUTS];
+	uint8_t frequency_offset;  // little-endian u32 after the command code
+	uint8_t outputs_on;        // EN_OUT value enabling every output
+
+	// Status report, an offset of 0 marks a field the model lacks
+	uint8_t status_frequency[LBE_CODEC_MAX_OUTPUTS];
+	uint8_t status_fll;
+	uint8_t status_power[LBE_CODEC_MAX_OUTPUTS];
+};
+
+const struct lbe_codec* lbe_codec_get(enum lbe_model model);
+const struct lbe_codec* lbe_codec_get_libusb(enum lbe_model model);
+
+/* Replaces the codec lbe_open_transport() picked from the model */
+void lbe_set_codec(struct lbe_device* dev, const struct lbe_codec *codec);
+
+/* Encoders fill a whole LBE_REPORT_SIZE buffer, -1 for an invalid request */
+int lbe_codec_frequency(const struct lbe_codec *codec, int output, uint32_t frequency, int temp, uint8_t *buf);
+int lbe_codec_power(const struct lbe_codec *codec, int output, int low_power, uint8_t *buf);
+int lbe_codec_pps(const struct lbe_codec *codec, int enable, uint8_t *buf);
+void lbe_codec_outputs_enable(const struct lbe_codec *codec, int enable, uint8_t *buf);
+void lbe_codec_pll_mode(int fll_mode, uint8_t *buf);
+void lbe_codec_blink(uint8_t *buf);
+
+void lbe_codec_decode(const struct lbe_codec *codec, const uint8_t *buf, struct lbe_status *status);
+
+#endif // LBE_CODEC_H
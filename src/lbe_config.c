@@ -0,0 +1,180 @@
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "lbe_config.h"
+#include "lbe_common.h"
+#include "lbe_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+static char* trim(char *s) {
+	char *end;
+
+	while (isspace((unsigned char)*s)) s++;
+	end = s + strlen(s);
+	while (end > s && isspace((unsigned char)end[-1])) *--end = '\0';
+	return s;
+}
+
+static int parse_line(char *line, struct lbe_config *cfg) {
+	char *key, *value, *sep, *end;
+	unsigned long v;
+
+	sep = strchr(line, '=');
+	if (!sep) sep = strpbrk(line, " \t");
+	if (!sep) return -1;
+	*sep = '\0';
+	key = trim(line);
+	value = trim(sep + 1);
+
+	v = strtoul(value, &end, 10);
+	if (!*value || *end || v > 0xFFFFFFFFUL) return -1;
+	if (strcmp(key, "f1") != 0 && strcmp(key, "f2") != 0 && v > 1) return -1;
+
+	if (strcmp(key, "f1") == 0) {
+		cfg->frequency1 = (uint32_t)v;
+		cfg->set |= LBE_CONFIG_F1;
+	} else if (strcmp(key, "f2") == 0) {
+		cfg->frequency2 = (uint32_t)v;
+		cfg->set |= LBE_CONFIG_F2;
+	} else if (strcmp(key, "persist") == 0) {
+		cfg->persist = (int)v;
+	} else if (strcmp(key, "out") == 0) {
+		cfg->outputs_enabled = (int)v;
+		cfg->set |= LBE_CONFIG_OUTPUTS;
+	} else if (strcmp(key, "pll") == 0) {
+		cfg->fll_enabled = (int)v;
+		cfg->set |= LBE_CONFIG_FLL;
+	} else if (strcmp(key, "pps") == 0) {
+		cfg->pps_enabled = (int)v;
+		cfg->set |= LBE_CONFIG_PPS;
+	} else if (strcmp(key, "pwr1") == 0) {
+		cfg->out1_power_low = (int)v;
+		cfg->set |= LBE_CONFIG_PWR1;
+	} else if (strcmp(key, "pwr2") == 0) {
+		cfg->out2_power_low = (int)v;
+		cfg->set |= LBE_CONFIG_PWR2;
+	} else {
+		return -1;
+	}
+	return 0;
+}
+
+int lbe_config_load(const char *path, struct lbe_config *cfg) {
+	char line[256];
+	int lineno = 0;
+	FILE *f;
+
+	memset(cfg, 0, sizeof(*cfg));
+	f = fopen(path, "r");
+	if (!f) {
+		lbe_log_errno(path);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		char *comment = strchr(line, '#');
+		char *content;
+
+		lineno++;
+		if (comment) *comment = '\0';
+		content = trim(line);
+		if (!*content) continue;
+		if (parse_line(content, cfg) < 0) {
+			lbe_log(LBE_LOG_ERROR, "%s:%d: invalid config line", path, lineno);
+			fclose(f);
+			return -1;
+		}
+	}
+
+	fclose(f);
+	return 0;
+}
+
+static void add_cmd(struct lbe_cmd *cmds, int *n, enum lbe_cmd_op op, int output, uint32_t value) {
+	cmds[*n].op = op;
+	cmds[*n].output = output;
+	cmds[*n].value = value;
+	(*n)++;
+}
+
+/* Compute the reports needed to move from status to cfg. Disabling the
+ * outputs goes first and enabling them goes last, so a unit never drives its
+ * outputs with a half applied configuration. Returns the number of commands,
+ * or -1 if cfg asks for something the model cannot do, including an out of
+ * range frequency, before any command is produced. */
+int lbe_config_diff(const struct lbe_config *cfg, const struct lbe_status *status, enum lbe_model model,
+		struct lbe_cmd *cmds, int max) {
+	enum lbe_cmd_op freq_op = cfg->persist ? LBE_CMD_SET_FREQ : LBE_CMD_SET_FREQ_TEMP;
+	uint32_t max_freq = model == LBE_1420 ? LBE_1420_MAX_FREQ : LBE_1421_MAX_FREQ;
+	uint8_t out_bits = status->raw_status & (LBE_OUT1_EN_BIT | LBE_OUT2_EN_BIT);
+	// The LBE-1420 does not report its output state, so always send it
+	int need_disable = model == LBE_1420 || out_bits != 0;
+	int need_enable = model == LBE_1420 || out_bits != (LBE_OUT1_EN_BIT | LBE_OUT2_EN_BIT);
+	int n = 0;
+
+	if (max < LBE_CONFIG_MAX_CMDS) return -1;
+	if (model == LBE_1420 && (cfg->set & (LBE_CONFIG_F2 | LBE_CONFIG_PPS | LBE_CONFIG_PWR2))) {
+		lbe_log(LBE_LOG_ERROR, "Config uses OUT2/1PPS settings not supported on LBE-1420");
+		return -1;
+	}
+	// Checked up front: a report rejected halfway would leave the outputs disabled
+	if (((cfg->set & LBE_CONFIG_F1) && (cfg->frequency1 < 1 || cfg->frequency1 > max_freq)) ||
+	    ((cfg->set & LBE_CONFIG_F2) && (cfg->frequency2 < 1 || cfg->frequency2 > max_freq))) {
+		lbe_log(LBE_LOG_ERROR, "Config frequency out of range (1-%lu Hz)", (unsigned long)max_freq);
+		return -1;
+	}
+
+	if ((cfg->set & LBE_CONFIG_OUTPUTS) && !cfg->outputs_enabled && need_disable) {
+		add_cmd(cmds, &n, LBE_CMD_OUTPUTS, 0, 0);
+	}
+	// The status only shows the running frequency, which may be a temporary one
+	// that differs from flash, so persist always writes
+	if ((cfg->set & LBE_CONFIG_F1) && (cfg->persist || status->frequency1 != cfg->frequency1)) {
+		add_cmd(cmds, &n, freq_op, 1, cfg->frequency1);
+	}
+	if ((cfg->set & LBE_CONFIG_F2) && (cfg->persist || status->frequency2 != cfg->frequency2)) {
+		add_cmd(cmds, &n, freq_op, 2, cfg->frequency2);
+	}
+	if ((cfg->set & LBE_CONFIG_FLL) && !status->fll_enabled != !cfg->fll_enabled) {
+		add_cmd(cmds, &n, LBE_CMD_PLL, 0, (uint32_t)cfg->fll_enabled);
+	}
+	if ((cfg->set & LBE_CONFIG_PPS) && !status->pps_enabled != !cfg->pps_enabled) {
+		add_cmd(cmds, &n, LBE_CMD_PPS, 0, (uint32_t)cfg->pps_enabled);
+	}
+	if ((cfg->set & LBE_CONFIG_PWR1) && !status->out1_power_low != !cfg->out1_power_low) {
+		add_cmd(cmds, &n, LBE_CMD_POWER, 1, (uint32_t)cfg->out1_power_low);
+	}
+	if ((cfg->set & LBE_CONFIG_PWR2) && !status->out2_power_low != !cfg->out2_power_low) {
+		add_cmd(cmds, &n, LBE_CMD_POWER, 2, (uint32_t)cfg->out2_power_low);
+	}
+	if ((cfg->set & LBE_CONFIG_OUTPUTS) && cfg->outputs_enabled && need_enable) {
+		add_cmd(cmds, &n, LBE_CMD_OUTPUTS, 0, 1);
+	}
+	return n;
+}
+
+/* One status read plus only the reports that change something.
+ * Returns the number of reports sent, or -1 on error. */
+int lbe_apply_config(struct lbe_device* dev, const struct lbe_config *cfg) {
+	struct lbe_cmd cmds[LBE_CONFIG_MAX_CMDS];
+	struct lbe_status status;
+	int n;
+
+	if (lbe_get_device_status(dev, &status) < 0) {
+		return -1;
+	}
+	n = lbe_config_diff(cfg, &status, lbe_get_model(dev), cmds, LBE_CONFIG_MAX_CMDS);
+	if (n < 0) {
+		return -1;
+	}
+	for (int i = 0; i < n; i++) {
+		if (lbe_cmd_execute(dev, &cmds[i], NULL) < 0) {
+			return -1;
+		}
+	}
+	return n;
+}
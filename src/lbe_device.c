@@ -0,0 +1,381 @@
+#include "lbe_device.h"
+#include "lbe_clock.h"
+#include "lbe_codec.h"
+#include "lbe_internal.h"
+#include "lbe_probes.h"
+#include "lbe_stats.h"
+#include "lbe_thread.h"
+#include "lbe_transport.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#ifndef _WIN32
+#include <time.h>
+#endif
+
+// Command codes below 16 get their own stats slot, then status, then the rest
+#define STATS_SLOT_STATUS 16
+#define STATS_SLOT_OTHER  17
+
+/*
+ * A handle may be shared between threads. Reports go out one at a time in
+ * ticket order, so callers are served FIFO whatever the scheduler does.
+ * A status read arriving while another one is queued or in progress waits
+ * for that one and reuses its report instead of taking its own turn. Since
+ * that read was queued no earlier than the caller's own previous reports
+ * completed, the shared report still reflects them.
+ */
+struct lbe_device {
+	const struct lbe_transport_ops *ops;
+	void *ctx;
+	enum lbe_model model;
+	const struct lbe_codec *codec;
+	char path[LBE_PATH_MAX];
+
+	lbe_mutex_t lock;
+	lbe_cond_t cond;
+	uint64_t next_ticket;
+	uint64_t now_serving;
+	int read_pending;                     // a status read is queued or in flight
+	uint64_t read_gen;                    // completed status reads
+	int read_result;
+	uint8_t read_report[LBE_REPORT_SIZE];
+
+	// Held across a lock change, which may wait; lock_mode and lock_stats are under lock
+	lbe_mutex_t lock_op;
+	enum lbe_lock_mode lock_mode;
+	struct lbe_lock_stats lock_stats;
+
+	// Allocated on the first report with that code, the histograms are large
+	struct lbe_cmd_stats *cmd_stats[LBE_CMD_STATS_MAX];
+};
+
+#define LBE_STR(x) #x
+#define LBE_XSTR(x) LBE_STR(x)
+
+unsigned int lbe_version(void) {
+	return LBE142X_VERSION;
+}
+
+const char* lbe_version_string(void) {
+	return LBE_XSTR(LBE142X_VERSION_MAJOR) "." LBE_XSTR(LBE142X_VERSION_MINOR) "." LBE_XSTR(LBE142X_VERSION_PATCH);
+}
+
+/* Takes ownership of ctx, which is released through ops->close */
+struct lbe_device* lbe_open_transport(const struct lbe_transport_ops *ops, void *ctx,
+		enum lbe_model model, const char *path) {
+	struct lbe_device* dev = malloc(sizeof(struct lbe_device));
+	if (!dev) {
+		if (ops->close) ops->close(ctx);
+		return NULL;
+	}
+
+	memset(dev, 0, sizeof(*dev));
+	dev->ops = ops;
+	dev->ctx = ctx;
+	dev->model = model;
+	dev->codec = lbe_codec_get(model);
+	snprintf(dev->path, sizeof(dev->path), "%s", path ? path : "");
+	lbe_mutex_init(&dev->lock);
+	lbe_mutex_init(&dev->lock_op);
+	lbe_cond_init(&dev->cond);
+	return dev;
+}
+
+/* No other thread may still be using the handle */
+void lbe_close_device(struct lbe_device* dev) {
+	if (dev) {
+		if (dev->ops->close) dev->ops->close(dev->ctx);
+		lbe_cond_destroy(&dev->cond);
+		lbe_mutex_destroy(&dev->lock_op);
+		lbe_mutex_destroy(&dev->lock);
+		for (int i = 0; i < LBE_CMD_STATS_MAX; i++) {
+			free(dev->cmd_stats[i]);
+		}
+		free(dev);
+	}
+}
+
+void lbe_set_codec(struct lbe_device* dev, const struct lbe_codec *codec) {
+	dev->codec = codec;
+}
+
+enum lbe_model lbe_get_model(struct lbe_device* dev) {
+	return dev->model;
+}
+
+const char* lbe_get_path(struct lbe_device* dev) {
+	return dev->path;
+}
+
+const char* lbe_get_transport_name(struct lbe_device* dev) {
+	return dev->ops->name;
+}
+
+void* lbe_get_transport_ctx(struct lbe_device* dev) {
+	return dev->ctx;
+}
+
+/* Called with dev->lock held, returns with it held once it is our turn */
+static void wait_turn(struct lbe_device* dev) {
+	uint64_t ticket = dev->next_ticket++;
+
+	while (dev->now_serving != ticket) {
+		lbe_cond_wait(&dev->cond, &dev->lock);
+	}
+}
+
+static void end_turn(struct lbe_device* dev) {
+	dev->now_serving++;
+	lbe_cond_broadcast(&dev->cond);
+}
+
+/* Called with dev->lock held. Statistics are best effort, a failed
+ * allocation only loses them. */
+static void account_report(struct lbe_device* dev, uint8_t code, int res, uint64_t latency_ns) {
+	int slot = code < 16 ? code : (code == LBE_STATUS_REPORT_ID ? STATS_SLOT_STATUS : STATS_SLOT_OTHER);
+	struct lbe_cmd_stats *s = dev->cmd_stats[slot];
+
+	if (!s) {
+		s = calloc(1, sizeof(*s));
+		if (!s) return;
+		s->code = code;
+		lbe_histogram_init(&s->latency_ns);
+		dev->cmd_stats[slot] = s;
+	}
+	s->calls++;
+	if (res < 0) {
+		s->errors++;
+	} else {
+		s->bytes += LBE_REPORT_SIZE;
+	}
+	lbe_histogram_add(&s->latency_ns, latency_ns);
+}
+
+static int send_report(struct lbe_device* dev, const uint8_t *buf) {
+	uint64_t start_ns, latency_ns;
+	int res;
+
+	lbe_mutex_lock(&dev->lock);
+	wait_turn(dev);
+	lbe_mutex_unlock(&dev->lock);
+
+	LBE_PROBE2(report_submit, dev, buf[0]);
+	start_ns = lbe_now_ns();
+	res = dev->ops->set_feature(dev->ctx, buf, LBE_REPORT_SIZE);
+	latency_ns = lbe_now_ns() - start_ns;
+	LBE_PROBE4(report_complete, dev, buf[0], res, latency_ns);
+
+	lbe_mutex_lock(&dev->lock);
+	account_report(dev, buf[0], res, latency_ns);
+	end_turn(dev);
+	lbe_mutex_unlock(&dev->lock);
+	return res;
+}
+
+/* Undecoded status report, for recording or fields lbe_status lacks */
+int lbe_get_raw_report(struct lbe_device* dev, uint8_t *buf, size_t len) {
+	uint64_t start_ns, latency_ns;
+	int res;
+
+	if (len < LBE_REPORT_SIZE) {
+		lbe_log(LBE_LOG_ERROR, "Report buffer too small");
+		return -1;
+	}
+
+	lbe_mutex_lock(&dev->lock);
+	if (dev->read_pending) {
+		uint64_t gen = dev->read_gen;
+
+		while (dev->read_gen == gen) {
+			lbe_cond_wait(&dev->cond, &dev->lock);
+		}
+		res = dev->read_result;
+		memcpy(buf, dev->read_report, LBE_REPORT_SIZE);
+		lbe_mutex_unlock(&dev->lock);
+		return res;
+	}
+	dev->read_pending = 1;
+	wait_turn(dev);
+	lbe_mutex_unlock(&dev->lock);
+
+	memset(buf, 0, LBE_REPORT_SIZE);
+	buf[0] = LBE_STATUS_REPORT_ID; // Report Number
+	LBE_PROBE2(report_submit, dev, LBE_STATUS_REPORT_ID);
+	start_ns = lbe_now_ns();
+	res = dev->ops->get_feature(dev->ctx, buf, LBE_REPORT_SIZE);
+	latency_ns = lbe_now_ns() - start_ns;
+	LBE_PROBE4(report_complete, dev, LBE_STATUS_REPORT_ID, res, latency_ns);
+
+	lbe_mutex_lock(&dev->lock);
+	account_report(dev, LBE_STATUS_REPORT_ID, res, latency_ns);
+	dev->read_result = res;
+	memcpy(dev->read_report, buf, LBE_REPORT_SIZE);
+	dev->read_pending = 0;
+	dev->read_gen++;
+	end_turn(dev);
+	lbe_mutex_unlock(&dev->lock);
+	return res;
+}
+
+void lbe_decode_status(enum lbe_model model, const uint8_t *buf, struct lbe_status* status) {
+	lbe_codec_decode(lbe_codec_get(model), buf, status);
+}
+
+/* Same as lbe_decode_status() with the layout of the transport dev uses */
+void lbe_decode_device_report(struct lbe_device* dev, const uint8_t *buf, struct lbe_status* status) {
+	lbe_codec_decode(dev->codec, buf, status);
+}
+
+int lbe_get_device_status(struct lbe_device* dev, struct lbe_status* status) {
+	uint8_t buf[LBE_REPORT_SIZE];
+
+	if (lbe_get_raw_report(dev, buf, sizeof(buf)) < 0) {
+		return -1;
+	}
+	lbe_codec_decode(dev->codec, buf, status);
+	return 0;
+}
+
+static int set_frequency(struct lbe_device* dev, int output, uint32_t frequency, int temp) {
+	uint8_t buf[LBE_REPORT_SIZE];
+
+	if (lbe_codec_frequency(dev->codec, output, frequency, temp, buf) < 0) {
+		return -1;
+	}
+	return send_report(dev, buf);
+}
+
+int lbe_set_frequency(struct lbe_device* dev, int output, uint32_t frequency) {
+	return set_frequency(dev, output, frequency, 0);
+}
+
+int lbe_set_frequency_temp(struct lbe_device* dev, int output, uint32_t frequency) {
+	return set_frequency(dev, output, frequency, 1);
+}
+
+int lbe_set_outputs_enable(struct lbe_device* dev, int enable) {
+	uint8_t buf[LBE_REPORT_SIZE];
+
+	lbe_codec_outputs_enable(dev->codec, enable, buf);
+	return send_report(dev, buf);
+}
+
+/* Encoding ahead of time leaves only the transport call for the send */
+int lbe_prepare_frequency_temp(struct lbe_device* dev, int output, uint32_t frequency, struct lbe_report *report) {
+	return lbe_codec_frequency(dev->codec, output, frequency, 1, report->buf);
+}
+
+int lbe_prepare_outputs_enable(struct lbe_device* dev, int enable, struct lbe_report *report) {
+	lbe_codec_outputs_enable(dev->codec, enable, report->buf);
+	return 0;
+}
+
+int lbe_send_prepared(struct lbe_device* dev, const struct lbe_report *report) {
+	return send_report(dev, report->buf);
+}
+
+int lbe_blink_leds(struct lbe_device* dev) {
+	uint8_t buf[LBE_REPORT_SIZE];
+
+	lbe_codec_blink(buf);
+	return send_report(dev, buf);
+}
+
+int lbe_set_pll_mode(struct lbe_device* dev, int fll_mode) {
+	uint8_t buf[LBE_REPORT_SIZE];
+
+	lbe_codec_pll_mode(fll_mode, buf);
+	return send_report(dev, buf);
+}
+
+int lbe_set_1pps(struct lbe_device* dev, int enable) {
+	uint8_t buf[LBE_REPORT_SIZE];
+
+	if (lbe_codec_pps(dev->codec, enable, buf) < 0) {
+		return -1;
+	}
+	return send_report(dev, buf);
+}
+
+int lbe_set_power_level(struct lbe_device* dev, int output, int low_power) {
+	uint8_t buf[LBE_REPORT_SIZE];
+
+	if (lbe_codec_power(dev->codec, output, low_power, buf) < 0) {
+		return -1;
+	}
+	return send_report(dev, buf);
+}
+
+/* Cross-process lock, see lbe_device.h. Taking it again switches the mode. */
+int lbe_lock_device(struct lbe_device* dev, enum lbe_lock_mode mode, int timeout_ms) {
+	enum lbe_lock_mode current;
+	uint64_t waited_ns = 0;
+	int res;
+
+	// Reports keep flowing on dev->lock while another thread waits for the unit
+	lbe_mutex_lock(&dev->lock_op);
+	lbe_mutex_lock(&dev->lock);
+	current = dev->lock_mode;
+	if (!dev->ops->lock || mode == current) {
+		dev->lock_mode = mode;
+		lbe_mutex_unlock(&dev->lock);
+		lbe_mutex_unlock(&dev->lock_op);
+		return 0;
+	}
+	lbe_mutex_unlock(&dev->lock);
+
+	res = dev->ops->lock(dev->ctx, mode, timeout_ms, &waited_ns);
+
+	lbe_mutex_lock(&dev->lock);
+	if (mode == LBE_LOCK_UNLOCKED) {
+		if (res >= 0) dev->lock_mode = LBE_LOCK_UNLOCKED;
+	} else {
+		dev->lock_stats.wait_ns += waited_ns;
+		if (waited_ns > dev->lock_stats.max_wait_ns) {
+			dev->lock_stats.max_wait_ns = waited_ns;
+		}
+		if (res < 0) {
+			dev->lock_stats.timeouts++;
+		} else {
+			if (res > 0) dev->lock_stats.contended++;
+			dev->lock_stats.acquired++;
+			dev->lock_mode = mode;
+		}
+	}
+	lbe_mutex_unlock(&dev->lock);
+	lbe_mutex_unlock(&dev->lock_op);
+	return res < 0 ? -1 : 0;
+}
+
+int lbe_unlock_device(struct lbe_device* dev) {
+	return lbe_lock_device(dev, LBE_LOCK_UNLOCKED, 0);
+}
+
+void lbe_get_lock_stats(struct lbe_device* dev, struct lbe_lock_stats *stats) {
+	lbe_mutex_lock(&dev->lock);
+	*stats = dev->lock_stats;
+	lbe_mutex_unlock(&dev->lock);
+}
+
+int lbe_get_cmd_stats(struct lbe_device* dev, struct lbe_cmd_stats *list, int max) {
+	int n = 0;
+
+	lbe_mutex_lock(&dev->lock);
+	for (int i = 0; i < LBE_CMD_STATS_MAX && n < max; i++) {
+		if (dev->cmd_stats[i]) {
+			list[n++] = *dev->cmd_stats[i];
+		}
+	}
+	lbe_mutex_unlock(&dev->lock);
+	return n;
+}
+
+void lbe_reset_cmd_stats(struct lbe_device* dev) {
+	lbe_mutex_lock(&dev->lock);
+	for (int i = 0; i < LBE_CMD_STATS_MAX; i++) {
+		free(dev->cmd_stats[i]);
+		dev->cmd_stats[i] = NULL;
+	}
+	lbe_mutex_unlock(&dev->lock);
+}
@@ -1,321 +1,383 @@
 #ifdef __linux__
 
 #include "lbe_device.h"
+#include "lbe_clock.h"
 #include "lbe_common.h"
+#include "lbe_internal.h"
+#include "lbe_transport.h"
+#include "lbe_probes.h"
+#ifdef LBE_WITH_LIBUSB
+#include "lbe_libusb.h"
+#endif
 #include <linux/hidraw.h>
 #include <sys/ioctl.h>
+#include <sys/file.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
-#include <dirent.h>
+#include <limits.h>
+#include <time.h>
+#include <libudev.h>
+
+// Bounded lock waits poll flock(LOCK_NB) with a doubling back-off up to this
+#define LOCK_POLL_MAX_NS 5000000L
 
-#define REPORT_SIZE 60
+// Last opened node and its identity, kept under $XDG_RUNTIME_DIR
+#define DEVICE_CACHE_NAME "lbe142x.device"
 
 #ifndef HIDIOCSFEATURE
 #define HIDIOCSFEATURE(len)    _IOC(_IOC_WRITE|_IOC_READ, 'H', 0x06, len)
 #define HIDIOCGFEATURE(len)    _IOC(_IOC_WRITE|_IOC_READ, 'H', 0x07, len)
 #endif
 
-struct lbe_device {
+struct hidraw_transport {
 	int fd;
 	struct hidraw_devinfo raw_info;
-	enum lbe_model model;
 };
 
-static int is_lbe_device(const char *path) {
-	int fd;
-	struct hidraw_devinfo info;
+static int is_lbe_id(uint32_t vendor, uint32_t product) {
+	return vendor == VID_LBE && (product == PID_LBE_1420 || product == PID_LBE_1421);
+}
 
-	fd = open(path, O_RDWR);
-	if (fd < 0) return 0;
+static void copy_string(char *dst, size_t len, const char *src) {
+	snprintf(dst, len, "%s", src ? src : "");
+}
 
-	if (ioctl(fd, HIDIOCGRAWINFO, &info) < 0) {
-		close(fd);
-		return 0;
+/* Fill info from the udev database only, the hidraw node is never opened.
+ * Returns 0 for an LBE-142x node and -1 for anything else. */
+int lbe_udev_get_info(struct udev_device *hidraw, struct lbe_device_info *info) {
+	struct udev_device *hid, *usb;
+	const char *hid_id, *node;
+	unsigned int bus, vendor, product;
+
+	node = udev_device_get_devnode(hidraw);
+	hid = udev_device_get_parent_with_subsystem_devtype(hidraw, "hid", NULL);
+	if (!node || !hid) return -1;
+
+	// HID_ID is "<bus>:<vendor>:<product>", e.g. "0003:00001DD2:00002444"
+	hid_id = udev_device_get_property_value(hid, "HID_ID");
+	if (!hid_id || sscanf(hid_id, "%x:%x:%x", &bus, &vendor, &product) != 3) return -1;
+	if (!is_lbe_id(vendor, product)) return -1;
+
+	memset(info, 0, sizeof(*info));
+	copy_string(info->path, sizeof(info->path), node);
+	copy_string(info->serial, sizeof(info->serial), udev_device_get_property_value(hid, "HID_UNIQ"));
+	usb = udev_device_get_parent_with_subsystem_devtype(hidraw, "usb", "usb_device");
+	if (usb) {
+		copy_string(info->usb_path, sizeof(info->usb_path), udev_device_get_sysname(usb));
+		if (!info->serial[0]) {
+			copy_string(info->serial, sizeof(info->serial), udev_device_get_sysattr_value(usb, "serial"));
+		}
 	}
-
-	close(fd);
-	return (info.vendor == VID_LBE && (info.product == PID_LBE_1420 || info.product == PID_LBE_1421));
+	info->vendor_id = (uint16_t)vendor;
+	info->product_id = (uint16_t)product;
+	info->model = (product == PID_LBE_1420) ? LBE_1420 : LBE_1421_DUALOUT;
+	return 0;
 }
 
-struct lbe_device* lbe_open_device(void) {
-	struct lbe_device* dev = malloc(sizeof(struct lbe_device));
-	if (!dev) return NULL;
+static int enumerate_hidraw(struct lbe_device_info *list, int max) {
+	struct udev *udev;
+	struct udev_enumerate *enumerate;
+	struct udev_list_entry *entry;
+	int count = 0;
 
-	DIR *dir;
-	struct dirent *ent;
-	char path[PATH_MAX];
+	udev = udev_new();
+	if (!udev) {
+		lbe_log(LBE_LOG_ERROR, "Failed to create udev context");
+		return -1;
+	}
 
-	dir = opendir("/dev");
-	if (dir == NULL) {
-		perror("Failed to open /dev");
-		free(dev);
-		return NULL;
+	enumerate = udev_enumerate_new(udev);
+	if (!enumerate) {
+		lbe_log(LBE_LOG_ERROR, "Failed to create udev enumeration");
+		udev_unref(udev);
+		return -1;
 	}
+	udev_enumerate_add_match_subsystem(enumerate, "hidraw");
+	udev_enumerate_scan_devices(enumerate);
 
-	while ((ent = readdir(dir)) != NULL) {
-		if (strncmp(ent->d_name, "hidraw", 6) == 0) {
-			snprintf(path, sizeof(path), "/dev/%s", ent->d_name);
-			if (is_lbe_device(path)) {
-				dev->fd = open(path, O_RDWR);
-				if (dev->fd < 0) {
-					perror("Failed to open device");
-					free(dev);
-					closedir(dir);
-					return NULL;
-				}
-				if (ioctl(dev->fd, HIDIOCGRAWINFO, &dev->raw_info) < 0) {
-					perror("HIDIOCGRAWINFO");
-					close(dev->fd);
-					free(dev);
-					closedir(dir);
-					return NULL;
-				}
-				dev->model = (dev->raw_info.product == PID_LBE_1420) ? LBE_1420 : LBE_1421_DUALOUT;
-				closedir(dir);
-				return dev;
-			}
+	udev_list_entry_foreach(entry, udev_enumerate_get_list_entry(enumerate)) {
+		struct udev_device *hidraw;
+
+		if (count >= max) break;
+		hidraw = udev_device_new_from_syspath(udev, udev_list_entry_get_name(entry));
+		if (!hidraw) continue;
+		if (lbe_udev_get_info(hidraw, &list[count]) == 0) {
+			count++;
 		}
+		udev_device_unref(hidraw);
 	}
 
-	fprintf(stderr, "LBE-142x device not found\n");
-	closedir(dir);
-	free(dev);
-	return NULL;
+	udev_enumerate_unref(enumerate);
+	udev_unref(udev);
+	return count;
 }
 
-void lbe_close_device(struct lbe_device* dev) {
-	if (dev) {
-		close(dev->fd);
-		free(dev);
-	}
-}
+int lbe_enumerate_devices(struct lbe_device_info *list, int max) {
+	int count;
 
-enum lbe_model lbe_get_model(struct lbe_device* dev) {
-	return dev->model;
+	LBE_PROBE0(enumerate_start);
+	count = enumerate_hidraw(list, max);
+	LBE_PROBE1(enumerate_done, count);
+	return count;
 }
 
-int lbe_get_device_status(struct lbe_device* dev, struct lbe_status* status) {
-	uint8_t buf[REPORT_SIZE] = {0};
-	int res;
+static int hidraw_get_feature(void *ctx, uint8_t *buf, size_t len) {
+	struct hidraw_transport *t = ctx;
 
-	buf[0] = 0x4B; // Report Number
-	res = ioctl(dev->fd, HIDIOCGFEATURE(REPORT_SIZE), buf);
-	if (res < 0) {
-		perror("HIDIOCGFEATURE");
+	if (ioctl(t->fd, HIDIOCGFEATURE(len), buf) < 0) {
+		lbe_log_errno("HIDIOCGFEATURE");
 		return -1;
 	}
-
-	status->raw_status = buf[1];
-	if (dev->model == LBE_1420) {
-		status->frequency1 = buf[6] | (buf[7] << 8) | (buf[8] << 16) | (buf[9] << 24);
-		status->frequency2 = 0;
-	} else { // LBE_1421
-		status->frequency1 = buf[6] | (buf[7] << 8) | (buf[8] << 16) | (buf[9] << 24);
-		status->frequency2 = buf[14] | (buf[15] << 8) | (buf[16] << 16) | (buf[17] << 24);
-	}
-	status->outputs_enabled = (status->raw_status & 0x7F) == 0x7F;
-	status->fll_enabled = buf[18] != 0;
-	status->pll_locked = (status->raw_status & LBE_PLL_LOCK_BIT) != 0;
-
-	// Additional status information for LBE-1421
-	if (dev->model == LBE_1421_DUALOUT) {
-		status->antenna_ok = (status->raw_status & LBE_ANT_OK_BIT) != 0;
-		status->pps_enabled = (status->raw_status & LBE_PPS_EN_BIT) != 0;
-		status->out1_power_low = buf[19] != 0;
-		status->out2_power_low = buf[20] != 0;
-	} else {
-		status->pll_locked = 0;
-		status->antenna_ok = (status->raw_status & LBE_ANT_OK_BIT) != 0;
-		status->pps_enabled = 0;
-		status->out1_power_low = buf[10] != 0;
-		status->out2_power_low = 0;
-		status->outputs_enabled = 1; // Seems to be always on even with legit soft
-	}
-
-	/*printf("Raw report dump:\n");
-	for (int i = 0; i < REPORT_SIZE; i++) {
-		printf("%02X ", buf[i]);
-		if ((i + 1) % 16 == 0) printf("\n");
-	}
-	printf("\n");*/
-
 	return 0;
 }
 
-int lbe_set_frequency(struct lbe_device* dev, int output, uint32_t frequency) {
-	uint8_t buf[REPORT_SIZE] = {0};
-	int res;
+static int hidraw_set_feature(void *ctx, const uint8_t *buf, size_t len) {
+	struct hidraw_transport *t = ctx;
 
-	if (dev->model == LBE_1420 && output != 1) {
-		fprintf(stderr, "LBE-1420 only supports output 1\n");
+	if (ioctl(t->fd, HIDIOCSFEATURE(len), buf) < 0) {
+		lbe_log_errno("HIDIOCSFEATURE");
 		return -1;
 	}
-
-	if (dev->model == LBE_1420) {
-		buf[0] = LBE_1420_SET_F1;
-		buf[1] = (frequency >>  0) & 0xff;
-		buf[2] = (frequency >>  8) & 0xff;
-		buf[3] = (frequency >> 16) & 0xff;
-		buf[4] = (frequency >> 24) & 0xff;
-	} else { // LBE_1421
-		if (output == 1) {
-			buf[0] = LBE_1421_SET_F1;
-		} else if (output == 2) {
-			buf[0] = LBE_1421_SET_F2;
-		} else {
-			fprintf(stderr, "Invalid output selection\n");
-			return -1;
-		}
-		buf[5] = (frequency >>  0) & 0xff;
-		buf[6] = (frequency >>  8) & 0xff;
-		buf[7] = (frequency >> 16) & 0xff;
-		buf[8] = (frequency >> 24) & 0xff;
-	}
-
-	res = ioctl(dev->fd, HIDIOCSFEATURE(REPORT_SIZE), buf);
-	if (res < 0) {
-		perror("HIDIOCSFEATURE");
-		return -1;
-	}
-
 	return 0;
 }
 
-int lbe_set_frequency_temp(struct lbe_device* dev, int output, uint32_t frequency) {
-	uint8_t buf[REPORT_SIZE] = {0};
-	int res;
-
-	if (dev->model == LBE_1420 && output != 1) {
-		fprintf(stderr, "LBE-1420 only supports output 1\n");
+/* flock() on the hidraw node itself: every opener of the unit sees the same
+ * lock without a lock file, and it is dropped when the process dies */
+static int hidraw_lock(void *ctx, enum lbe_lock_mode mode, int timeout_ms, uint64_t *waited_ns) {
+	struct hidraw_transport *t = ctx;
+	int op = mode == LBE_LOCK_EXCLUSIVE ? LOCK_EX : mode == LBE_LOCK_SHARED ? LOCK_SH : LOCK_UN;
+	struct timespec pause = { 0, 100000L };
+	uint64_t start;
+
+	*waited_ns = 0;
+	if (flock(t->fd, op | LOCK_NB) == 0) return 0;
+	if (errno != EWOULDBLOCK) {
+		lbe_log_errno("flock");
 		return -1;
 	}
 
-	if (dev->model == LBE_1420) {
-		buf[0] = LBE_1420_SET_F1_TEMP;
-		buf[1] = (frequency >>  0) & 0xff;
-		buf[2] = (frequency >>  8) & 0xff;
-		buf[3] = (frequency >> 16) & 0xff;
-		buf[4] = (frequency >> 24) & 0xff;
-	} else { // LBE_1421
-		if (output == 1) {
-			buf[0] = LBE_1421_SET_F1_TEMP;
-		} else if (output == 2) {
-			buf[0] = LBE_1421_SET_F2_TEMP;
-		} else {
-			fprintf(stderr, "Invalid output selection\n");
+	start = lbe_now_ns();
+	if (timeout_ms < 0) {
+		// Interrupted by a signal means the caller wants to stop
+		int res = flock(t->fd, op);
+
+		*waited_ns = lbe_now_ns() - start;
+		if (res < 0) {
+			if (errno != EINTR) lbe_log_errno("flock");
 			return -1;
 		}
-		buf[5] = (frequency >>  0) & 0xff;
-		buf[6] = (frequency >>  8) & 0xff;
-		buf[7] = (frequency >> 16) & 0xff;
-		buf[8] = (frequency >> 24) & 0xff;
+		return 1;
 	}
+	for (;;) {
+		uint64_t now = lbe_now_ns();
 
-	res = ioctl(dev->fd, HIDIOCSFEATURE(REPORT_SIZE), buf);
-	if (res < 0) {
-		perror("HIDIOCSFEATURE");
-		return -1;
+		if (now - start >= (uint64_t)timeout_ms * 1000000ULL) {
+			*waited_ns = now - start;
+			errno = ETIMEDOUT;
+			return -1;
+		}
+		nanosleep(&pause, NULL);
+		if (flock(t->fd, op | LOCK_NB) == 0) break;
+		if (errno != EWOULDBLOCK) {
+			lbe_log_errno("flock");
+			return -1;
+		}
+		if (pause.tv_nsec < LOCK_POLL_MAX_NS) pause.tv_nsec *= 2;
 	}
-
-	return 0;
+	*waited_ns = lbe_now_ns() - start;
+	return 1;
 }
 
-int lbe_set_outputs_enable(struct lbe_device* dev, int enable) {
-	uint8_t buf[REPORT_SIZE] = {0};
-	int res;
-
-	buf[0] = LBE_142X_EN_OUT;
-	buf[1] = enable ? (dev->model == LBE_1421_DUALOUT ? 0x03 : 0x01) : 0x00;
+static void hidraw_close(void *ctx) {
+	struct hidraw_transport *t = ctx;
 
-	res = ioctl(dev->fd, HIDIOCSFEATURE(REPORT_SIZE), buf);
-	if (res < 0) {
-		perror("HIDIOCSFEATURE");
-		return -1;
-	}
-
-	return 0;
+	close(t->fd);
+	free(t);
 }
 
-int lbe_blink_leds(struct lbe_device* dev) {
-	uint8_t buf[REPORT_SIZE] = {0};
-	int res;
+static const struct lbe_transport_ops hidraw_ops = {
+	.name = "hidraw",
+	.get_feature = hidraw_get_feature,
+	.set_feature = hidraw_set_feature,
+	.close = hidraw_close,
+	.lock = hidraw_lock,
+};
 
-	buf[0] = LBE_142X_BLINK_OUT;
+/* Open and check a hidraw node. With expect set the node must still carry
+ * that exact bus/VID/PID, and failures are silent (stale cache entry). */
+static struct lbe_device* open_hidraw(const char *path, const struct hidraw_devinfo *expect) {
+	struct hidraw_transport *t = malloc(sizeof(struct hidraw_transport));
+	enum lbe_model model;
 
-	res = ioctl(dev->fd, HIDIOCSFEATURE(REPORT_SIZE), buf);
-	if (res < 0) {
-		perror("HIDIOCSFEATURE");
-		return -1;
-	}
+	if (!t) return NULL;
 
-	return 0;
+	t->fd = open(path, O_RDWR | O_CLOEXEC);
+	if (t->fd < 0) {
+		if (!expect) lbe_log_errno("Failed to open device");
+		free(t);
+		return NULL;
+	}
+	if (ioctl(t->fd, HIDIOCGRAWINFO, &t->raw_info) < 0) {
+		if (!expect) lbe_log_errno("HIDIOCGRAWINFO");
+		close(t->fd);
+		free(t);
+		return NULL;
+	}
+	if (!is_lbe_id((uint16_t)t->raw_info.vendor, (uint16_t)t->raw_info.product) ||
+	    (expect && (t->raw_info.bustype != expect->bustype || t->raw_info.vendor != expect->vendor ||
+	                t->raw_info.product != expect->product))) {
+		if (!expect) lbe_log(LBE_LOG_ERROR, "%s is not an LBE-142x device", path);
+		close(t->fd);
+		free(t);
+		return NULL;
+	}
+	model = (t->raw_info.product == PID_LBE_1420) ? LBE_1420 : LBE_1421_DUALOUT;
+	return lbe_open_transport(&hidraw_ops, t, model, path);
 }
 
-int lbe_set_pll_mode(struct lbe_device* dev, int fll_mode) {
-	uint8_t buf[REPORT_SIZE] = {0};
-	int res;
-
-	buf[0] = LBE_142X_SET_PLL;
-	buf[1] = fll_mode ? 0x01 : 0x00;
+#ifdef LBE_WITH_LIBUSB
+#define MAX_UNITS 64
 
-	res = ioctl(dev->fd, HIDIOCSFEATURE(REPORT_SIZE), buf);
-	if (res < 0) {
-		perror("HIDIOCSFEATURE");
-		return -1;
-	}
+/* LBE142X_TRANSPORT=libusb opens units through usbfs instead of hidraw, with
+ * LBE142X_USB_TIMEOUT_MS bounding every transfer */
+static int use_libusb(void) {
+	const char *transport = getenv("LBE142X_TRANSPORT");
 
-	return 0;
+	return transport && strcmp(transport, "libusb") == 0;
 }
 
-int lbe_set_1pps(struct lbe_device* dev, int enable) {
-	uint8_t buf[REPORT_SIZE] = {0};
-	int res;
-
-	if (dev->model != LBE_1421_DUALOUT) {
-		fprintf(stderr, "1PPS control is only supported on LBE-1421\n");
-		return -1;
+/* path is a hidraw node, mapped to its USB port, or a bus-port path */
+static struct lbe_device* open_libusb(const char *path) {
+	struct lbe_device_info list[MAX_UNITS];
+	const char *timeout = getenv("LBE142X_USB_TIMEOUT_MS");
+	struct lbe_device *dev;
+	int count;
+
+	if (path && path[0] == '/') {
+		count = lbe_enumerate_devices(list, MAX_UNITS);
+		for (int i = 0; i < count; i++) {
+			if (strcmp(list[i].path, path) == 0) {
+				path = list[i].usb_path;
+				break;
+			}
+		}
+		if (path[0] == '/') {
+			lbe_log(LBE_LOG_ERROR, "%s is not an LBE-142x device", path);
+			return NULL;
+		}
 	}
+	dev = lbe_libusb_open(path);
+	if (dev && timeout && *timeout) {
+		lbe_libusb_set_timeout(dev, (unsigned int)strtoul(timeout, NULL, 10));
+	}
+	return dev;
+}
+#endif
 
-	buf[0] = LBE_1421_SET_PPS;
-	buf[1] = enable ? 0x01 : 0x00;
+/* NULL opens the first unit, as on Windows */
+struct lbe_device* lbe_open_device_path(const char *path) {
+	struct lbe_device* dev;
 
-	res = ioctl(dev->fd, HIDIOCSFEATURE(REPORT_SIZE), buf);
-	if (res < 0) {
-		perror("HIDIOCSFEATURE");
-		return -1;
+	if (!path) {
+		return lbe_open_device();
 	}
+	LBE_PROBE1(open_start, path);
+#ifdef LBE_WITH_LIBUSB
+	if (use_libusb()) {
+		dev = open_libusb(path);
+	} else
+#endif
+	dev = open_hidraw(path, NULL);
+	LBE_PROBE2(open_done, path, dev);
+	return dev;
+}
 
-	return 0;
+/* Setting LBE142X_NO_CACHE disables the cache, e.g. to compare --timing */
+static int cache_file(char *buf, size_t len) {
+	const char *dir = getenv("XDG_RUNTIME_DIR");
+	int n;
+
+	if (!dir || !*dir || getenv("LBE142X_NO_CACHE")) return -1;
+	n = snprintf(buf, len, "%s/%s", dir, DEVICE_CACHE_NAME);
+	return (n < 0 || (size_t)n >= len) ? -1 : 0;
 }
 
-int lbe_set_power_level(struct lbe_device* dev, int output, int low_power) {
-	uint8_t buf[REPORT_SIZE] = {0};
-	int res;
-	int cmdpwrlevel = LBE_1421_SET_PWR1;
+static struct lbe_device* open_cached(void) {
+	char file[PATH_MAX];
+	char path[LBE_PATH_MAX];
+	struct hidraw_devinfo expect;
+	unsigned int bus, vendor, product;
+	FILE *f;
+	int n;
+
+	if (cache_file(file, sizeof(file)) < 0) return NULL;
+	f = fopen(file, "r");
+	if (!f) return NULL;
+	n = fscanf(f, "%63s %x %x %x", path, &bus, &vendor, &product);
+	fclose(f);
+	if (n != 4) return NULL;
+
+	expect.bustype = bus;
+	expect.vendor = (short)vendor;
+	expect.product = (short)product;
+	return open_hidraw(path, &expect);
+}
 
-	if (dev->model == LBE_1420 && output != 1) {
-		fprintf(stderr, "LBE-1420 only supports output 1\n");
-		return -1;
+/* Best effort, written through a rename so readers never see half a line */
+static void store_cached(struct lbe_device* dev) {
+	const struct hidraw_transport *t = lbe_get_transport_ctx(dev);
+	char file[PATH_MAX];
+	char tmp[PATH_MAX + 8];
+	FILE *f;
+
+	if (cache_file(file, sizeof(file)) < 0) return;
+	snprintf(tmp, sizeof(tmp), "%s.%d", file, (int)getpid());
+	f = fopen(tmp, "w");
+	if (!f) return;
+	fprintf(f, "%s %04x %04x %04x\n", lbe_get_path(dev), t->raw_info.bustype,
+		(uint16_t)t->raw_info.vendor, (uint16_t)t->raw_info.product);
+	if (fclose(f) != 0 || rename(tmp, file) != 0) {
+		unlink(tmp);
 	}
+}
 
-	if (dev->model == LBE_1420) {
-		cmdpwrlevel = LBE_1420_SET_PWR1;
-	}
+/* Tries the node used last time first: one open plus one HIDIOCGRAWINFO
+ * instead of a udev enumeration. Falls back to the first unit found. */
+static struct lbe_device* open_default(void) {
+	struct lbe_device_info info;
+	struct lbe_device* dev;
+	int count;
 
-	buf[0] = (output == 1) ? cmdpwrlevel : LBE_1421_SET_PWR2;
-	buf[1] = low_power ? 0x01 : 0x00;
+#ifdef LBE_WITH_LIBUSB
+	if (use_libusb()) return open_libusb(NULL);
+#endif
+	dev = open_cached();
+	if (dev) return dev;
 
-	res = ioctl(dev->fd, HIDIOCSFEATURE(REPORT_SIZE), buf);
-	if (res < 0) {
-		perror("HIDIOCSFEATURE");
-		return -1;
+	count = lbe_enumerate_devices(&info, 1);
+	if (count < 0) {
+		return NULL;
+	}
+	if (count == 0) {
+		lbe_log(LBE_LOG_ERROR, "LBE-142x device not found");
+		return NULL;
 	}
+	dev = open_hidraw(info.path, NULL);
+	if (dev) store_cached(dev);
+	return dev;
+}
 
-	return 0;
+struct lbe_device* lbe_open_device(void) {
+	struct lbe_device* dev;
+
+	LBE_PROBE1(open_start, "");
+	dev = open_default();
+	LBE_PROBE2(open_done, "", dev);
+	return dev;
 }
 
-#endif // __linux__
\ No newline at end of file
+#endif // __linux__
@@ -0,0 +1,101 @@
+#include "lbe_events.h"
+#include "lbe_common.h"
+#include <string.h>
+
+struct event_field {
+	uint32_t (*get)(const struct lbe_status *status);
+	enum lbe_event_type on_clear; // value went to 0, or any change for non-flag fields
+	enum lbe_event_type on_set;   // value went to 1
+	int output;
+};
+
+static uint32_t get_gps(const struct lbe_status *s) { return (s->raw_status & LBE_GPS_LOCK_BIT) != 0; }
+static uint32_t get_pll(const struct lbe_status *s) { return (s->raw_status & LBE_PLL_LOCK_BIT) != 0; }
+static uint32_t get_antenna(const struct lbe_status *s) { return s->antenna_ok != 0; }
+static uint32_t get_outputs(const struct lbe_status *s) { return s->outputs_enabled != 0; }
+static uint32_t get_pps(const struct lbe_status *s) { return s->pps_enabled != 0; }
+static uint32_t get_fll(const struct lbe_status *s) { return s->fll_enabled != 0; }
+static uint32_t get_pwr1(const struct lbe_status *s) { return s->out1_power_low != 0; }
+static uint32_t get_pwr2(const struct lbe_status *s) { return s->out2_power_low != 0; }
+static uint32_t get_freq1(const struct lbe_status *s) { return s->frequency1; }
+static uint32_t get_freq2(const struct lbe_status *s) { return s->frequency2; }
+
+static const struct event_field fields[LBE_EVENT_FIELDS] = {
+	{ get_gps,     LBE_EVENT_GPS_LOCK_LOST,     LBE_EVENT_GPS_LOCK_ACQUIRED, 0 },
+	{ get_pll,     LBE_EVENT_PLL_LOCK_LOST,     LBE_EVENT_PLL_LOCK_ACQUIRED, 0 },
+	{ get_antenna, LBE_EVENT_ANTENNA_SHORT,     LBE_EVENT_ANTENNA_OK,        0 },
+	{ get_outputs, LBE_EVENT_OUTPUTS_DISABLED,  LBE_EVENT_OUTPUTS_ENABLED,   0 },
+	{ get_pps,     LBE_EVENT_PPS_DISABLED,      LBE_EVENT_PPS_ENABLED,       0 },
+	{ get_fll,     LBE_EVENT_MODE_CHANGED,      LBE_EVENT_MODE_CHANGED,      0 },
+	{ get_pwr1,    LBE_EVENT_POWER_CHANGED,     LBE_EVENT_POWER_CHANGED,     1 },
+	{ get_pwr2,    LBE_EVENT_POWER_CHANGED,     LBE_EVENT_POWER_CHANGED,     2 },
+	{ get_freq1,   LBE_EVENT_FREQUENCY_CHANGED, LBE_EVENT_FREQUENCY_CHANGED, 1 },
+	{ get_freq2,   LBE_EVENT_FREQUENCY_CHANGED, LBE_EVENT_FREQUENCY_CHANGED, 2 },
+};
+
+static const char *const event_names[LBE_EVENT_COUNT] = {
+	"gps_lock_lost",
+	"gps_lock_acquired",
+	"pll_lock_lost",
+	"pll_lock_acquired",
+	"antenna_short",
+	"antenna_ok",
+	"outputs_disabled",
+	"outputs_enabled",
+	"pps_disabled",
+	"pps_enabled",
+	"mode_changed",
+	"power_changed",
+	"frequency_changed",
+};
+
+void lbe_events_init(struct lbe_event_tracker *tracker, uint32_t mask) {
+	memset(tracker, 0, sizeof(*tracker));
+	tracker->mask = mask;
+}
+
+/* Returns the number of events delivered to cb. The first sample only sets
+ * the baseline. */
+int lbe_events_update(struct lbe_event_tracker *tracker, const struct lbe_status *status,
+		uint64_t timestamp_ns, lbe_event_cb cb, void *arg) {
+	int emitted = 0;
+
+	if (!tracker->have_prev) {
+		tracker->prev = *status;
+		tracker->have_prev = 1;
+		for (int i = 0; i < LBE_EVENT_FIELDS; i++) {
+			tracker->since_ns[i] = timestamp_ns;
+		}
+		return 0;
+	}
+
+	for (int i = 0; i < LBE_EVENT_FIELDS; i++) {
+		const struct event_field *f = &fields[i];
+		uint32_t old_value = f->get(&tracker->prev);
+		uint32_t new_value = f->get(status);
+		struct lbe_event event;
+
+		if (old_value == new_value) continue;
+
+		event.type = new_value == 1 ? f->on_set : f->on_clear;
+		event.timestamp_ns = timestamp_ns;
+		event.prior_duration_ns = timestamp_ns - tracker->since_ns[i];
+		event.output = f->output;
+		event.old_value = old_value;
+		event.new_value = new_value;
+		tracker->since_ns[i] = timestamp_ns;
+
+		if (cb && (tracker->mask & LBE_EVENT_MASK(event.type))) {
+			cb(&event, arg);
+			emitted++;
+		}
+	}
+
+	tracker->prev = *status;
+	return emitted;
+}
+
+const char* lbe_event_name(enum lbe_event_type type) {
+	if ((unsigned)type >= LBE_EVENT_COUNT) return "unknown";
+	return event_names[type];
+}
@@ -0,0 +1,166 @@
+#ifdef __linux__
+
+#include "lbe_failover.h"
+#include "lbe_clock.h"
+#include "lbe_common.h"
+#include "lbe_internal.h"
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+struct unit_state {
+	int healthy;
+	int read_failed;
+	uint8_t raw_status;
+	uint32_t bad_streak;
+	uint32_t good_streak;
+	uint64_t streak_start_ns; // first poll of the current good or bad streak
+};
+
+static void sleep_until(uint64_t deadline_ns) {
+	struct timespec ts;
+
+	ts.tv_sec = (time_t)(deadline_ns / 1000000000ULL);
+	ts.tv_nsec = (long)(deadline_ns % 1000000000ULL);
+	clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+static void poll_unit(struct lbe_device* dev, struct unit_state *u, struct lbe_failover_stats *stats) {
+	struct lbe_status status;
+	uint64_t t = lbe_now_ns();
+	int healthy;
+
+	stats->polls++;
+	if (lbe_get_device_status(dev, &status) < 0) {
+		stats->read_errors++;
+		u->read_failed = 1;
+		healthy = 0;
+	} else {
+		u->read_failed = 0;
+		u->raw_status = status.raw_status;
+		// Raw bits: the decoded pll_locked is always 0 on the LBE-1420
+		healthy = (status.raw_status & LBE_GPS_LOCK_BIT) && (status.raw_status & LBE_PLL_LOCK_BIT);
+	}
+
+	if (healthy != u->healthy) {
+		u->streak_start_ns = t;
+		u->bad_streak = 0;
+		u->good_streak = 0;
+	}
+	u->healthy = healthy;
+	if (healthy) {
+		u->good_streak++;
+	} else {
+		u->bad_streak++;
+	}
+}
+
+static int set_outputs(struct lbe_device* dev, int enable, const struct lbe_failover_opts *opts) {
+	int res;
+
+	if (opts->lock && lbe_lock_device(dev, LBE_LOCK_EXCLUSIVE, opts->lock_wait_ms) < 0) {
+		lbe_log(LBE_LOG_ERROR, "%s is locked by another process", lbe_get_path(dev));
+		return -1;
+	}
+	res = lbe_set_outputs_enable(dev, enable);
+	if (opts->lock) lbe_unlock_device(dev);
+	return res;
+}
+
+/* Make before break: the new unit is enabled before the old one goes quiet,
+ * so there is never a window without a reference on the outputs */
+static int drive_outputs(struct lbe_device* units[2], int active, const struct lbe_failover_opts *opts) {
+	int errors = 0;
+
+	if (set_outputs(units[active], 1, opts) < 0) errors++;
+	if (set_outputs(units[!active], 0, opts) < 0) errors++;
+	return errors;
+}
+
+int lbe_failover_run(struct lbe_device* units[2], const struct lbe_failover_opts *opts,
+		lbe_failover_cb cb, void *arg, struct lbe_failover_stats *stats) {
+	struct unit_state state[2];
+	uint64_t period_ns = (uint64_t)(1e9 / opts->rate_hz);
+	uint64_t start_ns, deadline;
+	uint32_t fail_samples = opts->fail_samples ? opts->fail_samples : 1;
+	int active;
+
+	memset(stats, 0, sizeof(*stats));
+	memset(state, 0, sizeof(state));
+	state[0].healthy = state[1].healthy = -1; // first poll always starts a streak
+	lbe_histogram_init(&stats->detect_to_switch);
+	lbe_histogram_init(&stats->decide_to_switch);
+
+	// Units healthy at startup are trusted immediately
+	for (int i = 0; i < 2; i++) {
+		poll_unit(units[i], &state[i], stats);
+		if (state[i].healthy && state[i].good_streak < opts->recover_samples) {
+			state[i].good_streak = opts->recover_samples;
+		}
+	}
+	active = (!state[LBE_FAILOVER_PRIMARY].healthy && state[LBE_FAILOVER_STANDBY].healthy) ?
+		LBE_FAILOVER_STANDBY : LBE_FAILOVER_PRIMARY;
+	if (drive_outputs(units, active, opts) > 0) {
+		lbe_log(LBE_LOG_ERROR, "Failed to set initial outputs");
+		return -1;
+	}
+	if (cb) {
+		struct lbe_failover_switch sw;
+
+		memset(&sw, 0, sizeof(sw));
+		sw.from = sw.to = active;
+		sw.raw_status = state[active].raw_status;
+		sw.detect_ns = sw.decide_ns = sw.switched_ns = lbe_now_ns();
+		cb(&sw, arg);
+	}
+
+	start_ns = lbe_now_ns();
+	deadline = start_ns + period_ns;
+	while (!(opts->stop && *opts->stop)) {
+		int other;
+		int failing, reverting;
+
+		sleep_until(deadline);
+		if (opts->stop && *opts->stop) break;
+		if (lbe_now_ns() > deadline + period_ns) {
+			stats->deadline_misses++;
+		}
+		deadline += period_ns;
+
+		poll_unit(units[0], &state[0], stats);
+		poll_unit(units[1], &state[1], stats);
+
+		other = !active;
+		failing = !state[active].healthy && state[active].bad_streak >= fail_samples;
+		reverting = opts->revert && active == LBE_FAILOVER_STANDBY && state[active].healthy;
+		if ((failing || reverting) && state[other].healthy &&
+		    state[other].good_streak >= opts->recover_samples) {
+			struct lbe_failover_switch sw;
+
+			memset(&sw, 0, sizeof(sw));
+			sw.from = active;
+			sw.to = other;
+			sw.reverted = !failing;
+			sw.read_failed = state[active].read_failed;
+			sw.raw_status = state[active].raw_status;
+			sw.detect_ns = failing ? state[active].streak_start_ns : state[other].streak_start_ns;
+			sw.decide_ns = lbe_now_ns();
+			sw.errors = drive_outputs(units, other, opts);
+			sw.switched_ns = lbe_now_ns();
+
+			active = other;
+			stats->switches++;
+			stats->switch_errors += (uint64_t)sw.errors;
+			if (failing) {
+				lbe_histogram_add(&stats->detect_to_switch, sw.switched_ns - sw.detect_ns);
+			}
+			lbe_histogram_add(&stats->decide_to_switch, sw.switched_ns - sw.decide_ns);
+			if (cb) cb(&sw, arg);
+		}
+	}
+
+	stats->elapsed_s = (lbe_now_ns() - start_ns) / 1e9;
+	return 0;
+}
+
+#endif // __linux__
@@ -0,0 +1,320 @@
+#ifdef __linux__
+
+#include "lbe_fleet.h"
+#include "lbe_async.h"
+#include "lbe_internal.h"
+#include <pthread.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+struct fleet_pool {
+	const struct lbe_device_info *devices;
+	int count;
+	int next;
+	pthread_mutex_t lock;
+	lbe_fleet_job job;
+	void *arg;
+	struct lbe_fleet_result *results;
+};
+
+static double elapsed_ms(const struct timespec *start) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) * 1e3 + (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static int match_term(const char *term, const struct lbe_device_info *info) {
+	const char *node = strrchr(info->path, '/');
+
+	node = node ? node + 1 : info->path;
+	if (strcmp(term, "all") == 0) return 1;
+	if (strncmp(term, "serial:", 7) == 0) return info->serial[0] && strcmp(term + 7, info->serial) == 0;
+	if (strncmp(term, "path:", 5) == 0) return strcmp(term + 5, info->path) == 0;
+	if (strncmp(term, "usb:", 4) == 0) return strcmp(term + 4, info->usb_path) == 0;
+	return strcmp(term, info->path) == 0 || strcmp(term, node) == 0 ||
+	       strcmp(term, info->usb_path) == 0 || (info->serial[0] && strcmp(term, info->serial) == 0);
+}
+
+/* Returns the number of selected units, or -1 if a term matched nothing.
+ * Each unit is selected once even when several terms match it. */
+int lbe_select_devices(const char *selector, const struct lbe_device_info *all, int count,
+		struct lbe_device_info *out, int max) {
+	char buf[256];
+	char *term, *save = NULL;
+	int selected[LBE_FLEET_MAX_DEVICES] = {0};
+	int n = 0;
+
+	if (strlen(selector) >= sizeof(buf)) return -1;
+	strcpy(buf, selector);
+	if (count > LBE_FLEET_MAX_DEVICES) count = LBE_FLEET_MAX_DEVICES;
+
+	for (term = strtok_r(buf, ",", &save); term; term = strtok_r(NULL, ",", &save)) {
+		int found = 0;
+
+		for (int i = 0; i < count; i++) {
+			if (!match_term(term, &all[i])) continue;
+			found = 1;
+			selected[i] = 1;
+		}
+		if (!found) {
+			lbe_log(LBE_LOG_ERROR, "No LBE-142x device matches '%s'", term);
+			return -1;
+		}
+	}
+
+	for (int i = 0; i < count && n < max; i++) {
+		if (selected[i]) out[n++] = all[i];
+	}
+	return n;
+}
+
+static void* fleet_worker(void *p) {
+	struct fleet_pool *pool = p;
+
+	for (;;) {
+		struct lbe_fleet_result *result;
+		struct lbe_device *dev;
+		struct timespec start;
+		int idx;
+
+		pthread_mutex_lock(&pool->lock);
+		idx = pool->next++;
+		pthread_mutex_unlock(&pool->lock);
+		if (idx >= pool->count) break;
+
+		result = &pool->results[idx];
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		dev = lbe_open_device_path(pool->devices[idx].path);
+		if (!dev) {
+			result->result = -1;
+		} else {
+			result->result = pool->job(dev, pool->arg, result) < 0 ? -1 : 0;
+			lbe_close_device(dev);
+		}
+		result->elapsed_ms = elapsed_ms(&start);
+	}
+	return NULL;
+}
+
+/* Run job once per device. workers <= 0 uses one thread per device.
+ * Returns the number of devices whose job failed. */
+int lbe_fleet_run(const struct lbe_device_info *devices, int count, int workers,
+		lbe_fleet_job job, void *arg, struct lbe_fleet_result *results) {
+	pthread_t threads[LBE_FLEET_MAX_DEVICES];
+	struct fleet_pool pool;
+	int started = 0;
+	int failed = 0;
+
+	if (count > LBE_FLEET_MAX_DEVICES) count = LBE_FLEET_MAX_DEVICES;
+	if (workers <= 0 || workers > count) workers = count;
+
+	memset(results, 0, (size_t)count * sizeof(*results));
+	for (int i = 0; i < count; i++) {
+		results[i].info = devices[i];
+	}
+
+	pool.devices = devices;
+	pool.count = count;
+	pool.next = 0;
+	pool.job = job;
+	pool.arg = arg;
+	pool.results = results;
+	pthread_mutex_init(&pool.lock, NULL);
+
+	for (int i = 0; i < workers; i++) {
+		if (pthread_create(&threads[i], NULL, fleet_worker, &pool) != 0) {
+			lbe_log_errno("pthread_create");
+			break;
+		}
+		started++;
+	}
+	// With no thread at all the caller still gets its work done, serially
+	if (started == 0) {
+		fleet_worker(&pool);
+	}
+	for (int i = 0; i < started; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	pthread_mutex_destroy(&pool.lock);
+
+	for (int i = 0; i < count; i++) {
+		if (results[i].result < 0) failed++;
+	}
+	return failed;
+}
+
+/* Building block for jobs: run cmds on dev and account for them in result */
+int lbe_fleet_exec_commands(struct lbe_device* dev, const struct lbe_cmd *cmds, int ncmds,
+		struct lbe_fleet_result *result) {
+	for (int i = 0; i < ncmds; i++) {
+		struct lbe_status status;
+
+		if (lbe_cmd_execute(dev, &cmds[i], &status) < 0) {
+			result->commands_failed++;
+			continue;
+		}
+		result->commands_ok++;
+		if (cmds[i].op == LBE_CMD_STATUS) {
+			result->status = status;
+			result->have_status = 1;
+		}
+	}
+	return result->commands_failed ? -1 : 0;
+}
+
+struct command_result {
+	struct lbe_fleet_result *result;
+	struct timespec start;
+};
+
+// Opens (and locks) the units of lbe_fleet_run_commands() in parallel
+struct open_pool {
+	const struct lbe_device_info *devices;
+	int count;
+	int next;
+	pthread_mutex_t lock;
+	enum lbe_lock_mode lock_mode;
+	int lock_wait_ms;
+	struct lbe_device **devs;
+};
+
+static void* open_worker(void *p) {
+	struct open_pool *pool = p;
+
+	for (;;) {
+		const char *path;
+		struct lbe_device *dev;
+		int idx;
+
+		pthread_mutex_lock(&pool->lock);
+		idx = pool->next++;
+		pthread_mutex_unlock(&pool->lock);
+		if (idx >= pool->count) break;
+
+		path = pool->devices[idx].path;
+		dev = lbe_open_device_path(path);
+		if (dev && pool->lock_mode != LBE_LOCK_UNLOCKED &&
+		    lbe_lock_device(dev, pool->lock_mode, pool->lock_wait_ms) < 0) {
+			lbe_log(LBE_LOG_ERROR, "%s is locked by another process", path);
+			lbe_close_device(dev);
+			dev = NULL;
+		}
+		pool->devs[idx] = dev;
+	}
+	return NULL;
+}
+
+/* One thread per unit, like lbe_fleet_run(): enumeration and a lock wait on
+ * one unit do not hold up the others. devs[i] is NULL for a failed unit. */
+static void open_devices(const struct lbe_device_info *devices, int count,
+		enum lbe_lock_mode lock_mode, int lock_wait_ms, struct lbe_device **devs) {
+	pthread_t threads[LBE_FLEET_MAX_DEVICES];
+	struct open_pool pool;
+	int started = 0;
+
+	pool.devices = devices;
+	pool.count = count;
+	pool.next = 0;
+	pool.lock_mode = lock_mode;
+	pool.lock_wait_ms = lock_wait_ms;
+	pool.devs = devs;
+	pthread_mutex_init(&pool.lock, NULL);
+
+	for (int i = 0; i < count; i++) {
+		if (pthread_create(&threads[i], NULL, open_worker, &pool) != 0) {
+			lbe_log_errno("pthread_create");
+			break;
+		}
+		started++;
+	}
+	if (started == 0) {
+		open_worker(&pool);
+	}
+	for (int i = 0; i < started; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	pthread_mutex_destroy(&pool.lock);
+}
+
+static void on_command_done(struct lbe_device* dev, const struct lbe_cmd *cmd, int res,
+		const struct lbe_status *status, void *arg) {
+	struct command_result *cr = arg;
+	struct lbe_fleet_result *result = cr->result;
+
+	(void)dev;
+	if (res < 0) {
+		result->commands_failed++;
+		result->result = -1;
+	} else {
+		result->commands_ok++;
+		if (cmd->op == LBE_CMD_STATUS) {
+			result->status = *status;
+			result->have_status = 1;
+		}
+	}
+	result->elapsed_ms = elapsed_ms(&cr->start);
+}
+
+/* Same as lbe_fleet_run() with a fixed command list, but driven from this
+ * thread through the async engine: workers only bounds how many reports are
+ * in flight at once, not the number of devices. The units are opened in
+ * parallel first, and each one is held with lock_mode (unless
+ * LBE_LOCK_UNLOCKED) from before its first command until it is closed. */
+int lbe_fleet_run_commands(const struct lbe_device_info *devices, int count, int workers,
+		const struct lbe_cmd *cmds, int ncmds, enum lbe_lock_mode lock_mode, int lock_wait_ms,
+		struct lbe_fleet_result *results) {
+	struct lbe_device *devs[LBE_FLEET_MAX_DEVICES] = {0};
+	struct command_result ctx[LBE_FLEET_MAX_DEVICES];
+	struct lbe_async *as;
+	int failed = 0;
+
+	if (count > LBE_FLEET_MAX_DEVICES) count = LBE_FLEET_MAX_DEVICES;
+	if (workers <= 0 || workers > count) workers = count;
+
+	memset(results, 0, (size_t)count * sizeof(*results));
+	for (int i = 0; i < count; i++) {
+		results[i].info = devices[i];
+		ctx[i].result = &results[i];
+		clock_gettime(CLOCK_MONOTONIC, &ctx[i].start);
+	}
+
+	as = lbe_async_new(workers);
+	if (!as) {
+		for (int i = 0; i < count; i++) {
+			results[i].result = -1;
+			results[i].elapsed_ms = elapsed_ms(&ctx[i].start);
+		}
+		return count;
+	}
+
+	open_devices(devices, count, lock_mode, lock_wait_ms, devs);
+	for (int i = 0; i < count; i++) {
+		if (!devs[i]) {
+			results[i].result = -1;
+			results[i].elapsed_ms = elapsed_ms(&ctx[i].start);
+			continue;
+		}
+		for (int c = 0; c < ncmds; c++) {
+			if (lbe_async_submit(as, devs[i], &cmds[c], on_command_done, &ctx[i]) < 0) {
+				results[i].commands_failed++;
+				results[i].result = -1;
+			}
+		}
+	}
+
+	while (lbe_async_pending(as) > 0) {
+		if (lbe_async_wait(as, -1) < 0) break;
+	}
+	lbe_async_free(as);
+
+	for (int i = 0; i < count; i++) {
+		lbe_close_device(devs[i]);
+		if (results[i].result < 0) failed++;
+	}
+	return failed;
+}
+
+#endif // __linux__
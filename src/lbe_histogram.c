@@ -0,0 +1,89 @@
+#include "lbe_histogram.h"
+#include <string.h>
+
+static int msb_index(uint64_t v) {
+	int n = 0;
+
+	while (v >>= 1) n++;
+	return n;
+}
+
+static int bucket_index(uint64_t value) {
+	int msb, group;
+
+	if (value < LBE_HIST_SUB_COUNT) return (int)value;
+	msb = msb_index(value);
+	if (msb >= LBE_HIST_MAX_BITS) return LBE_HIST_BUCKETS - 1;
+	group = msb - LBE_HIST_SUB_BITS + 1;
+	return group * LBE_HIST_SUB_COUNT + (int)((value >> (msb - LBE_HIST_SUB_BITS)) - LBE_HIST_SUB_COUNT);
+}
+
+/* Largest value that falls into bucket index */
+uint64_t lbe_histogram_bucket_upper(int index) {
+	int group = index / LBE_HIST_SUB_COUNT;
+	uint64_t sub = (uint64_t)(index % LBE_HIST_SUB_COUNT);
+
+	if (group == 0) return sub;
+	return ((LBE_HIST_SUB_COUNT + sub + 1) << (group - 1)) - 1;
+}
+
+void lbe_histogram_init(struct lbe_histogram *h) {
+	memset(h, 0, sizeof(*h));
+	h->min = UINT64_MAX;
+}
+
+void lbe_histogram_add(struct lbe_histogram *h, uint64_t value) {
+	h->buckets[bucket_index(value)]++;
+	h->count++;
+	h->sum += value;
+	if (value < h->min) h->min = value;
+	if (value > h->max) h->max = value;
+}
+
+void lbe_histogram_merge(struct lbe_histogram *dst, const struct lbe_histogram *src) {
+	for (int i = 0; i < LBE_HIST_BUCKETS; i++) {
+		dst->buckets[i] += src->buckets[i];
+	}
+	dst->count += src->count;
+	dst->sum += src->sum;
+	if (src->min < dst->min) dst->min = src->min;
+	if (src->max > dst->max) dst->max = src->max;
+}
+
+/* Upper bound of the bucket holding the given percentile, clamped to the
+ * observed min/max so p0 and p100 are exact. */
+uint64_t lbe_histogram_percentile(const struct lbe_histogram *h, double percentile) {
+	uint64_t rank, seen = 0;
+
+	if (h->count == 0) return 0;
+	if (percentile <= 0) return h->min;
+	if (percentile >= 100) return h->max;
+
+	rank = (uint64_t)(percentile / 100.0 * (double)h->count + 0.999999);
+	if (rank == 0) rank = 1;
+	for (int i = 0; i < LBE_HIST_BUCKETS; i++) {
+		seen += h->buckets[i];
+		if (seen >= rank) {
+			uint64_t v = lbe_histogram_bucket_upper(i);
+			if (v < h->min) return h->min;
+			return v > h->max ? h->max : v;
+		}
+	}
+	return h->max;
+}
+
+double lbe_histogram_mean(const struct lbe_histogram *h) {
+	return h->count ? (double)h->sum / (double)h->count : 0.0;
+}
+
+/* One line, values printed in microseconds */
+void lbe_histogram_print(FILE *out, const char *label, const struct lbe_histogram *h) {
+	fprintf(out, "%-14s %8llu  min %9.1f  p50 %9.1f  p90 %9.1f  p99 %9.1f  max %9.1f  mean %9.1f us\n",
+		label, (unsigned long long)h->count,
+		(h->count ? h->min : 0) / 1e3,
+		lbe_histogram_percentile(h, 50) / 1e3,
+		lbe_histogram_percentile(h, 90) / 1e3,
+		lbe_histogram_percentile(h, 99) / 1e3,
+		h->max / 1e3,
+		lbe_histogram_mean(h) / 1e3);
+}
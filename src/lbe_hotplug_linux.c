@@ -0,0 +1,115 @@
+#ifdef __linux__
+
+#include "lbe_hotplug.h"
+#include "lbe_internal.h"
+#include <libudev.h>
+#include <poll.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+struct lbe_hotplug {
+	struct udev *udev;
+	struct udev_monitor *monitor;
+	struct lbe_device_info devices[LBE_HOTPLUG_MAX_DEVICES];
+	int count;
+};
+
+static int find_device(struct lbe_hotplug* hp, const char *path) {
+	for (int i = 0; i < hp->count; i++) {
+		if (strcmp(hp->devices[i].path, path) == 0) return i;
+	}
+	return -1;
+}
+
+struct lbe_hotplug* lbe_hotplug_new(void) {
+	struct lbe_hotplug* hp = calloc(1, sizeof(struct lbe_hotplug));
+	if (!hp) return NULL;
+
+	hp->udev = udev_new();
+	if (!hp->udev) {
+		lbe_log(LBE_LOG_ERROR, "Failed to create udev context");
+		free(hp);
+		return NULL;
+	}
+
+	hp->monitor = udev_monitor_new_from_netlink(hp->udev, "udev");
+	if (!hp->monitor ||
+	    udev_monitor_filter_add_match_subsystem_devtype(hp->monitor, "hidraw", NULL) < 0 ||
+	    udev_monitor_enable_receiving(hp->monitor) < 0) {
+		lbe_log(LBE_LOG_ERROR, "Failed to set up udev monitor");
+		lbe_hotplug_free(hp);
+		return NULL;
+	}
+
+	// Start listening before seeding so nothing plugged in between is lost
+	hp->count = lbe_enumerate_devices(hp->devices, LBE_HOTPLUG_MAX_DEVICES);
+	if (hp->count < 0) {
+		lbe_hotplug_free(hp);
+		return NULL;
+	}
+	return hp;
+}
+
+void lbe_hotplug_free(struct lbe_hotplug* hp) {
+	if (hp) {
+		if (hp->monitor) udev_monitor_unref(hp->monitor);
+		udev_unref(hp->udev);
+		free(hp);
+	}
+}
+
+int lbe_hotplug_get_fd(struct lbe_hotplug* hp) {
+	return udev_monitor_get_fd(hp->monitor);
+}
+
+/* Drain pending udev events without blocking. Returns the number of table
+ * changes, each of which is also reported through cb when it is set. */
+int lbe_hotplug_process(struct lbe_hotplug* hp, lbe_hotplug_cb cb, void *arg) {
+	struct pollfd pfd = { .fd = lbe_hotplug_get_fd(hp), .events = POLLIN };
+	int changes = 0;
+
+	while (poll(&pfd, 1, 0) > 0) {
+		struct udev_device *udev_dev = udev_monitor_receive_device(hp->monitor);
+		const char *action, *node;
+		struct lbe_device_info info;
+		int idx;
+
+		if (!udev_dev) break;
+		action = udev_device_get_action(udev_dev);
+		node = udev_device_get_devnode(udev_dev);
+		if (!action || !node) {
+			udev_device_unref(udev_dev);
+			continue;
+		}
+
+		idx = find_device(hp, node);
+		if (strcmp(action, "add") == 0) {
+			if (idx < 0 && hp->count < LBE_HOTPLUG_MAX_DEVICES &&
+			    lbe_udev_get_info(udev_dev, &info) == 0) {
+				hp->devices[hp->count++] = info;
+				changes++;
+				if (cb) cb(LBE_HOTPLUG_ADDED, &info, arg);
+			}
+		} else if (strcmp(action, "remove") == 0) {
+			// Parents are already gone on removal, so match on the node only
+			if (idx >= 0) {
+				info = hp->devices[idx];
+				hp->devices[idx] = hp->devices[--hp->count];
+				changes++;
+				if (cb) cb(LBE_HOTPLUG_REMOVED, &info, arg);
+			}
+		}
+		udev_device_unref(udev_dev);
+	}
+	return changes;
+}
+
+int lbe_hotplug_get_devices(struct lbe_hotplug* hp, struct lbe_device_info *list, int max) {
+	int n = hp->count < max ? hp->count : max;
+
+	memcpy(list, hp->devices, (size_t)n * sizeof(*list));
+	return n;
+}
+
+#endif // __linux__
@@ -0,0 +1,22 @@
+#ifndef LBE_INTERNAL_H
+#define LBE_INTERNAL_H
+
+/* Helpers shared between library sources, not part of the public API */
+
+#include "lbe_device.h"
+#include "lbe_log.h"
+
+/* Messages go through the lbe_set_log_handler() handler */
+#if defined(__GNUC__)
+__attribute__((format(printf, 2, 3)))
+#endif
+void lbe_log(enum lbe_log_level level, const char *fmt, ...);
+void lbe_log_errno(const char *what); // "what: strerror(errno)", like perror()
+
+#ifdef __linux__
+#include <libudev.h>
+
+int lbe_udev_get_info(struct udev_device *hidraw, struct lbe_device_info *info);
+#endif
+
+#endif // LBE_INTERNAL_H
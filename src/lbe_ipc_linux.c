@@ -0,0 +1,162 @@
+#ifdef __linux__
+
+#include "lbe_ipc.h"
+#include "lbe_internal.h"
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#define LBE_IPC_BACKLOG 16
+
+static int fill_addr(struct sockaddr_un *addr, const char *path) {
+	memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr->sun_path)) {
+		lbe_log(LBE_LOG_ERROR, "Socket path too long: %s", path);
+		return -1;
+	}
+	strncpy(addr->sun_path, path, sizeof(addr->sun_path) - 1);
+	return 0;
+}
+
+int lbe_ipc_default_path(char *buf, size_t len) {
+	const char *dir = getenv("XDG_RUNTIME_DIR");
+	int n;
+
+	if (dir && *dir) {
+		n = snprintf(buf, len, "%s/%s", dir, LBE_IPC_SOCKET_NAME);
+	} else {
+		// Shared directory: one name per user, the socket itself is 0600
+		n = snprintf(buf, len, "/tmp/lbe142xd-%u.sock", (unsigned int)getuid());
+	}
+	return (n < 0 || (size_t)n >= len) ? -1 : 0;
+}
+
+/* 0 when nothing answers on path, so a leftover socket may be replaced */
+static int check_unused(const struct sockaddr_un *addr, const char *path) {
+	int fd, res;
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		lbe_log_errno("socket");
+		return -1;
+	}
+	res = connect(fd, (const struct sockaddr *)addr, sizeof(*addr));
+	close(fd);
+	if (res == 0) {
+		lbe_log(LBE_LOG_ERROR, "%s is in use by a running daemon", path);
+		return -1;
+	}
+	if (errno == ENOENT) {
+		return 0;
+	}
+	if (errno == ECONNREFUSED) {
+		// Stale socket left by a daemon that did not clean up
+		unlink(path);
+		return 0;
+	}
+	lbe_log(LBE_LOG_ERROR, "Cannot use %s: %s", path, strerror(errno));
+	return -1;
+}
+
+int lbe_ipc_listen(const char *path) {
+	struct sockaddr_un addr;
+	mode_t old_mask;
+	int fd, res;
+
+	if (fill_addr(&addr, path) < 0) return -1;
+	if (check_unused(&addr, path) < 0) return -1;
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		lbe_log_errno("socket");
+		return -1;
+	}
+
+	// Only the owner may send commands; the mode is set at creation so there is no window
+	old_mask = umask(0177);
+	res = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+	umask(old_mask);
+	if (res < 0) {
+		lbe_log_errno("bind");
+		close(fd);
+		return -1;
+	}
+	if (listen(fd, LBE_IPC_BACKLOG) < 0) {
+		lbe_log_errno("listen");
+		close(fd);
+		unlink(path);
+		return -1;
+	}
+	return fd;
+}
+
+int lbe_ipc_connect(const char *path) {
+	struct sockaddr_un addr;
+	int fd;
+
+	if (fill_addr(&addr, path) < 0) return -1;
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		lbe_log_errno("socket");
+		return -1;
+	}
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		lbe_log(LBE_LOG_ERROR, "Failed to connect to %s: %s", path, strerror(errno));
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/* Send one request line and wait for its reply line. The protocol is
+ * strictly request/response so nothing past the newline is ever buffered. */
+int lbe_ipc_request(int fd, const char *line, char *reply, size_t len) {
+	char req[512];
+	size_t off = 0;
+	int n;
+
+	if (len == 0) return -1;
+
+	n = snprintf(req, sizeof(req), "%s\n", line);
+	if (n < 0 || (size_t)n >= sizeof(req)) return -1;
+	while (off < (size_t)n) {
+		ssize_t w = send(fd, req + off, (size_t)n - off, MSG_NOSIGNAL);
+		if (w < 0) {
+			if (errno == EINTR) continue;
+			lbe_log_errno("send");
+			return -1;
+		}
+		off += (size_t)w;
+	}
+
+	off = 0;
+	for (;;) {
+		ssize_t r = recv(fd, reply + off, len - 1 - off, 0);
+		if (r < 0) {
+			if (errno == EINTR) continue;
+			lbe_log_errno("recv");
+			return -1;
+		}
+		if (r == 0) {
+			lbe_log(LBE_LOG_ERROR, "lbe142xd closed the connection");
+			return -1;
+		}
+		off += (size_t)r;
+		reply[off] = '\0';
+		char *nl = memchr(reply, '\n', off);
+		if (nl) {
+			*nl = '\0';
+			return 0;
+		}
+		if (off == len - 1) return -1;
+	}
+}
+
+#endif // __linux__
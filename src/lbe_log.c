@@ -0,0 +1,44 @@
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "lbe_internal.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#define LOG_LINE_MAX 512
+
+static lbe_log_fn log_fn;
+static void *log_arg;
+
+void lbe_set_log_handler(lbe_log_fn fn, void *arg) {
+	log_fn = fn;
+	log_arg = arg;
+}
+
+static void emit(enum lbe_log_level level, const char *msg) {
+	if (log_fn) {
+		log_fn(level, msg, log_arg);
+	} else {
+		fprintf(stderr, "%s\n", msg);
+	}
+}
+
+void lbe_log(enum lbe_log_level level, const char *fmt, ...) {
+	char msg[LOG_LINE_MAX];
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(msg, sizeof(msg), fmt, ap);
+	va_end(ap);
+	emit(level, msg);
+}
+
+void lbe_log_errno(const char *what) {
+	char msg[LOG_LINE_MAX];
+	int err = errno;
+
+	snprintf(msg, sizeof(msg), "%s: %s", what, strerror(err));
+	emit(LBE_LOG_ERROR, msg);
+}
@@ -0,0 +1,494 @@
+#ifdef __linux__
+
+#define _GNU_SOURCE
+
+#include "lbe_metrics.h"
+#include "lbe_clock.h"
+#include "lbe_common.h"
+#include "lbe_internal.h"
+#include <sys/socket.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <time.h>
+
+#define LISTEN_BACKLOG 16
+#define REQUEST_MAX 4096
+// A scraper that connects and stays silent must not hold up the next one
+#define REQUEST_TIMEOUT_MS 1000
+// Nor one that stops reading the response
+#define RESPONSE_TIMEOUT_MS 1000
+
+enum unit_state {
+	STATE_GPS_LOCKED = 0,
+	STATE_PLL_LOCKED,
+	STATE_ANTENNA_OK,
+	STATE_OUTPUTS_ENABLED,
+	STATE_FLL_ENABLED,
+	STATE_COUNT
+};
+
+static const char *const state_names[STATE_COUNT] = {
+	"gps_locked", "pll_locked", "antenna_ok", "outputs_enabled", "fll_enabled"
+};
+
+// Bucket bounds of the report latency histogram, in seconds
+static const double latency_buckets[] = {
+	0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 1.0
+};
+
+struct unit_snapshot {
+	const char *path;
+	enum lbe_model model;
+	int up;                       // last read succeeded
+	int have_status;
+	struct lbe_status status;
+	uint64_t polls;
+	uint64_t errors;
+	uint64_t last_poll_real_ns;
+	uint64_t last_mono_ns;        // previous successful read, for time in state
+	int state[STATE_COUNT];
+	double state_seconds[STATE_COUNT][2];
+	uint64_t state_changes[STATE_COUNT];
+	struct lbe_histogram latency_ns;
+};
+
+struct lbe_metrics {
+	struct lbe_metrics_opts opts;
+	struct lbe_poller *poller;
+	pthread_mutex_t lock;         // guards units and scrapes
+	int count;
+	struct unit_snapshot *units;
+	uint64_t scrapes;
+	int listen_fd;
+};
+
+static void read_states(const struct lbe_status *status, int *state) {
+	state[STATE_GPS_LOCKED] = (status->raw_status & LBE_GPS_LOCK_BIT) != 0;
+	// Decoded pll_locked is always 0 on the LBE-1420, the raw bit is valid on both
+	state[STATE_PLL_LOCKED] = (status->raw_status & LBE_PLL_LOCK_BIT) != 0;
+	state[STATE_ANTENNA_OK] = status->antenna_ok;
+	state[STATE_OUTPUTS_ENABLED] = status->outputs_enabled;
+	state[STATE_FLL_ENABLED] = status->fll_enabled;
+}
+
+/* Runs on the poller thread: fold one read into the snapshot */
+static int update_snapshot(const struct lbe_poller_sample *sample, void *arg) {
+	struct lbe_metrics *m = arg;
+	struct unit_snapshot *u = &m->units[sample->index];
+	int state[STATE_COUNT];
+
+	pthread_mutex_lock(&m->lock);
+	u->polls++;
+	u->last_poll_real_ns = sample->real_ns;
+	u->up = !sample->failed;
+	if (sample->failed) {
+		// Time without a valid reading is not credited to any state
+		u->errors++;
+		u->last_mono_ns = 0;
+		pthread_mutex_unlock(&m->lock);
+		return 0;
+	}
+	lbe_histogram_add(&u->latency_ns, sample->read_ns);
+	read_states(&sample->status, state);
+	for (int i = 0; i < STATE_COUNT; i++) {
+		if (u->last_mono_ns) {
+			u->state_seconds[i][u->state[i]] += (sample->mono_ns - u->last_mono_ns) / 1e9;
+		}
+		if (u->have_status && state[i] != u->state[i]) {
+			u->state_changes[i]++;
+		}
+		u->state[i] = state[i];
+	}
+	u->status = sample->status;
+	u->have_status = 1;
+	u->last_mono_ns = sample->mono_ns;
+	pthread_mutex_unlock(&m->lock);
+	return 0;
+}
+
+/* OpenMetrics names counter families without the _total suffix of their samples */
+static void write_family(FILE *out, int openmetrics, const char *name, const char *type, const char *help) {
+	size_t len = strlen(name);
+
+	if (openmetrics && strcmp(type, "counter") == 0 && len > 6 && strcmp(name + len - 6, "_total") == 0) {
+		len -= 6;
+	}
+	fprintf(out, "# HELP %.*s %s\n", (int)len, name, help);
+	fprintf(out, "# TYPE %.*s %s\n", (int)len, name, type);
+}
+
+static void write_unit_gauge(FILE *out, const struct lbe_metrics *m, int openmetrics, const char *name,
+		const char *help, size_t offset) {
+	write_family(out, openmetrics, name, "gauge", help);
+	for (int i = 0; i < m->count; i++) {
+		const struct unit_snapshot *u = &m->units[i];
+
+		if (!u->have_status) continue;
+		fprintf(out, "%s{device=\"%s\"} %d\n", name, u->path, *(const int *)((const char *)&u->status + offset));
+	}
+}
+
+static void write_latency(FILE *out, const struct unit_snapshot *u) {
+	size_t nbuckets = sizeof(latency_buckets) / sizeof(latency_buckets[0]);
+	uint64_t seen = 0;
+	int index = 0;
+
+	// A log-linear bucket counts towards a bound once its largest value fits
+	for (size_t b = 0; b < nbuckets; b++) {
+		uint64_t bound_ns = (uint64_t)(latency_buckets[b] * 1e9);
+
+		while (index < LBE_HIST_BUCKETS && lbe_histogram_bucket_upper(index) <= bound_ns) {
+			seen += u->latency_ns.buckets[index++];
+		}
+		fprintf(out, "lbe_report_latency_seconds_bucket{device=\"%s\",le=\"%g\"} %" PRIu64 "\n",
+			u->path, latency_buckets[b], seen);
+	}
+	fprintf(out, "lbe_report_latency_seconds_bucket{device=\"%s\",le=\"+Inf\"} %" PRIu64 "\n",
+		u->path, u->latency_ns.count);
+	fprintf(out, "lbe_report_latency_seconds_sum{device=\"%s\"} %.9f\n", u->path, u->latency_ns.sum / 1e9);
+	fprintf(out, "lbe_report_latency_seconds_count{device=\"%s\"} %" PRIu64 "\n", u->path, u->latency_ns.count);
+}
+
+int lbe_metrics_write(struct lbe_metrics *m, FILE *out, int openmetrics) {
+	pthread_mutex_lock(&m->lock);
+	m->scrapes++;
+
+	write_family(out, openmetrics, "lbe_up", "gauge", "Whether the last status read succeeded");
+	for (int i = 0; i < m->count; i++) {
+		const struct unit_snapshot *u = &m->units[i];
+
+		fprintf(out, "lbe_up{device=\"%s\",model=\"%s\"} %d\n", u->path,
+			u->model == LBE_1420 ? "1420" : "1421", u->up);
+	}
+	write_family(out, openmetrics, "lbe_raw_status", "gauge", "Raw status byte of the last report");
+	for (int i = 0; i < m->count; i++) {
+		if (!m->units[i].have_status) continue;
+		fprintf(out, "lbe_raw_status{device=\"%s\"} %u\n", m->units[i].path, m->units[i].status.raw_status);
+	}
+	write_family(out, openmetrics, "lbe_gps_locked", "gauge", "GPS lock bit");
+	for (int i = 0; i < m->count; i++) {
+		if (!m->units[i].have_status) continue;
+		fprintf(out, "lbe_gps_locked{device=\"%s\"} %d\n", m->units[i].path,
+			m->units[i].state[STATE_GPS_LOCKED]);
+	}
+	write_family(out, openmetrics, "lbe_pll_locked", "gauge", "PLL lock bit");
+	for (int i = 0; i < m->count; i++) {
+		if (!m->units[i].have_status) continue;
+		fprintf(out, "lbe_pll_locked{device=\"%s\"} %d\n", m->units[i].path,
+			m->units[i].state[STATE_PLL_LOCKED]);
+	}
+	write_unit_gauge(out, m, openmetrics, "lbe_antenna_ok", "Antenna not shorted",
+		offsetof(struct lbe_status, antenna_ok));
+	write_unit_gauge(out, m, openmetrics, "lbe_outputs_enabled", "Outputs enabled",
+		offsetof(struct lbe_status, outputs_enabled));
+	write_unit_gauge(out, m, openmetrics, "lbe_pps_enabled", "1PPS on OUT1 enabled (LBE-1421)",
+		offsetof(struct lbe_status, pps_enabled));
+	write_unit_gauge(out, m, openmetrics, "lbe_fll_enabled", "FLL mode instead of PLL",
+		offsetof(struct lbe_status, fll_enabled));
+
+	write_family(out, openmetrics, "lbe_frequency_hz", "gauge", "Output frequency");
+	for (int i = 0; i < m->count; i++) {
+		const struct unit_snapshot *u = &m->units[i];
+
+		if (!u->have_status) continue;
+		fprintf(out, "lbe_frequency_hz{device=\"%s\",output=\"1\"} %u\n", u->path, u->status.frequency1);
+		if (u->model == LBE_1421_DUALOUT) {
+			fprintf(out, "lbe_frequency_hz{device=\"%s\",output=\"2\"} %u\n", u->path, u->status.frequency2);
+		}
+	}
+	write_family(out, openmetrics, "lbe_output_power_low", "gauge", "Output in low power mode");
+	for (int i = 0; i < m->count; i++) {
+		const struct unit_snapshot *u = &m->units[i];
+
+		if (!u->have_status) continue;
+		fprintf(out, "lbe_output_power_low{device=\"%s\",output=\"1\"} %d\n", u->path, u->status.out1_power_low);
+		if (u->model == LBE_1421_DUALOUT) {
+			fprintf(out, "lbe_output_power_low{device=\"%s\",output=\"2\"} %d\n", u->path, u->status.out2_power_low);
+		}
+	}
+
+	write_family(out, openmetrics, "lbe_state_seconds_total", "counter", "Time spent with a status flag at value");
+	for (int i = 0; i < m->count; i++) {
+		for (int s = 0; s < STATE_COUNT; s++) {
+			for (int v = 0; v < 2; v++) {
+				fprintf(out, "lbe_state_seconds_total{device=\"%s\",state=\"%s\",value=\"%d\"} %.3f\n",
+					m->units[i].path, state_names[s], v, m->units[i].state_seconds[s][v]);
+			}
+		}
+	}
+	write_family(out, openmetrics, "lbe_state_changes_total", "counter", "Status flag transitions");
+	for (int i = 0; i < m->count; i++) {
+		for (int s = 0; s < STATE_COUNT; s++) {
+			fprintf(out, "lbe_state_changes_total{device=\"%s\",state=\"%s\"} %" PRIu64 "\n",
+				m->units[i].path, state_names[s], m->units[i].state_changes[s]);
+		}
+	}
+
+	write_family(out, openmetrics, "lbe_polls_total", "counter", "Status reads");
+	for (int i = 0; i < m->count; i++) {
+		fprintf(out, "lbe_polls_total{device=\"%s\"} %" PRIu64 "\n", m->units[i].path, m->units[i].polls);
+	}
+	write_family(out, openmetrics, "lbe_poll_errors_total", "counter", "Failed status reads");
+	for (int i = 0; i < m->count; i++) {
+		fprintf(out, "lbe_poll_errors_total{device=\"%s\"} %" PRIu64 "\n", m->units[i].path, m->units[i].errors);
+	}
+	write_family(out, openmetrics, "lbe_last_poll_timestamp_seconds", "gauge", "Wall clock time of the last status read");
+	for (int i = 0; i < m->count; i++) {
+		fprintf(out, "lbe_last_poll_timestamp_seconds{device=\"%s\"} %.3f\n", m->units[i].path,
+			m->units[i].last_poll_real_ns / 1e9);
+	}
+	write_family(out, openmetrics, "lbe_report_latency_seconds", "histogram", "Status feature report round trip");
+	for (int i = 0; i < m->count; i++) {
+		write_latency(out, &m->units[i]);
+	}
+
+	write_family(out, openmetrics, "lbe_scrapes_total", "counter", "Scrapes served from the snapshot");
+	fprintf(out, "lbe_scrapes_total %" PRIu64 "\n", m->scrapes);
+	if (openmetrics) {
+		fprintf(out, "# EOF\n");
+	}
+	pthread_mutex_unlock(&m->lock);
+	return ferror(out) ? -1 : 0;
+}
+
+/* "<host>:<port>" or "[<ipv6>]:<port>" */
+static int listen_on(const char *address) {
+	struct addrinfo hints, *res, *ai;
+	char host[256];
+	const char *port;
+	int fd = -1, one = 1, err;
+
+	if (address[0] == '[') {
+		const char *end = strchr(address, ']');
+
+		if (!end || end[1] != ':' || (size_t)(end - address - 1) >= sizeof(host)) goto invalid;
+		snprintf(host, sizeof(host), "%.*s", (int)(end - address - 1), address + 1);
+		port = end + 2;
+	} else {
+		const char *colon = strrchr(address, ':');
+
+		if (!colon || (size_t)(colon - address) >= sizeof(host)) goto invalid;
+		snprintf(host, sizeof(host), "%.*s", (int)(colon - address), address);
+		port = colon + 1;
+	}
+	if (!*port) goto invalid;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE;
+	err = getaddrinfo(host[0] ? host : NULL, port, &hints, &res);
+	if (err) {
+		lbe_log(LBE_LOG_ERROR, "%s: %s", address, gai_strerror(err));
+		return -1;
+	}
+	for (ai = res; ai; ai = ai->ai_next) {
+		fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+		if (fd < 0) continue;
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+		if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, LISTEN_BACKLOG) == 0) break;
+		close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(res);
+	if (fd < 0) {
+		lbe_log(LBE_LOG_ERROR, "Failed to listen on %s: %s", address, strerror(errno));
+	}
+	return fd;
+
+invalid:
+	lbe_log(LBE_LOG_ERROR, "Invalid listen address: %s (expected <host>:<port>)", address);
+	return -1;
+}
+
+struct lbe_metrics* lbe_metrics_new(struct lbe_device **devs, int count, const struct lbe_metrics_opts *opts) {
+	struct lbe_metrics *m;
+
+	m = calloc(1, sizeof(struct lbe_metrics));
+	if (!m) return NULL;
+	m->units = calloc((size_t)(count > 0 ? count : 1), sizeof(struct unit_snapshot));
+	if (!m->units) {
+		free(m);
+		return NULL;
+	}
+	m->opts = *opts;
+	m->count = count;
+	m->listen_fd = -1;
+	pthread_mutex_init(&m->lock, NULL);
+	for (int i = 0; i < count; i++) {
+		m->units[i].path = lbe_get_path(devs[i]);
+		m->units[i].model = lbe_get_model(devs[i]);
+		lbe_histogram_init(&m->units[i].latency_ns);
+	}
+
+	m->poller = lbe_poller_new(devs, count, &opts->poll);
+	if (!m->poller) {
+		lbe_metrics_free(m);
+		return NULL;
+	}
+	m->listen_fd = listen_on(opts->listen ? opts->listen : LBE_METRICS_DEFAULT_LISTEN);
+	if (m->listen_fd < 0) {
+		lbe_metrics_free(m);
+		return NULL;
+	}
+	return m;
+}
+
+void lbe_metrics_free(struct lbe_metrics *m) {
+	if (!m) return;
+	if (m->listen_fd >= 0) close(m->listen_fd);
+	lbe_poller_free(m->poller);
+	pthread_mutex_destroy(&m->lock);
+	free(m->units);
+	free(m);
+}
+
+/* Gives up at deadline_ns (CLOCK_MONOTONIC) */
+static int send_all(int fd, const char *buf, size_t len, uint64_t deadline_ns) {
+	struct pollfd pfd = { fd, POLLOUT, 0 };
+
+	while (len) {
+		uint64_t now = lbe_now_ns();
+		ssize_t w;
+		int res;
+
+		if (now >= deadline_ns) return -1;
+		res = poll(&pfd, 1, (int)((deadline_ns - now + 999999) / 1000000));
+		if (res < 0 && errno == EINTR) continue;
+		if (res <= 0) return -1;
+
+		w = send(fd, buf, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+		if (w < 0) {
+			if (errno == EINTR || errno == EAGAIN) continue;
+			return -1;
+		}
+		buf += w;
+		len -= (size_t)w;
+	}
+	return 0;
+}
+
+static void send_response(int fd, const char *status, const char *type, const char *body, size_t len) {
+	uint64_t deadline_ns = lbe_now_ns() + RESPONSE_TIMEOUT_MS * 1000000ULL;
+	char head[256];
+	int n;
+
+	n = snprintf(head, sizeof(head), "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\n"
+		"Connection: close\r\n\r\n", status, type, len);
+	if (send_all(fd, head, (size_t)n, deadline_ns) == 0) {
+		send_all(fd, body, len, deadline_ns);
+	}
+}
+
+/* Read the request head, bounded in size and in total time */
+static int read_request(int fd, char *buf, size_t len) {
+	struct pollfd pfd = { fd, POLLIN, 0 };
+	uint64_t deadline_ns = lbe_now_ns() + REQUEST_TIMEOUT_MS * 1000000ULL;
+	size_t off = 0;
+
+	while (off < len - 1) {
+		uint64_t now = lbe_now_ns();
+		ssize_t r;
+		int res;
+
+		if (now >= deadline_ns) return -1;
+		res = poll(&pfd, 1, (int)((deadline_ns - now + 999999) / 1000000));
+		if (res < 0 && errno == EINTR) continue;
+		if (res <= 0) return -1;
+		r = recv(fd, buf + off, len - 1 - off, 0);
+		if (r < 0 && errno == EINTR) continue;
+		if (r <= 0) return -1;
+		off += (size_t)r;
+		buf[off] = '\0';
+		if (strstr(buf, "\r\n\r\n") || strstr(buf, "\n\n")) return 0;
+	}
+	return -1;
+}
+
+static void serve_client(struct lbe_metrics *m, int fd) {
+	char req[REQUEST_MAX];
+	char *body = NULL;
+	size_t len = 0;
+	FILE *out;
+	int openmetrics;
+
+	if (read_request(fd, req, sizeof(req)) < 0) return;
+	if (strncmp(req, "GET ", 4) != 0) {
+		send_response(fd, "405 Method Not Allowed", "text/plain", "Method not allowed\n", 19);
+		return;
+	}
+	if (strncmp(req + 4, "/metrics ", 9) != 0 && strncmp(req + 4, "/metrics?", 9) != 0) {
+		send_response(fd, "404 Not Found", "text/plain", "Not found, try /metrics\n", 24);
+		return;
+	}
+	openmetrics = strstr(req, "application/openmetrics-text") != NULL;
+
+	out = open_memstream(&body, &len);
+	if (!out) {
+		lbe_log_errno("open_memstream");
+		return;
+	}
+	lbe_metrics_write(m, out, openmetrics);
+	fclose(out);
+	send_response(fd, "200 OK", openmetrics ? "application/openmetrics-text; version=1.0.0; charset=utf-8" :
+		"text/plain; version=0.0.4; charset=utf-8", body, len);
+	free(body);
+}
+
+static void* poller_thread(void *arg) {
+	struct lbe_metrics *m = arg;
+
+	lbe_poller_run(m->poller, update_snapshot, m);
+	return NULL;
+}
+
+int lbe_metrics_run(struct lbe_metrics *m) {
+	volatile sig_atomic_t *stop = m->opts.poll.stop;
+	struct pollfd pfd = { m->listen_fd, POLLIN, 0 };
+	sigset_t all, old;
+	pthread_t thread;
+	int res = 0;
+
+	// Signals go to the serving thread so poll() below returns EINTR
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &old);
+	res = pthread_create(&thread, NULL, poller_thread, m);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (res != 0) {
+		lbe_log(LBE_LOG_ERROR, "pthread_create: %s", strerror(res));
+		return -1;
+	}
+
+	while (!(stop && *stop)) {
+		int fd;
+
+		if (poll(&pfd, 1, -1) < 0) {
+			if (errno == EINTR) continue;
+			lbe_log_errno("poll");
+			res = -1;
+			break;
+		}
+		fd = accept4(m->listen_fd, NULL, NULL, SOCK_CLOEXEC);
+		if (fd < 0) {
+			if (errno != EINTR && errno != ECONNABORTED) lbe_log_errno("accept");
+			continue;
+		}
+		serve_client(m, fd);
+		close(fd);
+	}
+
+	// The poller only sees the stop flag once it wakes up
+	if (stop) *stop = 1;
+	lbe_poller_kick(m->poller, -1);
+	pthread_join(thread, NULL);
+	return res;
+}
+
+#endif // __linux__
@@ -0,0 +1,116 @@
+#ifdef __linux__
+
+#include "lbe_monitor.h"
+#include "lbe_clock.h"
+#include "lbe_internal.h"
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <time.h>
+
+// Give up when the device stops answering, e.g. after it was unplugged
+#define MAX_CONSECUTIVE_ERRORS 10
+
+int lbe_monitor_run(struct lbe_device* dev, const struct lbe_monitor_opts *opts,
+		lbe_sample_cb cb, void *arg, struct lbe_monitor_stats *stats) {
+	struct itimerspec its;
+	uint64_t period_ns, start_ns;
+	int consecutive_errors = 0;
+	int fd;
+
+	memset(stats, 0, sizeof(*stats));
+	if (opts->rate_hz <= 0 || opts->rate_hz > LBE_MONITOR_MAX_RATE) {
+		lbe_log(LBE_LOG_ERROR, "Invalid monitor rate: %g Hz", opts->rate_hz);
+		return -1;
+	}
+	period_ns = (uint64_t)(1e9 / opts->rate_hz);
+
+	fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+	if (fd < 0) {
+		lbe_log_errno("timerfd_create");
+		return -1;
+	}
+
+	// First tick fires immediately, the following ones on a fixed period
+	memset(&its, 0, sizeof(its));
+	its.it_value.tv_nsec = 1;
+	its.it_interval.tv_sec = (time_t)(period_ns / 1000000000ULL);
+	its.it_interval.tv_nsec = (long)(period_ns % 1000000000ULL);
+	if (timerfd_settime(fd, 0, &its, NULL) < 0) {
+		lbe_log_errno("timerfd_settime");
+		close(fd);
+		return -1;
+	}
+
+	start_ns = lbe_clock_ns(CLOCK_MONOTONIC);
+	while (!(opts->stop && *opts->stop)) {
+		struct lbe_sample sample;
+		uint64_t expirations;
+		ssize_t r;
+
+		r = read(fd, &expirations, sizeof(expirations));
+		if (r < 0) {
+			if (errno == EINTR) continue;
+			lbe_log_errno("timerfd read");
+			break;
+		}
+		stats->ticks += expirations;
+		stats->missed_ticks += expirations - 1;
+
+		if (opts->lock && lbe_lock_device(dev, LBE_LOCK_SHARED, opts->lock_wait_ms) < 0) {
+			stats->lock_timeouts++;
+			continue;
+		}
+		r = lbe_get_raw_report(dev, sample.report, sizeof(sample.report));
+		if (opts->lock) lbe_unlock_device(dev);
+		if (r < 0) {
+			stats->errors++;
+			if (++consecutive_errors >= MAX_CONSECUTIVE_ERRORS) {
+				lbe_log(LBE_LOG_ERROR, "Device stopped responding, giving up");
+				break;
+			}
+			continue;
+		}
+		consecutive_errors = 0;
+		lbe_decode_device_report(dev, sample.report, &sample.status);
+		sample.mono_ns = lbe_clock_ns(CLOCK_MONOTONIC);
+		sample.real_ns = lbe_clock_ns(CLOCK_REALTIME);
+		stats->samples++;
+
+		if (cb && cb(&sample, arg)) break;
+		if (opts->count && stats->samples >= opts->count) break;
+	}
+
+	stats->elapsed_s = (lbe_clock_ns(CLOCK_MONOTONIC) - start_ns) / 1e9;
+	if (stats->elapsed_s > 0) {
+		stats->achieved_hz = stats->samples / stats->elapsed_s;
+	}
+	close(fd);
+	return stats->errors && !stats->samples ? -1 : 0;
+}
+
+void lbe_sample_to_record(const struct lbe_sample *sample, struct lbe_sample_record *record) {
+	memset(record, 0, sizeof(*record));
+	record->mono_ns = sample->mono_ns;
+	record->real_ns = sample->real_ns;
+	record->frequency1 = sample->status.frequency1;
+	record->frequency2 = sample->status.frequency2;
+	record->raw_status = sample->status.raw_status;
+	record->flags = (sample->status.fll_enabled ? 0x01 : 0) |
+			(sample->status.out1_power_low ? 0x02 : 0) |
+			(sample->status.out2_power_low ? 0x04 : 0);
+}
+
+/* One sample per line: mono_ns real_ns raw f1 f2 fll pwr1 pwr2 */
+int lbe_sample_print(FILE *out, const struct lbe_sample *sample) {
+	return fprintf(out, "%" PRIu64 " %" PRIu64 " 0x%02X %u %u %d %d %d\n",
+		sample->mono_ns, sample->real_ns, sample->status.raw_status,
+		sample->status.frequency1, sample->status.frequency2,
+		sample->status.fll_enabled, sample->status.out1_power_low,
+		sample->status.out2_power_low);
+}
+
+#endif // __linux__
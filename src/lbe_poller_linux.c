@@ -0,0 +1,225 @@
+#ifdef __linux__
+
+#include "lbe_poller.h"
+#include "lbe_clock.h"
+#include "lbe_internal.h"
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <poll.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+struct poll_unit {
+	struct lbe_device *dev;
+	uint64_t due_ns;
+	uint64_t interval_ns;
+	uint64_t last_poll_ns;
+	int have_status;
+	struct lbe_status last;
+	int kicked;                   // set by lbe_poller_kick(), atomic
+	struct lbe_poller_stats stats;
+};
+
+struct lbe_poller {
+	struct lbe_poller_opts opts;
+	uint64_t min_interval_ns;
+	uint64_t max_interval_ns;
+	int count;
+	int timer_fd;
+	int kick_fd;
+	uint64_t start_ns;
+	struct poll_unit *units;
+};
+
+struct lbe_poller* lbe_poller_new(struct lbe_device **devs, int count, const struct lbe_poller_opts *opts) {
+	struct lbe_poller *p;
+
+	if (count < 1 || count > LBE_POLLER_MAX_DEVICES || opts->min_hz <= 0 || opts->max_hz < opts->min_hz ||
+	    opts->backoff <= 1.0) {
+		lbe_log(LBE_LOG_ERROR, "Invalid poller settings: %d units, %g-%g Hz, backoff %g",
+			count, opts->min_hz, opts->max_hz, opts->backoff);
+		return NULL;
+	}
+
+	p = calloc(1, sizeof(struct lbe_poller));
+	if (!p) return NULL;
+	p->units = calloc((size_t)count, sizeof(struct poll_unit));
+	if (!p->units) {
+		free(p);
+		return NULL;
+	}
+	p->opts = *opts;
+	p->count = count;
+	p->min_interval_ns = (uint64_t)(1e9 / opts->max_hz);
+	p->max_interval_ns = (uint64_t)(1e9 / opts->min_hz);
+
+	p->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+	p->kick_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (p->timer_fd < 0 || p->kick_fd < 0) {
+		lbe_log_errno("timerfd/eventfd");
+		lbe_poller_free(p);
+		return NULL;
+	}
+
+	for (int i = 0; i < count; i++) {
+		p->units[i].dev = devs[i];
+		p->units[i].interval_ns = p->min_interval_ns;
+		lbe_histogram_init(&p->units[i].stats.detect_ns);
+	}
+	return p;
+}
+
+void lbe_poller_free(struct lbe_poller *p) {
+	if (!p) return;
+	if (p->timer_fd >= 0) close(p->timer_fd);
+	if (p->kick_fd >= 0) close(p->kick_fd);
+	free(p->units);
+	free(p);
+}
+
+void lbe_poller_kick(struct lbe_poller *p, int index) {
+	uint64_t one = 1;
+	ssize_t r;
+
+	for (int i = 0; i < p->count; i++) {
+		if (index < 0 || index == i) {
+			__atomic_store_n(&p->units[i].kicked, 1, __ATOMIC_RELEASE);
+		}
+	}
+	// Only fails when the counter is saturated, a wakeup is pending then anyway
+	r = write(p->kick_fd, &one, sizeof(one));
+	(void)r;
+}
+
+const struct lbe_poller_stats* lbe_poller_get_stats(struct lbe_poller *p, int index) {
+	struct poll_unit *u = &p->units[index];
+	uint64_t elapsed_ns = lbe_clock_ns(CLOCK_MONOTONIC) - p->start_ns;
+
+	u->stats.interval_ns = u->interval_ns;
+	u->stats.achieved_hz = p->start_ns && elapsed_ns ? u->stats.polls * 1e9 / (double)elapsed_ns : 0;
+	return &u->stats;
+}
+
+static int same_status(const struct lbe_status *a, const struct lbe_status *b) {
+	return a->raw_status == b->raw_status && a->frequency1 == b->frequency1 &&
+	       a->frequency2 == b->frequency2 && a->fll_enabled == b->fll_enabled &&
+	       a->out1_power_low == b->out1_power_low && a->out2_power_low == b->out2_power_low;
+}
+
+static int poll_one(struct lbe_poller *p, int index, lbe_poller_cb cb, void *arg) {
+	struct poll_unit *u = &p->units[index];
+	struct lbe_poller_sample sample;
+	uint64_t next;
+	int res;
+
+	memset(&sample, 0, sizeof(sample));
+	sample.index = index;
+	sample.dev = u->dev;
+	if (p->opts.lock && lbe_lock_device(u->dev, LBE_LOCK_SHARED, p->opts.lock_wait_ms) < 0) {
+		u->stats.lock_timeouts++;
+		u->due_ns = lbe_clock_ns(CLOCK_MONOTONIC) + u->interval_ns;
+		return 0;
+	}
+	u->stats.polls++;
+	sample.mono_ns = lbe_clock_ns(CLOCK_MONOTONIC);
+	res = lbe_get_device_status(u->dev, &sample.status);
+	sample.read_ns = lbe_clock_ns(CLOCK_MONOTONIC) - sample.mono_ns;
+	if (p->opts.lock) lbe_unlock_device(u->dev);
+	sample.mono_ns += sample.read_ns;
+	sample.real_ns = lbe_clock_ns(CLOCK_REALTIME);
+	if (res < 0) {
+		u->stats.errors++;
+		u->interval_ns = p->min_interval_ns;
+		u->due_ns = sample.mono_ns + u->interval_ns;
+		sample.failed = 1;
+		return cb ? cb(&sample, arg) : 0;
+	}
+	sample.interval_ns = u->last_poll_ns ? sample.mono_ns - u->last_poll_ns : 0;
+	sample.changed = u->have_status && !same_status(&sample.status, &u->last);
+
+	if (sample.changed) {
+		u->stats.changes++;
+		lbe_histogram_add(&u->stats.detect_ns, sample.interval_ns);
+		u->interval_ns = p->min_interval_ns;
+	} else if (u->have_status) {
+		next = (uint64_t)(u->interval_ns * p->opts.backoff);
+		u->interval_ns = next < p->max_interval_ns ? next : p->max_interval_ns;
+	}
+	u->last = sample.status;
+	u->have_status = 1;
+	u->last_poll_ns = sample.mono_ns;
+	// From the scheduled time, not the completion, so the rate does not drift
+	u->due_ns += u->interval_ns;
+	if (u->due_ns < sample.mono_ns) u->due_ns = sample.mono_ns;
+
+	return cb ? cb(&sample, arg) : 0;
+}
+
+static int arm_timer(struct lbe_poller *p, uint64_t due_ns) {
+	struct itimerspec its;
+
+	memset(&its, 0, sizeof(its));
+	if (!due_ns) due_ns = 1; // 0 would disarm
+	its.it_value.tv_sec = (time_t)(due_ns / 1000000000ULL);
+	its.it_value.tv_nsec = (long)(due_ns % 1000000000ULL);
+	return timerfd_settime(p->timer_fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+/* One thread: sleep until the earliest due unit or a kick, poll what is due */
+int lbe_poller_run(struct lbe_poller *p, lbe_poller_cb cb, void *arg) {
+	struct pollfd fds[2];
+	uint64_t drain;
+
+	p->start_ns = lbe_clock_ns(CLOCK_MONOTONIC);
+	// Spread the first polls over one fast interval
+	for (int i = 0; i < p->count; i++) {
+		p->units[i].due_ns = p->start_ns + p->min_interval_ns * (uint64_t)i / (uint64_t)p->count;
+	}
+
+	fds[0].fd = p->timer_fd;
+	fds[0].events = POLLIN;
+	fds[1].fd = p->kick_fd;
+	fds[1].events = POLLIN;
+	while (!(p->opts.stop && *p->opts.stop)) {
+		uint64_t now = lbe_clock_ns(CLOCK_MONOTONIC);
+		uint64_t next_due = UINT64_MAX;
+
+		for (int i = 0; i < p->count; i++) {
+			struct poll_unit *u = &p->units[i];
+
+			if (__atomic_exchange_n(&u->kicked, 0, __ATOMIC_ACQUIRE)) {
+				u->stats.kicks++;
+				u->interval_ns = p->min_interval_ns;
+				u->due_ns = now;
+			}
+			if (u->due_ns <= now) {
+				if (poll_one(p, i, cb, arg)) return 0;
+				now = lbe_clock_ns(CLOCK_MONOTONIC);
+			}
+			if (u->due_ns < next_due) next_due = u->due_ns;
+		}
+		if (next_due <= now) continue;
+
+		if (arm_timer(p, next_due) < 0) {
+			lbe_log_errno("timerfd_settime");
+			return -1;
+		}
+		if (poll(fds, 2, -1) < 0) {
+			if (errno == EINTR) continue;
+			lbe_log_errno("poll");
+			return -1;
+		}
+		if (read(p->timer_fd, &drain, sizeof(drain)) < 0 && errno != EAGAIN) {
+			lbe_log_errno("timerfd read");
+		}
+		if (read(p->kick_fd, &drain, sizeof(drain)) < 0 && errno != EAGAIN) {
+			lbe_log_errno("eventfd read");
+		}
+	}
+	return 0;
+}
+
+#endif // __linux__
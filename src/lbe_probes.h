@@ -0,0 +1,32 @@
+#ifndef LBE_PROBES_H
+#define LBE_PROBES_H
+
+/*
+ * USDT probes under the "lbe142x" provider, for perf and bpftrace. They are
+ * only built in when CMake found <sys/sdt.h>; a disabled probe is a single
+ * nop in the code and otherwise costs nothing. Without the header they
+ * compile away.
+ *
+ *   enumerate_start()                       enumerate_done(count)
+ *   open_start(path)                        open_done(path, dev)
+ *   report_submit(dev, code)                report_complete(dev, code, result, latency_ns)
+ *
+ * path is "" when the default unit is opened. code is the first report
+ * byte: the command code, or LBE_STATUS_REPORT_ID for a status read.
+ */
+
+#ifdef LBE_HAVE_SDT
+#include <sys/sdt.h>
+
+#define LBE_PROBE0(name) DTRACE_PROBE(lbe142x, name)
+#define LBE_PROBE1(name, a) DTRACE_PROBE1(lbe142x, name, a)
+#define LBE_PROBE2(name, a, b) DTRACE_PROBE2(lbe142x, name, a, b)
+#define LBE_PROBE4(name, a, b, c, d) DTRACE_PROBE4(lbe142x, name, a, b, c, d)
+#else
+#define LBE_PROBE0(name) do { } while (0)
+#define LBE_PROBE1(name, a) do { (void)(a); } while (0)
+#define LBE_PROBE2(name, a, b) do { (void)(a); (void)(b); } while (0)
+#define LBE_PROBE4(name, a, b, c, d) do { (void)(a); (void)(b); (void)(c); (void)(d); } while (0)
+#endif
+
+#endif // LBE_PROBES_H
@@ -0,0 +1,544 @@
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "lbe_record.h"
+#include "lbe_common.h"
+#include "lbe_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <io.h>
+#define rec_seek _fseeki64
+#define rec_truncate(f, size) _chsize_s(_fileno(f), (long long)(size))
+#else
+#include <unistd.h>
+#define rec_seek fseeko
+#define rec_truncate(f, size) ftruncate(fileno(f), (off_t)(size))
+#endif
+
+enum frame_type {
+	FRAME_KEY = 0x01,   // u64 mono, u64 real, full report
+	FRAME_DELTA = 0x02, // dod, run count, runs of (offset, length, bytes)
+	FRAME_RUN = 0x03    // count, count x dod; report unchanged
+};
+
+#define MAX_VARINT_LEN 10
+#define MAX_FRAME_LEN (1 + 2 * MAX_VARINT_LEN + 3 * LBE_REPORT_SIZE)
+
+struct lbe_rec_writer {
+	FILE *data;
+	FILE *index;
+	uint8_t *block;
+	size_t len, cap;
+	uint64_t offset;         // where the current block will be written
+	uint64_t bytes;          // appended by this writer
+	uint64_t samples;
+	struct lbe_rec_index_entry entry;
+	uint8_t prev[LBE_REPORT_SIZE];
+	uint64_t prev_mono;
+	int64_t prev_dt;
+	uint32_t run;
+	uint64_t run_dods[LBE_REC_BLOCK_SAMPLES];
+};
+
+struct lbe_rec_reader {
+	FILE *data;
+	enum lbe_model model;
+	struct lbe_rec_index_entry *index;
+	size_t nindex;
+	int have_key;
+	uint8_t report[LBE_REPORT_SIZE];
+	uint64_t mono, key_mono, key_real;
+	int64_t dt;
+	uint64_t run_left;
+};
+
+static void put_u32(uint8_t *p, uint32_t v) {
+	for (int i = 0; i < 4; i++) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static void put_u64(uint8_t *p, uint64_t v) {
+	for (int i = 0; i < 8; i++) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+	uint32_t v = 0;
+
+	for (int i = 3; i >= 0; i--) v = (v << 8) | p[i];
+	return v;
+}
+
+static uint64_t get_u64(const uint8_t *p) {
+	uint64_t v = 0;
+
+	for (int i = 7; i >= 0; i--) v = (v << 8) | p[i];
+	return v;
+}
+
+static uint64_t zigzag(int64_t v) {
+	return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v) {
+	return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static size_t put_varint(uint8_t *p, uint64_t v) {
+	size_t n = 0;
+
+	while (v >= 0x80) {
+		p[n++] = (uint8_t)(v | 0x80);
+		v >>= 7;
+	}
+	p[n++] = (uint8_t)v;
+	return n;
+}
+
+static int read_varint(FILE *f, uint64_t *v) {
+	*v = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		int c = fgetc(f);
+
+		if (c == EOF) return -1;
+		*v |= (uint64_t)(c & 0x7F) << shift;
+		if (!(c & 0x80)) return 0;
+	}
+	return -1;
+}
+
+uint8_t lbe_rec_lock_bits(uint8_t raw_status) {
+	return (uint8_t)(((raw_status & LBE_GPS_LOCK_BIT) ? LBE_REC_LOCK_GPS : 0) |
+	                 ((raw_status & LBE_PLL_LOCK_BIT) ? LBE_REC_LOCK_PLL : 0));
+}
+
+static void encode_entry(uint8_t *p, const struct lbe_rec_index_entry *e) {
+	memset(p, 0, LBE_REC_INDEX_ENTRY_SIZE);
+	put_u64(p, e->offset);
+	put_u64(p + 8, e->length);
+	put_u64(p + 16, e->first_mono_ns);
+	put_u64(p + 24, e->first_real_ns);
+	put_u64(p + 32, e->last_real_ns);
+	put_u32(p + 40, e->samples);
+	p[44] = e->lock_any;
+	p[45] = e->lock_all;
+}
+
+static void decode_entry(const uint8_t *p, struct lbe_rec_index_entry *e) {
+	e->offset = get_u64(p);
+	e->length = get_u64(p + 8);
+	e->first_mono_ns = get_u64(p + 16);
+	e->first_real_ns = get_u64(p + 24);
+	e->last_real_ns = get_u64(p + 32);
+	e->samples = get_u32(p + 40);
+	e->lock_any = p[44];
+	e->lock_all = p[45];
+}
+
+static FILE* open_index(const char *path, const char *mode) {
+	char idx_path[1024];
+
+	if (snprintf(idx_path, sizeof(idx_path), "%s%s", path, LBE_REC_INDEX_SUFFIX) >= (int)sizeof(idx_path)) {
+		return NULL;
+	}
+	return fopen(idx_path, mode);
+}
+
+/* Loads complete index entries, a torn trailing entry is ignored */
+static int load_index(FILE *f, struct lbe_rec_index_entry **entries, size_t *count) {
+	uint8_t buf[LBE_REC_INDEX_ENTRY_SIZE];
+	struct lbe_rec_index_entry *list = NULL;
+	size_t n = 0, cap = 0;
+
+	while (fread(buf, sizeof(buf), 1, f) == 1) {
+		if (n == cap) {
+			struct lbe_rec_index_entry *grown;
+
+			cap = cap ? cap * 2 : 256;
+			grown = realloc(list, cap * sizeof(*list));
+			if (!grown) {
+				lbe_log_errno("realloc");
+				free(list);
+				return -1;
+			}
+			list = grown;
+		}
+		decode_entry(buf, &list[n++]);
+	}
+	*entries = list;
+	*count = n;
+	return 0;
+}
+
+static int read_header(FILE *f, enum lbe_model *model) {
+	uint8_t buf[LBE_REC_HEADER_SIZE];
+
+	if (fread(buf, sizeof(buf), 1, f) != 1 || memcmp(buf, LBE_REC_MAGIC, sizeof(LBE_REC_MAGIC)) != 0 ||
+	    get_u32(buf + 8) != LBE_REC_VERSION || get_u32(buf + 16) != LBE_REPORT_SIZE) {
+		return -1;
+	}
+	*model = get_u32(buf + 12) == LBE_1420 ? LBE_1420 : LBE_1421_DUALOUT;
+	return 0;
+}
+
+static int write_header(FILE *f, enum lbe_model model) {
+	uint8_t buf[LBE_REC_HEADER_SIZE];
+
+	memset(buf, 0, sizeof(buf));
+	memcpy(buf, LBE_REC_MAGIC, sizeof(LBE_REC_MAGIC));
+	put_u32(buf + 8, LBE_REC_VERSION);
+	put_u32(buf + 12, (uint32_t)model);
+	put_u32(buf + 16, LBE_REPORT_SIZE);
+	put_u32(buf + 20, LBE_REC_BLOCK_SAMPLES);
+	return fwrite(buf, sizeof(buf), 1, f) == 1 ? 0 : -1;
+}
+
+/* Position both files at the end of the last indexed block */
+static int prepare_append(struct lbe_rec_writer *w, const char *path, enum lbe_model model) {
+	struct lbe_rec_index_entry *entries;
+	enum lbe_model file_model;
+	size_t count;
+	uint64_t end = LBE_REC_HEADER_SIZE;
+
+	if (read_header(w->data, &file_model) < 0) {
+		lbe_log(LBE_LOG_ERROR, "%s is not an LBE-142x recording", path);
+		return -1;
+	}
+	if (file_model != model) {
+		lbe_log(LBE_LOG_ERROR, "%s was recorded from a different model", path);
+		return -1;
+	}
+
+	w->index = open_index(path, "r+b");
+	if (!w->index) w->index = open_index(path, "w+b");
+	if (!w->index || load_index(w->index, &entries, &count) < 0) {
+		lbe_log(LBE_LOG_ERROR, "Failed to open the index of %s", path);
+		return -1;
+	}
+	if (count) end = entries[count - 1].offset + entries[count - 1].length;
+	free(entries);
+
+	fflush(w->index);
+	if (rec_truncate(w->index, (uint64_t)count * LBE_REC_INDEX_ENTRY_SIZE) != 0 ||
+	    rec_truncate(w->data, end) != 0) {
+		lbe_log_errno(path);
+		return -1;
+	}
+	rec_seek(w->index, 0, SEEK_END);
+	rec_seek(w->data, (long long)end, SEEK_SET);
+	w->offset = end;
+	return 0;
+}
+
+struct lbe_rec_writer* lbe_rec_writer_open(const char *path, enum lbe_model model) {
+	struct lbe_rec_writer *w = calloc(1, sizeof(struct lbe_rec_writer));
+
+	if (!w) return NULL;
+
+	w->data = fopen(path, "r+b");
+	if (w->data) {
+		if (prepare_append(w, path, model) < 0) goto fail;
+	} else {
+		w->data = fopen(path, "w+b");
+		w->index = open_index(path, "w+b");
+		if (!w->data || !w->index || write_header(w->data, model) < 0) {
+			lbe_log_errno(path);
+			goto fail;
+		}
+		w->offset = LBE_REC_HEADER_SIZE;
+	}
+	return w;
+
+fail:
+	if (w->data) fclose(w->data);
+	if (w->index) fclose(w->index);
+	free(w);
+	return NULL;
+}
+
+static int reserve(struct lbe_rec_writer *w, size_t n) {
+	if (w->len + n > w->cap) {
+		size_t cap = w->cap ? w->cap * 2 : 16384;
+		uint8_t *grown;
+
+		while (cap < w->len + n) cap *= 2;
+		grown = realloc(w->block, cap);
+		if (!grown) {
+			lbe_log_errno("realloc");
+			return -1;
+		}
+		w->block = grown;
+		w->cap = cap;
+	}
+	return 0;
+}
+
+static int flush_run(struct lbe_rec_writer *w) {
+	if (!w->run) return 0;
+	if (reserve(w, 1 + MAX_VARINT_LEN * (1 + (size_t)w->run)) < 0) return -1;
+
+	w->block[w->len++] = FRAME_RUN;
+	w->len += put_varint(w->block + w->len, w->run);
+	for (uint32_t i = 0; i < w->run; i++) {
+		w->len += put_varint(w->block + w->len, w->run_dods[i]);
+	}
+	w->run = 0;
+	return 0;
+}
+
+static int flush_block(struct lbe_rec_writer *w) {
+	uint8_t buf[LBE_REC_INDEX_ENTRY_SIZE];
+
+	if (!w->entry.samples) return 0;
+	if (flush_run(w) < 0) return -1;
+
+	w->entry.offset = w->offset;
+	w->entry.length = w->len;
+	encode_entry(buf, &w->entry);
+	// The index entry only goes out once the block itself is complete
+	if (fwrite(w->block, 1, w->len, w->data) != w->len || fflush(w->data) != 0 ||
+	    fwrite(buf, sizeof(buf), 1, w->index) != 1 || fflush(w->index) != 0) {
+		lbe_log_errno("Failed to write recording");
+		return -1;
+	}
+
+	w->offset += w->len;
+	w->bytes += w->len;
+	w->len = 0;
+	memset(&w->entry, 0, sizeof(w->entry));
+	return 0;
+}
+
+static void add_key(struct lbe_rec_writer *w, const struct lbe_rec_sample *s) {
+	w->block[w->len++] = FRAME_KEY;
+	put_u64(w->block + w->len, s->mono_ns);
+	put_u64(w->block + w->len + 8, s->real_ns);
+	memcpy(w->block + w->len + 16, s->report, LBE_REPORT_SIZE);
+	w->len += 16 + LBE_REPORT_SIZE;
+	w->prev_dt = 0;
+
+	w->entry.first_mono_ns = s->mono_ns;
+	w->entry.first_real_ns = s->real_ns;
+	w->entry.lock_all = LBE_REC_LOCK_GPS | LBE_REC_LOCK_PLL;
+}
+
+static void add_delta(struct lbe_rec_writer *w, const struct lbe_rec_sample *s, uint64_t dod) {
+	uint8_t *count_pos;
+	uint8_t runs = 0;
+
+	w->block[w->len++] = FRAME_DELTA;
+	w->len += put_varint(w->block + w->len, dod);
+	count_pos = &w->block[w->len++];
+	for (int i = 0; i < LBE_REPORT_SIZE; ) {
+		int start;
+
+		if (s->report[i] == w->prev[i]) {
+			i++;
+			continue;
+		}
+		start = i;
+		while (i < LBE_REPORT_SIZE && s->report[i] != w->prev[i]) i++;
+		w->block[w->len++] = (uint8_t)start;
+		w->block[w->len++] = (uint8_t)(i - start);
+		memcpy(w->block + w->len, s->report + start, (size_t)(i - start));
+		w->len += (size_t)(i - start);
+		runs++;
+	}
+	*count_pos = runs; // at most LBE_REPORT_SIZE / 2 runs, fits the one byte varint
+}
+
+int lbe_rec_writer_add(struct lbe_rec_writer *w, const struct lbe_rec_sample *s) {
+	uint8_t lock = lbe_rec_lock_bits(s->report[1]);
+
+	if (reserve(w, MAX_FRAME_LEN) < 0) return -1;
+
+	if (!w->entry.samples) {
+		add_key(w, s);
+	} else {
+		int64_t dt = (int64_t)(s->mono_ns - w->prev_mono);
+		uint64_t dod = zigzag(dt - w->prev_dt);
+
+		w->prev_dt = dt;
+		if (memcmp(s->report, w->prev, LBE_REPORT_SIZE) == 0) {
+			w->run_dods[w->run++] = dod;
+		} else {
+			if (flush_run(w) < 0 || reserve(w, MAX_FRAME_LEN) < 0) return -1;
+			add_delta(w, s, dod);
+		}
+	}
+
+	memcpy(w->prev, s->report, LBE_REPORT_SIZE);
+	w->prev_mono = s->mono_ns;
+	w->entry.last_real_ns = s->real_ns;
+	w->entry.lock_any |= lock;
+	w->entry.lock_all &= lock;
+	w->entry.samples++;
+	w->samples++;
+
+	if (w->entry.samples == LBE_REC_BLOCK_SAMPLES ||
+	    s->real_ns - w->entry.first_real_ns >= LBE_REC_BLOCK_NS) {
+		return flush_block(w);
+	}
+	return 0;
+}
+
+int lbe_rec_writer_close(struct lbe_rec_writer *w, uint64_t *samples, uint64_t *bytes) {
+	int res;
+
+	if (!w) return 0;
+	res = flush_block(w);
+	if (samples) *samples = w->samples;
+	if (bytes) *bytes = w->bytes;
+	fclose(w->data);
+	fclose(w->index);
+	free(w->block);
+	free(w);
+	return res;
+}
+
+struct lbe_rec_reader* lbe_rec_reader_open(const char *path) {
+	struct lbe_rec_reader *r = calloc(1, sizeof(struct lbe_rec_reader));
+	FILE *idx;
+
+	if (!r) return NULL;
+
+	r->data = fopen(path, "rb");
+	if (!r->data) {
+		lbe_log_errno(path);
+		free(r);
+		return NULL;
+	}
+	if (read_header(r->data, &r->model) < 0) {
+		lbe_log(LBE_LOG_ERROR, "%s is not an LBE-142x recording", path);
+		fclose(r->data);
+		free(r);
+		return NULL;
+	}
+
+	// Without an index everything still decodes, only seeking gets slower
+	idx = open_index(path, "rb");
+	if (idx) {
+		if (load_index(idx, &r->index, &r->nindex) < 0) {
+			r->index = NULL;
+			r->nindex = 0;
+		}
+		fclose(idx);
+	}
+	return r;
+}
+
+void lbe_rec_reader_close(struct lbe_rec_reader *r) {
+	if (r) {
+		fclose(r->data);
+		free(r->index);
+		free(r);
+	}
+}
+
+enum lbe_model lbe_rec_reader_model(const struct lbe_rec_reader *r) {
+	return r->model;
+}
+
+size_t lbe_rec_reader_index(const struct lbe_rec_reader *r, const struct lbe_rec_index_entry **entries) {
+	*entries = r->index;
+	return r->nindex;
+}
+
+static int seek_offset(struct lbe_rec_reader *r, uint64_t offset) {
+	r->have_key = 0;
+	r->run_left = 0;
+	return rec_seek(r->data, (long long)offset, SEEK_SET) == 0 ? 0 : -1;
+}
+
+int lbe_rec_reader_seek_block(struct lbe_rec_reader *r, size_t block) {
+	const struct lbe_rec_index_entry *last;
+
+	if (block > r->nindex) return -1;
+	if (block < r->nindex) return seek_offset(r, r->index[block].offset);
+	// Past the index: the blocks it does not cover yet, or all of them without one
+	if (!r->nindex) return seek_offset(r, LBE_REC_HEADER_SIZE);
+	last = &r->index[r->nindex - 1];
+	return seek_offset(r, last->offset + last->length);
+}
+
+/* Position at the block holding real_ns; samples before it may still follow */
+int lbe_rec_reader_seek(struct lbe_rec_reader *r, uint64_t real_ns) {
+	size_t lo = 0, hi = r->nindex;
+
+	if (!r->nindex || real_ns < r->index[0].first_real_ns) {
+		return seek_offset(r, LBE_REC_HEADER_SIZE);
+	}
+	// Last block starting at or before real_ns
+	while (hi - lo > 1) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (r->index[mid].first_real_ns <= real_ns) {
+			lo = mid;
+		} else {
+			hi = mid;
+		}
+	}
+	return seek_offset(r, r->index[lo].offset);
+}
+
+static void advance(struct lbe_rec_reader *r, uint64_t dod, struct lbe_rec_sample *s) {
+	r->dt += unzigzag(dod);
+	r->mono += (uint64_t)r->dt;
+	s->mono_ns = r->mono;
+	s->real_ns = r->key_real + (r->mono - r->key_mono);
+	memcpy(s->report, r->report, LBE_REPORT_SIZE);
+}
+
+/* Returns 1 with a sample, 0 at the end of the data (a torn final block
+ * reads as the end) and -1 on corrupt data */
+int lbe_rec_reader_next(struct lbe_rec_reader *r, struct lbe_rec_sample *s) {
+	uint8_t buf[16 + LBE_REPORT_SIZE];
+	uint64_t v, nruns;
+	int type;
+
+	if (r->run_left) {
+		if (read_varint(r->data, &v) < 0) return 0;
+		r->run_left--;
+		advance(r, v, s);
+		return 1;
+	}
+
+	type = fgetc(r->data);
+	switch (type) {
+	case EOF:
+		return 0;
+	case FRAME_KEY:
+		if (fread(buf, sizeof(buf), 1, r->data) != 1) return 0;
+		r->key_mono = r->mono = get_u64(buf);
+		r->key_real = get_u64(buf + 8);
+		memcpy(r->report, buf + 16, LBE_REPORT_SIZE);
+		r->dt = 0;
+		r->have_key = 1;
+		s->mono_ns = r->mono;
+		s->real_ns = r->key_real;
+		memcpy(s->report, r->report, LBE_REPORT_SIZE);
+		return 1;
+	case FRAME_DELTA:
+		if (!r->have_key) return -1;
+		if (read_varint(r->data, &v) < 0 || read_varint(r->data, &nruns) < 0) return 0;
+		for (uint64_t i = 0; i < nruns; i++) {
+			int off = fgetc(r->data);
+			int len = fgetc(r->data);
+
+			if (off == EOF || len == EOF) return 0;
+			if (off + len > LBE_REPORT_SIZE) return -1;
+			if (fread(r->report + off, 1, (size_t)len, r->data) != (size_t)len) return 0;
+		}
+		advance(r, v, s);
+		return 1;
+	case FRAME_RUN:
+		if (!r->have_key) return -1;
+		if (read_varint(r->data, &v) < 0) return 0;
+		if (v == 0) return -1;
+		r->run_left = v;
+		return lbe_rec_reader_next(r, s);
+	default:
+		return -1;
+	}
+}
@@ -0,0 +1,129 @@
+#ifdef __linux__
+
+#include "lbe_record.h"
+#include "lbe_internal.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define CACHE_LINE 64
+
+// Writer thread nap when the ring is empty
+#define IDLE_SLEEP_NS 1000000L
+
+struct lbe_recorder {
+	// Producer side
+	uint32_t head;
+	uint64_t overruns;
+	char pad1[CACHE_LINE - sizeof(uint32_t) - sizeof(uint64_t)];
+	// Consumer side
+	uint32_t tail;
+	char pad2[CACHE_LINE - sizeof(uint32_t)];
+
+	int stopping;
+	uint32_t mask;
+	struct lbe_rec_sample *ring;
+	struct lbe_rec_writer *writer;
+	pthread_t thread;
+	int write_error;
+};
+
+static void* writer_thread(void *arg) {
+	struct lbe_recorder *rec = arg;
+	struct timespec idle = { 0, IDLE_SLEEP_NS };
+
+	for (;;) {
+		uint32_t head = __atomic_load_n(&rec->head, __ATOMIC_ACQUIRE);
+		uint32_t tail = rec->tail;
+
+		if (head == tail) {
+			if (__atomic_load_n(&rec->stopping, __ATOMIC_ACQUIRE)) {
+				// A final push may have landed before stopping was seen
+				if (__atomic_load_n(&rec->head, __ATOMIC_ACQUIRE) == tail) break;
+				continue;
+			}
+			nanosleep(&idle, NULL);
+			continue;
+		}
+		while (tail != head) {
+			if (!rec->write_error && lbe_rec_writer_add(rec->writer, &rec->ring[tail & rec->mask]) < 0) {
+				rec->write_error = 1; // keep draining so the poller never stalls
+			}
+			tail++;
+		}
+		__atomic_store_n(&rec->tail, tail, __ATOMIC_RELEASE);
+	}
+	return NULL;
+}
+
+/* ring_size is rounded up to a power of two */
+struct lbe_recorder* lbe_recorder_start(const char *path, enum lbe_model model, uint32_t ring_size) {
+	struct lbe_recorder *rec;
+	uint32_t size = 1;
+
+	if (!ring_size) ring_size = LBE_RECORDER_DEFAULT_RING;
+	while (size < ring_size) size <<= 1;
+
+	rec = calloc(1, sizeof(struct lbe_recorder));
+	if (!rec) return NULL;
+	rec->ring = calloc(size, sizeof(struct lbe_rec_sample));
+	if (!rec->ring) {
+		lbe_log_errno("calloc");
+		free(rec);
+		return NULL;
+	}
+	rec->mask = size - 1;
+
+	rec->writer = lbe_rec_writer_open(path, model);
+	if (!rec->writer) {
+		free(rec->ring);
+		free(rec);
+		return NULL;
+	}
+	if (pthread_create(&rec->thread, NULL, writer_thread, rec) != 0) {
+		lbe_log_errno("pthread_create");
+		lbe_rec_writer_close(rec->writer, NULL, NULL);
+		free(rec->ring);
+		free(rec);
+		return NULL;
+	}
+	return rec;
+}
+
+/* Called from the polling thread only; returns -1 when the sample was dropped */
+int lbe_recorder_push(struct lbe_recorder *rec, const struct lbe_rec_sample *sample) {
+	uint32_t head = rec->head;
+
+	if (head - __atomic_load_n(&rec->tail, __ATOMIC_ACQUIRE) > rec->mask) {
+		rec->overruns++;
+		return -1;
+	}
+	rec->ring[head & rec->mask] = *sample;
+	__atomic_store_n(&rec->head, head + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+/* Drains the ring, closes the file and frees the recorder */
+int lbe_recorder_stop(struct lbe_recorder *rec, struct lbe_recorder_stats *stats) {
+	uint64_t samples, bytes;
+	int res;
+
+	__atomic_store_n(&rec->stopping, 1, __ATOMIC_RELEASE);
+	pthread_join(rec->thread, NULL);
+	res = lbe_rec_writer_close(rec->writer, &samples, &bytes);
+	if (rec->write_error) res = -1;
+
+	if (stats) {
+		stats->samples = samples;
+		stats->overruns = rec->overruns;
+		stats->bytes = bytes;
+		stats->write_error = res < 0;
+	}
+	free(rec->ring);
+	free(rec);
+	return res;
+}
+
+#endif // __linux__
@@ -0,0 +1,228 @@
+/*
+ * lbe-142x-replay: reads back a recording made with lbe-142x --record. By
+ * default it prints the samples in the --monitor text format, so recordings
+ * can be fed to the same scripts as a live monitor.
+ */
+
+#include "lbe_record.h"
+#include "lbe_common.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum replay_mode {
+	REPLAY_SAMPLES = 0,
+	REPLAY_RAW,
+	REPLAY_LOCKS,
+	REPLAY_INFO
+};
+
+struct lock_interval {
+	int active;
+	uint8_t state;
+	uint64_t start_ns;
+	uint64_t last_ns;
+};
+
+static void print_usage(void) {
+	printf("Usage: lbe-142x-replay [OPTIONS] <recording>\n");
+	printf("Options:\n");
+	printf("  --from <epoch s> Skip samples before this wall clock time\n");
+	printf("  --to <epoch s> Stop after this wall clock time\n");
+	printf("  --raw Print the raw report bytes in hex instead of decoded fields\n");
+	printf("  --locks Print GPS/PLL lock intervals\n");
+	printf("  --info Print a summary of the recording and its index\n");
+	printf("  --help Show this help message\n");
+	printf("Default output matches lbe-142x --monitor:\n");
+	printf("  mono_ns real_ns raw f1 f2 fll pwr1 pwr2\n");
+}
+
+static uint64_t parse_epoch(const char *arg) {
+	return (uint64_t)(strtod(arg, NULL) * 1e9);
+}
+
+static void print_sample(enum lbe_model model, const struct lbe_rec_sample *s) {
+	struct lbe_status status;
+
+	lbe_decode_status(model, s->report, &status);
+	printf("%" PRIu64 " %" PRIu64 " 0x%02X %u %u %d %d %d\n",
+		s->mono_ns, s->real_ns, status.raw_status, status.frequency1, status.frequency2,
+		status.fll_enabled, status.out1_power_low, status.out2_power_low);
+}
+
+static void print_raw(const struct lbe_rec_sample *s) {
+	printf("%" PRIu64 " %" PRIu64 " ", s->mono_ns, s->real_ns);
+	for (int i = 0; i < LBE_REPORT_SIZE; i++) {
+		printf("%02X", s->report[i]);
+	}
+	printf("\n");
+}
+
+static void print_interval(const struct lock_interval *iv, uint64_t end_ns) {
+	printf("%" PRIu64 " %" PRIu64 " gps=%d pll=%d %.3f s\n", iv->start_ns, end_ns,
+		(iv->state & LBE_REC_LOCK_GPS) != 0, (iv->state & LBE_REC_LOCK_PLL) != 0,
+		(end_ns - iv->start_ns) / 1e9);
+}
+
+/* Intervals end where the next one starts, the last one at its last sample */
+static void update_interval(struct lock_interval *iv, uint8_t state, uint64_t real_ns) {
+	if (iv->active && iv->state != state) {
+		print_interval(iv, real_ns);
+		iv->active = 0;
+	}
+	if (!iv->active) {
+		iv->active = 1;
+		iv->state = state;
+		iv->start_ns = real_ns;
+	}
+	iv->last_ns = real_ns;
+}
+
+static int replay_info(struct lbe_rec_reader *r, const char *path) {
+	const struct lbe_rec_index_entry *index;
+	size_t blocks = lbe_rec_reader_index(r, &index);
+	uint64_t samples = 0, bytes = 0;
+
+	for (size_t i = 0; i < blocks; i++) {
+		samples += index[i].samples;
+		bytes += index[i].length;
+	}
+	printf("File: %s\n", path);
+	printf("Model: LBE-%s\n", lbe_rec_reader_model(r) == LBE_1420 ? "1420" : "1421");
+	printf("Blocks: %zu\n", blocks);
+	printf("Samples: %" PRIu64 "\n", samples);
+	if (blocks) {
+		printf("First: %.3f\n", index[0].first_real_ns / 1e9);
+		printf("Last: %.3f\n", index[blocks - 1].last_real_ns / 1e9);
+	}
+	if (samples) {
+		printf("Bytes per sample: %.2f (raw report %d)\n", (double)bytes / (double)samples, LBE_REPORT_SIZE);
+	}
+	return 0;
+}
+
+/* Blocks entirely inside the range whose lock bits never changed and match
+ * the running state are accounted from the index without decoding them */
+static int replay_locks(struct lbe_rec_reader *r, uint64_t from_ns, uint64_t to_ns) {
+	const struct lbe_rec_index_entry *index;
+	size_t blocks = lbe_rec_reader_index(r, &index);
+	struct lock_interval iv;
+	struct lbe_rec_sample s;
+	size_t skipped = 0;
+	int done = 0;
+	int res = 0;
+
+	memset(&iv, 0, sizeof(iv));
+	for (size_t i = 0; i < blocks && res >= 0; i++) {
+		const struct lbe_rec_index_entry *e = &index[i];
+
+		if (e->last_real_ns < from_ns) continue;
+		if (e->first_real_ns > to_ns) {
+			done = 1;
+			break;
+		}
+		if (iv.active && e->lock_any == e->lock_all && e->lock_all == iv.state &&
+		    e->first_real_ns >= from_ns && e->last_real_ns <= to_ns) {
+			iv.last_ns = e->last_real_ns;
+			skipped++;
+			continue;
+		}
+		if (lbe_rec_reader_seek_block(r, i) < 0) return -1;
+		for (uint32_t n = 0; n < e->samples; n++) {
+			res = lbe_rec_reader_next(r, &s);
+			if (res <= 0) break;
+			if (s.real_ns < from_ns || s.real_ns > to_ns) continue;
+			update_interval(&iv, lbe_rec_lock_bits(s.report[1]), s.real_ns);
+		}
+	}
+
+	// Samples written after the last index entry, or the whole file without a .idx
+	if (!done && res >= 0) {
+		if (lbe_rec_reader_seek_block(r, blocks) < 0) return -1;
+		while ((res = lbe_rec_reader_next(r, &s)) > 0) {
+			if (s.real_ns < from_ns) continue;
+			if (s.real_ns > to_ns) break;
+			update_interval(&iv, lbe_rec_lock_bits(s.report[1]), s.real_ns);
+		}
+	}
+	if (iv.active) {
+		print_interval(&iv, iv.last_ns);
+	}
+	fprintf(stderr, "%zu of %zu blocks skipped without decoding\n", skipped, blocks);
+	return res < 0 ? -1 : 0;
+}
+
+static int replay_samples(struct lbe_rec_reader *r, enum replay_mode mode, uint64_t from_ns, uint64_t to_ns) {
+	enum lbe_model model = lbe_rec_reader_model(r);
+	struct lbe_rec_sample s;
+	int res;
+
+	if (lbe_rec_reader_seek(r, from_ns) < 0) return -1;
+	while ((res = lbe_rec_reader_next(r, &s)) > 0) {
+		if (s.real_ns < from_ns) continue;
+		if (s.real_ns > to_ns) break;
+		if (mode == REPLAY_RAW) {
+			print_raw(&s);
+		} else {
+			print_sample(model, &s);
+		}
+		if (ferror(stdout)) break;
+	}
+	return res < 0 ? -1 : 0;
+}
+
+int main(int argc, char *argv[]) {
+	enum replay_mode mode = REPLAY_SAMPLES;
+	uint64_t from_ns = 0, to_ns = UINT64_MAX;
+	const char *path = NULL;
+	struct lbe_rec_reader *r;
+	int res;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--from") == 0 && i + 1 < argc) {
+			from_ns = parse_epoch(argv[++i]);
+		} else if (strcmp(argv[i], "--to") == 0 && i + 1 < argc) {
+			to_ns = parse_epoch(argv[++i]);
+		} else if (strcmp(argv[i], "--raw") == 0) {
+			mode = REPLAY_RAW;
+		} else if (strcmp(argv[i], "--locks") == 0) {
+			mode = REPLAY_LOCKS;
+		} else if (strcmp(argv[i], "--info") == 0) {
+			mode = REPLAY_INFO;
+		} else if (strcmp(argv[i], "--help") == 0) {
+			print_usage();
+			return 0;
+		} else if (argv[i][0] == '-' || path) {
+			fprintf(stderr, "Unknown option: %s\n", argv[i]);
+			print_usage();
+			return 1;
+		} else {
+			path = argv[i];
+		}
+	}
+	if (!path) {
+		print_usage();
+		return 1;
+	}
+
+	r = lbe_rec_reader_open(path);
+	if (!r) return 1;
+
+	switch (mode) {
+	case REPLAY_INFO:
+		res = replay_info(r, path);
+		break;
+	case REPLAY_LOCKS:
+		res = replay_locks(r, from_ns, to_ns);
+		break;
+	default:
+		res = replay_samples(r, mode, from_ns, to_ns);
+		break;
+	}
+	if (res < 0) {
+		fprintf(stderr, "%s: corrupt recording\n", path);
+	}
+	lbe_rec_reader_close(r);
+	return res < 0 ? 1 : 0;
+}
@@ -0,0 +1,149 @@
+#ifdef __linux__
+
+#define _GNU_SOURCE
+
+#include "lbe_schedule.h"
+#include "lbe_clock.h"
+#include "lbe_internal.h"
+#include <sys/mman.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+// Stack touched up front so the send path does not page fault
+#define PREFAULT_STACK_SIZE (64 * 1024)
+
+void lbe_schedule_opts_init(struct lbe_schedule_opts *opts) {
+	memset(opts, 0, sizeof(*opts));
+	opts->lock_memory = 1;
+	opts->cpu = -1;
+	opts->spin_us = LBE_SCHEDULE_DEFAULT_SPIN_US;
+}
+
+static void prefault_stack(void) {
+	volatile unsigned char stack[PREFAULT_STACK_SIZE];
+
+	for (size_t i = 0; i < sizeof(stack); i += 4096) {
+		stack[i] = 0;
+	}
+}
+
+/* Every requested step is attempted; -1 if any of them failed */
+int lbe_schedule_prepare(const struct lbe_schedule_opts *opts) {
+	int res = 0;
+
+	if (opts->lock_memory) {
+		if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0) {
+			lbe_log_errno("mlockall");
+			res = -1;
+		}
+		prefault_stack();
+	}
+	if (opts->cpu >= 0) {
+		cpu_set_t set;
+
+		CPU_ZERO(&set);
+		CPU_SET(opts->cpu, &set);
+		if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+			lbe_log(LBE_LOG_ERROR, "Failed to pin to CPU %d: %s", opts->cpu, strerror(errno));
+			res = -1;
+		}
+	}
+	if (opts->rt_priority > 0) {
+		struct sched_param param;
+
+		memset(&param, 0, sizeof(param));
+		param.sched_priority = opts->rt_priority;
+		if (sched_setscheduler(0, SCHED_FIFO, &param) < 0) {
+			lbe_log(LBE_LOG_ERROR, "Failed to switch to SCHED_FIFO %d: %s", opts->rt_priority, strerror(errno));
+			res = -1;
+		}
+	}
+	return res;
+}
+
+int lbe_schedule_send(struct lbe_device *dev, const struct lbe_report *report, uint64_t at_ns,
+		const struct lbe_schedule_opts *opts, struct lbe_schedule_result *res) {
+	uint64_t spin_ns = (uint64_t)opts->spin_us * 1000ULL;
+	uint64_t wake_ns = at_ns > spin_ns ? at_ns - spin_ns : 0;
+	uint64_t start_ns;
+	struct timespec ts;
+	int ret;
+
+	memset(res, 0, sizeof(*res));
+	res->target_ns = at_ns;
+	if (lbe_clock_ns(CLOCK_REALTIME) >= at_ns) {
+		lbe_log(LBE_LOG_ERROR, "Scheduled time has already passed");
+		return -1;
+	}
+
+	// Realtime clock: a step of the system time moves the wakeup with it
+	ts.tv_sec = (time_t)(wake_ns / 1000000000ULL);
+	ts.tv_nsec = (long)(wake_ns % 1000000000ULL);
+	while ((ret = clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &ts, NULL)) != 0) {
+		if (ret != EINTR) {
+			lbe_log(LBE_LOG_ERROR, "clock_nanosleep: %s", strerror(ret));
+			return -1;
+		}
+		if (opts->stop && *opts->stop) return -1;
+	}
+	res->wake_error_ns = (int64_t)(lbe_clock_ns(CLOCK_REALTIME) - wake_ns);
+
+	while ((res->issued_ns = lbe_clock_ns(CLOCK_REALTIME)) < at_ns) {
+		// Busy-wait the last spin_us, sleeping has too coarse a wakeup
+	}
+	start_ns = lbe_clock_ns(CLOCK_MONOTONIC);
+	ret = lbe_send_prepared(dev, report);
+	res->report_ns = lbe_clock_ns(CLOCK_MONOTONIC) - start_ns;
+	res->issue_error_ns = (int64_t)(res->issued_ns - at_ns);
+	return ret;
+}
+
+int lbe_parse_utc(const char *text, uint64_t *real_ns) {
+	struct tm tm;
+	double sec, value;
+	char sep;
+	time_t t;
+	int whole, mday, end = 0;
+
+	if (text[0] == '+' || text[0] == '@') {
+		char *stop;
+
+		value = strtod(text + 1, &stop);
+		// Above ~584 years the nanoseconds no longer fit in a u64
+		if (stop == text + 1 || *stop || !(value >= 0 && value < 1.8e10)) goto invalid;
+		*real_ns = (uint64_t)(value * 1e9) + (text[0] == '+' ? lbe_clock_ns(CLOCK_REALTIME) : 0);
+		return 0;
+	}
+
+	memset(&tm, 0, sizeof(tm));
+	if (sscanf(text, "%4d-%2d-%2d%c%2d:%2d:%lf%n", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &sep,
+		&tm.tm_hour, &tm.tm_min, &sec, &end) != 7 || (sep != 'T' && sep != ' ')) {
+		goto invalid;
+	}
+	if (text[end] == 'Z') end++;
+	// timegm() would silently normalise out of range fields, e.g. month 13
+	if (text[end] || tm.tm_year < 1970 || tm.tm_mon < 1 || tm.tm_mon > 12 || tm.tm_mday < 1 ||
+	    tm.tm_mday > 31 || tm.tm_hour > 23 || tm.tm_min > 59 || !(sec >= 0 && sec < 61)) {
+		goto invalid;
+	}
+	tm.tm_year -= 1900;
+	tm.tm_mon -= 1;
+	mday = tm.tm_mday;
+	whole = (int)sec;
+	tm.tm_sec = whole;
+	t = timegm(&tm);
+	// A day past the end of the month, e.g. February 30, moves into the next one
+	if (t == (time_t)-1 || (whole < 60 && tm.tm_mday != mday)) goto invalid;
+	*real_ns = (uint64_t)t * 1000000000ULL + (uint64_t)((sec - whole) * 1e9 + 0.5);
+	return 0;
+
+invalid:
+	lbe_log(LBE_LOG_ERROR, "Invalid time: %s (expected YYYY-MM-DDTHH:MM:SS[.frac][Z], @<epoch> or +<s>)", text);
+	return -1;
+}
+
+#endif // __linux__
@@ -0,0 +1,97 @@
+#include "lbe_settle.h"
+#include "lbe_clock.h"
+#include "lbe_common.h"
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+static void sleep_us(uint32_t us) {
+#ifdef _WIN32
+	Sleep((us + 999) / 1000);
+#else
+	struct timespec ts = { (time_t)(us / 1000000), (long)(us % 1000000) * 1000L };
+
+	nanosleep(&ts, NULL);
+#endif
+}
+
+void lbe_settle_opts_init(struct lbe_settle_opts *opts) {
+	opts->timeout_ms = LBE_SETTLE_DEFAULT_TIMEOUT_MS;
+	opts->min_poll_us = LBE_SETTLE_MIN_POLL_US;
+	opts->max_poll_us = LBE_SETTLE_MAX_POLL_US;
+	opts->confirm_polls = 1;
+}
+
+static int is_settled(const struct lbe_status *status, uint32_t f1, uint32_t f2) {
+	return (status->raw_status & LBE_PLL_LOCK_BIT) &&
+	       (!f1 || status->frequency1 == f1) &&
+	       (!f2 || status->frequency2 == f2);
+}
+
+static int wait_settled(struct lbe_device* dev, uint32_t f1, uint32_t f2, uint64_t start_ns,
+		const struct lbe_settle_opts *opts, struct lbe_settle_result *result) {
+	uint64_t deadline_ns = start_ns + (uint64_t)opts->timeout_ms * 1000000ULL;
+	uint32_t poll_us = opts->min_poll_us;
+	uint32_t matched = 0;
+	uint64_t first_match_ns = 0;
+	struct lbe_status prev;
+
+	memset(result, 0, sizeof(*result));
+	memset(&prev, 0, sizeof(prev));
+	for (;;) {
+		uint64_t now;
+
+		if (lbe_get_device_status(dev, &result->status) < 0) {
+			return -1;
+		}
+		now = lbe_now_ns();
+		result->polls++;
+
+		if (is_settled(&result->status, f1, f2)) {
+			if (!matched++) first_match_ns = now;
+			if (matched >= opts->confirm_polls) {
+				result->settle_ns = first_match_ns - start_ns;
+				return 0;
+			}
+		} else {
+			matched = 0;
+		}
+		if (now >= deadline_ns) {
+			result->settle_ns = now - start_ns;
+			result->timed_out = 1;
+			return -1;
+		}
+
+		if (result->polls > 1 && (result->status.raw_status != prev.raw_status ||
+		    result->status.frequency1 != prev.frequency1 || result->status.frequency2 != prev.frequency2)) {
+			poll_us = opts->min_poll_us;
+		} else if (poll_us < opts->max_poll_us) {
+			poll_us = poll_us * 2 < opts->max_poll_us ? poll_us * 2 : opts->max_poll_us;
+		}
+		prev = result->status;
+		if (now + (uint64_t)poll_us * 1000ULL > deadline_ns) {
+			poll_us = (uint32_t)((deadline_ns - now) / 1000ULL);
+		}
+		sleep_us(poll_us);
+	}
+}
+
+int lbe_wait_settled(struct lbe_device* dev, uint32_t f1, uint32_t f2,
+		const struct lbe_settle_opts *opts, struct lbe_settle_result *result) {
+	return wait_settled(dev, f1, f2, lbe_now_ns(), opts, result);
+}
+
+int lbe_set_frequency_wait(struct lbe_device* dev, int output, uint32_t frequency, int temp,
+		const struct lbe_settle_opts *opts, struct lbe_settle_result *result) {
+	uint64_t start_ns = lbe_now_ns();
+	int res = temp ? lbe_set_frequency_temp(dev, output, frequency) : lbe_set_frequency(dev, output, frequency);
+
+	if (res < 0) {
+		memset(result, 0, sizeof(*result));
+		return -1;
+	}
+	return wait_settled(dev, output == 1 ? frequency : 0, output == 2 ? frequency : 0, start_ns, opts, result);
+}
@@ -0,0 +1,97 @@
+#ifdef __linux__
+
+#include "lbe_shm.h"
+#include "lbe_monitor.h"
+#include "lbe_internal.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+
+struct lbe_shm_publisher {
+	char name[LBE_PATH_MAX];
+	struct lbe_shm_page *page;
+};
+
+/* Create the named page, or take over one left behind by a publisher that
+ * is no longer running. Fails while another live publisher owns it. */
+struct lbe_shm_publisher* lbe_shm_publisher_new(const char *name, enum lbe_model model, uint64_t interval_ns) {
+	struct lbe_shm_publisher *pub;
+	int fd;
+
+	pub = calloc(1, sizeof(struct lbe_shm_publisher));
+	if (!pub) return NULL;
+	snprintf(pub->name, sizeof(pub->name), "%s", name);
+
+	fd = shm_open(name, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		lbe_log_errno("shm_open");
+		free(pub);
+		return NULL;
+	}
+	if (ftruncate(fd, sizeof(struct lbe_shm_page)) < 0) {
+		lbe_log_errno("ftruncate");
+		close(fd);
+		free(pub);
+		return NULL;
+	}
+	pub->page = mmap(NULL, sizeof(struct lbe_shm_page), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (pub->page == MAP_FAILED) {
+		lbe_log_errno("mmap");
+		free(pub);
+		return NULL;
+	}
+	if (pub->page->magic == LBE_SHM_MAGIC && pub->page->data.publisher_pid != 0 &&
+	    (kill((pid_t)pub->page->data.publisher_pid, 0) == 0 || errno == EPERM)) {
+		lbe_log(LBE_LOG_ERROR, "%s is already published by pid %u", name, pub->page->data.publisher_pid);
+		munmap(pub->page, sizeof(struct lbe_shm_page));
+		free(pub);
+		return NULL;
+	}
+
+	// Hold the sequence odd while the header is (re)written
+	__atomic_store_n(&pub->page->seq, pub->page->seq | 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	memset(&pub->page->data, 0, sizeof(pub->page->data));
+	pub->page->data.interval_ns = interval_ns;
+	pub->page->data.publisher_pid = (uint32_t)getpid();
+	pub->page->data.model = (uint32_t)model;
+	pub->page->size = sizeof(struct lbe_shm_page);
+	pub->page->version = LBE_SHM_VERSION;
+	pub->page->magic = LBE_SHM_MAGIC;
+	__atomic_store_n(&pub->page->seq, pub->page->seq + 1, __ATOMIC_RELEASE);
+	return pub;
+}
+
+void lbe_shm_publish(struct lbe_shm_publisher *pub, const struct lbe_sample *sample) {
+	struct lbe_shm_page *page = pub->page;
+	uint32_t seq = page->seq; // only this process writes it
+
+	__atomic_store_n(&page->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	page->data.mono_ns = sample->mono_ns;
+	page->data.real_ns = sample->real_ns;
+	page->data.status = sample->status;
+	page->data.samples++;
+	__atomic_store_n(&page->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/* Marks the page as abandoned and removes its name; mapped readers see
+ * publisher_pid == 0 rather than a page that silently stops updating */
+void lbe_shm_publisher_free(struct lbe_shm_publisher *pub) {
+	uint32_t seq;
+
+	if (!pub) return;
+	seq = pub->page->seq;
+	__atomic_store_n(&pub->page->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	pub->page->data.publisher_pid = 0;
+	__atomic_store_n(&pub->page->seq, seq + 2, __ATOMIC_RELEASE);
+
+	munmap(pub->page, sizeof(struct lbe_shm_page));
+	shm_unlink(pub->name);
+	free(pub);
+}
+
+#endif // __linux__
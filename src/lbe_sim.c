@@ -0,0 +1,137 @@
+#include "lbe_sim.h"
+#include "lbe_common.h"
+#include <string.h>
+
+#define SIM_DEFAULT_FREQUENCY 10000000
+
+static uint32_t get_u32(const uint8_t *p) {
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+	p[0] = (v >>  0) & 0xff;
+	p[1] = (v >>  8) & 0xff;
+	p[2] = (v >> 16) & 0xff;
+	p[3] = (v >> 24) & 0xff;
+}
+
+void lbe_sim_init(struct lbe_sim *sim, enum lbe_model model) {
+	memset(sim, 0, sizeof(*sim));
+	sim->model = model;
+	sim->flash_frequency[0] = sim->frequency[0] = SIM_DEFAULT_FREQUENCY;
+	if (model == LBE_1421_DUALOUT) {
+		sim->flash_frequency[1] = sim->frequency[1] = SIM_DEFAULT_FREQUENCY;
+	}
+	sim->outputs_enabled = 1;
+	sim->gps_locked = 1;
+	sim->pll_locked = 1;
+	sim->antenna_ok = 1;
+}
+
+void lbe_sim_tick(struct lbe_sim *sim, uint64_t now_ns) {
+	sim->now_ns = now_ns;
+	if (!sim->pll_locked && sim->relock_deadline_ns && now_ns >= sim->relock_deadline_ns) {
+		sim->pll_locked = 1;
+		sim->relock_deadline_ns = 0;
+	}
+}
+
+static void lose_lock(struct lbe_sim *sim) {
+	if (!sim->relock_ns) return;
+	sim->pll_locked = 0;
+	sim->relock_deadline_ns = sim->now_ns + sim->relock_ns;
+}
+
+/* Fill the 0x4B status report, returns its length */
+int lbe_sim_get_feature(struct lbe_sim *sim, uint8_t *buf, size_t len) {
+	int locked = sim->gps_locked && sim->pll_locked;
+	uint8_t raw = 0;
+
+	if (len < LBE_SIM_REPORT_SIZE) return -1;
+	memset(buf, 0, LBE_SIM_REPORT_SIZE);
+
+	if (sim->gps_locked) raw |= LBE_GPS_LOCK_BIT;
+	if (sim->pll_locked) raw |= LBE_PLL_LOCK_BIT;
+	if (sim->antenna_ok) raw |= LBE_ANT_OK_BIT;
+	if (sim->outputs_enabled) {
+		raw |= LBE_OUT1_EN_BIT;
+		if (locked) raw |= LBE_LED1_BIT;
+		if (sim->model == LBE_1421_DUALOUT) {
+			raw |= LBE_OUT2_EN_BIT;
+			if (locked) raw |= LBE_LED2_BIT;
+		}
+	}
+	if (sim->pps_enabled) raw |= LBE_PPS_EN_BIT;
+
+	buf[0] = 0x4B;
+	buf[1] = raw;
+	put_u32(&buf[6], sim->frequency[0]);
+	if (sim->model == LBE_1421_DUALOUT) {
+		put_u32(&buf[14], sim->frequency[1]);
+		buf[18] = (uint8_t)sim->fll_enabled;
+		buf[19] = (uint8_t)sim->power_low[0];
+		buf[20] = (uint8_t)sim->power_low[1];
+	} else {
+		buf[10] = (uint8_t)sim->power_low[0];
+		buf[18] = (uint8_t)sim->fll_enabled;
+	}
+	sim->get_reports++;
+	return LBE_SIM_REPORT_SIZE;
+}
+
+static void set_frequency(struct lbe_sim *sim, int output, uint32_t frequency, int save) {
+	if (sim->frequency[output] != frequency) lose_lock(sim);
+	sim->frequency[output] = frequency;
+	if (save) {
+		sim->flash_frequency[output] = frequency;
+		sim->flash_writes++;
+	}
+}
+
+/* Apply a SET report, returns -1 for commands the model does not accept */
+int lbe_sim_set_feature(struct lbe_sim *sim, const uint8_t *buf, size_t len) {
+	int dual = sim->model == LBE_1421_DUALOUT;
+
+	if (len < 9) return -1;
+	sim->set_reports++;
+
+	switch (buf[0]) {
+	case LBE_142X_EN_OUT:
+		sim->outputs_enabled = buf[1] != 0;
+		return 0;
+	case LBE_142X_BLINK_OUT:
+		return 0;
+	case LBE_142X_SET_PLL:
+		if (sim->fll_enabled != (buf[1] != 0)) lose_lock(sim);
+		sim->fll_enabled = buf[1] != 0;
+		return 0;
+	case LBE_1420_SET_F1_TEMP:
+	case LBE_1420_SET_F1:
+		if (dual) return -1;
+		set_frequency(sim, 0, get_u32(&buf[1]), buf[0] == LBE_1420_SET_F1);
+		return 0;
+	case LBE_1420_SET_PWR1:
+		if (dual) return -1;
+		sim->power_low[0] = buf[1] != 0;
+		return 0;
+	case LBE_1421_SET_F1_TEMP:
+	case LBE_1421_SET_F1:
+	case LBE_1421_SET_F2_TEMP:
+	case LBE_1421_SET_F2:
+		if (!dual) return -1;
+		set_frequency(sim, (buf[0] == LBE_1421_SET_F1_TEMP || buf[0] == LBE_1421_SET_F1) ? 0 : 1,
+			get_u32(&buf[5]), buf[0] == LBE_1421_SET_F1 || buf[0] == LBE_1421_SET_F2);
+		return 0;
+	case LBE_1421_SET_PPS:
+		if (!dual) return -1;
+		sim->pps_enabled = buf[1] != 0;
+		return 0;
+	case LBE_1421_SET_PWR1:
+	case LBE_1421_SET_PWR2:
+		if (!dual) return -1;
+		sim->power_low[buf[0] == LBE_1421_SET_PWR1 ? 0 : 1] = buf[1] != 0;
+		return 0;
+	default:
+		return -1;
+	}
+}
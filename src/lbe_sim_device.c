@@ -0,0 +1,65 @@
+#include "lbe_sim.h"
+#include "lbe_clock.h"
+#include "lbe_transport.h"
+#include <stdlib.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+struct sim_transport {
+	struct lbe_sim *sim;
+	uint64_t latency_ns;
+};
+
+/* Spin rather than sleep: timer slack would swamp microsecond latencies */
+static void simulate_latency(struct sim_transport *t) {
+	uint64_t start;
+
+	if (!t->latency_ns) return;
+	start = lbe_now_ns();
+	while (lbe_now_ns() - start < t->latency_ns) {
+	}
+}
+
+static int sim_get_feature(void *ctx, uint8_t *buf, size_t len) {
+	struct sim_transport *t = ctx;
+
+	simulate_latency(t);
+	lbe_sim_tick(t->sim, lbe_now_ns());
+	if (buf[0] != LBE_STATUS_REPORT_ID || lbe_sim_get_feature(t->sim, buf, len) < 0) {
+		return -1;
+	}
+	return 0;
+}
+
+static int sim_set_feature(void *ctx, const uint8_t *buf, size_t len) {
+	struct sim_transport *t = ctx;
+
+	simulate_latency(t);
+	lbe_sim_tick(t->sim, lbe_now_ns());
+	return lbe_sim_set_feature(t->sim, buf, len);
+}
+
+static void sim_close(void *ctx) {
+	free(ctx);
+}
+
+static const struct lbe_transport_ops sim_ops = {
+	"sim",
+	sim_get_feature,
+	sim_set_feature,
+	sim_close,
+	NULL, // no other process can reach the simulator
+};
+
+struct lbe_device* lbe_open_simulator(struct lbe_sim *sim, unsigned int latency_us) {
+	struct sim_transport *t = malloc(sizeof(struct sim_transport));
+	if (!t) return NULL;
+
+	t->sim = sim;
+	t->latency_ns = (uint64_t)latency_us * 1000;
+	lbe_sim_tick(sim, lbe_now_ns());
+	return lbe_open_transport(&sim_ops, t, sim->model, "sim");
+}
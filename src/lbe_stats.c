@@ -0,0 +1,34 @@
+#include "lbe_stats.h"
+#include "lbe_common.h"
+
+/* The LBE-1420 codes do not overlap the LBE-1421 ones, so one table fits both */
+const char* lbe_cmd_code_name(uint8_t code) {
+	switch (code) {
+	case LBE_142X_EN_OUT: return "outputs";
+	case LBE_142X_BLINK_OUT: return "blink";
+	case LBE_1420_SET_F1_TEMP: return "f1t";
+	case LBE_1420_SET_F1: return "f1";
+	case LBE_1420_SET_PWR1: return "pwr1";
+	case LBE_1421_SET_F1_TEMP: return "f1t";
+	case LBE_1421_SET_F1: return "f1";
+	case LBE_1421_SET_F2_TEMP: return "f2t";
+	case LBE_1421_SET_F2: return "f2";
+	case LBE_142X_SET_PLL: return "pll";
+	case LBE_1421_SET_PPS: return "pps";
+	case LBE_1421_SET_PWR1: return "pwr1";
+	case LBE_1421_SET_PWR2: return "pwr2";
+	case LBE_STATUS_REPORT_ID: return "status";
+	default: return "other";
+	}
+}
+
+void lbe_cmd_stats_print(FILE *out, const struct lbe_cmd_stats *list, int count) {
+	for (int i = 0; i < count; i++) {
+		const struct lbe_cmd_stats *s = &list[i];
+
+		fprintf(out, "%s (0x%02X): %llu calls, %llu errors, %llu bytes, %.3f ms total\n",
+			lbe_cmd_code_name(s->code), s->code, (unsigned long long)s->calls,
+			(unsigned long long)s->errors, (unsigned long long)s->bytes, s->latency_ns.sum / 1e6);
+		lbe_histogram_print(out, "  latency", &s->latency_ns);
+	}
+}
@@ -0,0 +1,380 @@
+#ifdef __linux__
+
+#include "lbe_sweep.h"
+#include "lbe_clock.h"
+#include "lbe_codec.h"
+#include "lbe_internal.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <time.h>
+
+#define LBE_SWEEP_MAX_HOPS 100000000U
+
+#define PLAN_MAGIC "LBEPLAN"
+#define PLAN_HEADER_SIZE 32
+#define PLAN_RECORD_SIZE 64
+
+struct lbe_plan {
+	const uint8_t *map;
+	size_t size;
+	struct lbe_plan_info info;
+};
+
+static void sleep_until(uint64_t deadline_ns) {
+	struct timespec ts;
+
+	ts.tv_sec = (time_t)(deadline_ns / 1000000000ULL);
+	ts.tv_nsec = (long)(deadline_ns % 1000000000ULL);
+	// EINTR is not retried: a signal only matters if it set the stop flag
+	clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+/* Steps from start towards stop (either direction), stop included when it
+ * falls on a step. The caller frees *hops. */
+int lbe_sweep_build(uint32_t start, uint32_t stop, uint32_t step, uint32_t dwell_us,
+		struct lbe_hop **hops, uint32_t *count) {
+	uint32_t span = start <= stop ? stop - start : start - stop;
+	uint32_t n;
+
+	if (step == 0) {
+		lbe_log(LBE_LOG_ERROR, "Sweep step must not be 0");
+		return -1;
+	}
+	n = span / step + 1;
+	if (n > LBE_SWEEP_MAX_HOPS) {
+		lbe_log(LBE_LOG_ERROR, "Sweep too long: %u steps", n);
+		return -1;
+	}
+
+	*hops = malloc((size_t)n * sizeof(**hops));
+	if (!*hops) {
+		lbe_log_errno("malloc");
+		return -1;
+	}
+	for (uint32_t i = 0; i < n; i++) {
+		(*hops)[i].frequency = start <= stop ? start + i * step : start - i * step;
+		(*hops)[i].dwell_us = dwell_us;
+	}
+	*count = n;
+	return 0;
+}
+
+/* One hop per line: "<freq Hz> [dwell ms]", '#' starts a comment */
+int lbe_hop_list_load(const char *path, uint32_t default_dwell_us, struct lbe_hop **hops, uint32_t *count) {
+	char line[128];
+	uint32_t n = 0, cap = 0;
+	struct lbe_hop *list = NULL;
+	int lineno = 0;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f) {
+		lbe_log_errno(path);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		unsigned long freq;
+		double dwell_ms;
+		char *comment = strchr(line, '#');
+		int fields;
+
+		lineno++;
+		if (comment) *comment = '\0';
+		fields = sscanf(line, "%lu %lf", &freq, &dwell_ms);
+		if (fields <= 0) continue;
+		// dwell_us is a u32, a little over 71 minutes
+		if (freq == 0 || freq > 0xFFFFFFFFUL ||
+		    (fields == 2 && !(dwell_ms >= 0 && dwell_ms * 1000.0 <= 0xFFFFFFFFUL))) {
+			lbe_log(LBE_LOG_ERROR, "%s:%d: invalid hop", path, lineno);
+			goto fail;
+		}
+		if (n == cap) {
+			struct lbe_hop *grown;
+
+			cap = cap ? cap * 2 : 256;
+			grown = realloc(list, (size_t)cap * sizeof(*list));
+			if (!grown) {
+				lbe_log_errno("realloc");
+				goto fail;
+			}
+			list = grown;
+		}
+		list[n].frequency = (uint32_t)freq;
+		list[n].dwell_us = fields == 2 ? (uint32_t)(dwell_ms * 1000.0) : default_dwell_us;
+		n++;
+	}
+
+	fclose(f);
+	if (n == 0) {
+		lbe_log(LBE_LOG_ERROR, "%s: no hops", path);
+		free(list);
+		return -1;
+	}
+	*hops = list;
+	*count = n;
+	return 0;
+
+fail:
+	fclose(f);
+	free(list);
+	return -1;
+}
+
+/* Accounts one hop issued at t0 and completed at t1, then moves the deadline */
+static void account_hop(struct lbe_sweep_stats *stats, uint64_t *deadline, uint64_t t0, uint64_t t1,
+		uint32_t dwell_us) {
+	stats->hops++;
+	stats->latency_sum_ns += t1 - t0;
+	if (t1 - t0 < stats->latency_min_ns) stats->latency_min_ns = t1 - t0;
+	if (t1 - t0 > stats->latency_max_ns) stats->latency_max_ns = t1 - t0;
+	if (t0 > *deadline && t0 - *deadline > stats->lateness_max_ns) {
+		stats->lateness_max_ns = t0 - *deadline;
+	}
+
+	// Keep the schedule anchored: the next deadline does not move when we are late
+	*deadline += (uint64_t)dwell_us * 1000ULL;
+	if (dwell_us && t1 > *deadline) {
+		stats->deadline_misses++;
+	}
+}
+
+static int finish_stats(struct lbe_sweep_stats *stats, uint64_t start_ns) {
+	stats->elapsed_s = (lbe_now_ns() - start_ns) / 1e9;
+	if (stats->elapsed_s > 0) {
+		stats->hop_rate = stats->hops / stats->elapsed_s;
+	}
+	if (!stats->hops) {
+		stats->latency_min_ns = 0;
+	}
+	return stats->errors ? -1 : 0;
+}
+
+/* loops = 0 repeats until *stop is set */
+int lbe_sweep_run(struct lbe_device* dev, int output, const struct lbe_hop *hops, uint32_t count,
+		uint32_t loops, volatile sig_atomic_t *stop, struct lbe_sweep_stats *stats) {
+	uint64_t start_ns, deadline;
+
+	memset(stats, 0, sizeof(*stats));
+	stats->latency_min_ns = UINT64_MAX;
+
+	start_ns = lbe_now_ns();
+	deadline = start_ns;
+	for (uint32_t loop = 0; loops == 0 || loop < loops; loop++) {
+		for (uint32_t i = 0; i < count; i++) {
+			uint64_t t0, t1;
+
+			if (stop && *stop) goto done;
+			sleep_until(deadline);
+			if (stop && *stop) goto done;
+
+			t0 = lbe_now_ns();
+			if (lbe_set_frequency_temp(dev, output, hops[i].frequency) < 0) {
+				stats->errors++;
+			}
+			t1 = lbe_now_ns();
+			account_hop(stats, &deadline, t0, t1, hops[i].dwell_us);
+		}
+	}
+
+done:
+	return finish_stats(stats, start_ns);
+}
+
+static void put_le(uint8_t *p, uint64_t value, int bytes) {
+	for (int i = 0; i < bytes; i++) {
+		p[i] = (value >> (8 * i)) & 0xff;
+	}
+}
+
+static uint64_t get_le(const uint8_t *p, int bytes) {
+	uint64_t value = 0;
+
+	for (int i = bytes - 1; i >= 0; i--) {
+		value = (value << 8) | p[i];
+	}
+	return value;
+}
+
+/* Encodes every hop up front; a frequency the model cannot produce fails the write */
+int lbe_plan_write(const char *path, enum lbe_model model, int output, const struct lbe_hop *hops, uint32_t count) {
+	const struct lbe_codec *codec = lbe_codec_get(model);
+	uint8_t header[PLAN_HEADER_SIZE] = {0};
+	uint8_t record[PLAN_RECORD_SIZE];
+	uint64_t total_us = 0;
+	FILE *f;
+
+	if (count == 0) {
+		lbe_log(LBE_LOG_ERROR, "%s: no hops", path);
+		return -1;
+	}
+	for (uint32_t i = 0; i < count; i++) {
+		if (hops[i].frequency < 1 || hops[i].frequency > codec->max_frequency) {
+			lbe_log(LBE_LOG_ERROR, "Invalid frequency for %s: %u Hz", codec->name, hops[i].frequency);
+			return -1;
+		}
+		total_us += hops[i].dwell_us;
+	}
+
+	f = fopen(path, "wb");
+	if (!f) {
+		lbe_log_errno(path);
+		return -1;
+	}
+	memcpy(header, PLAN_MAGIC, sizeof(PLAN_MAGIC));
+	put_le(&header[8], LBE_PLAN_VERSION, 2);
+	header[10] = (uint8_t)model;
+	header[11] = (uint8_t)output;
+	put_le(&header[12], PLAN_RECORD_SIZE, 4);
+	put_le(&header[16], count, 8);
+	put_le(&header[24], total_us, 8);
+	if (fwrite(header, sizeof(header), 1, f) != 1) goto write_error;
+
+	memset(record, 0, sizeof(record));
+	for (uint32_t i = 0; i < count; i++) {
+		put_le(record, hops[i].dwell_us, 4);
+		if (lbe_codec_frequency(codec, output, hops[i].frequency, 1, &record[4]) < 0) {
+			fclose(f);
+			return -1;
+		}
+		if (fwrite(record, sizeof(record), 1, f) != 1) goto write_error;
+	}
+	if (fclose(f) != 0) {
+		lbe_log_errno(path);
+		return -1;
+	}
+	return 0;
+
+write_error:
+	lbe_log_errno(path);
+	fclose(f);
+	return -1;
+}
+
+struct lbe_plan* lbe_plan_open(const char *path) {
+	struct lbe_plan *plan;
+	const uint8_t *h;
+	struct stat st;
+	void *map;
+	int fd;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		lbe_log_errno(path);
+		return NULL;
+	}
+	if (fstat(fd, &st) < 0) {
+		lbe_log_errno(path);
+		close(fd);
+		return NULL;
+	}
+	if (st.st_size < PLAN_HEADER_SIZE) {
+		lbe_log(LBE_LOG_ERROR, "%s: not a plan file", path);
+		close(fd);
+		return NULL;
+	}
+	map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		lbe_log_errno("mmap");
+		return NULL;
+	}
+
+	h = map;
+	if (memcmp(h, PLAN_MAGIC, sizeof(PLAN_MAGIC)) != 0 || get_le(&h[8], 2) != LBE_PLAN_VERSION ||
+	    get_le(&h[12], 4) != PLAN_RECORD_SIZE || h[10] > LBE_1421_DUALOUT ||
+	    h[11] < 1 || h[11] > lbe_codec_get((enum lbe_model)h[10])->outputs ||
+	    get_le(&h[16], 8) != ((uint64_t)st.st_size - PLAN_HEADER_SIZE) / PLAN_RECORD_SIZE ||
+	    ((uint64_t)st.st_size - PLAN_HEADER_SIZE) % PLAN_RECORD_SIZE != 0) {
+		lbe_log(LBE_LOG_ERROR, "%s: not a plan file or truncated", path);
+		munmap(map, (size_t)st.st_size);
+		return NULL;
+	}
+	if (get_le(&h[16], 8) == 0) {
+		lbe_log(LBE_LOG_ERROR, "%s: no hops", path);
+		munmap(map, (size_t)st.st_size);
+		return NULL;
+	}
+	// Playback reads each record once, front to back
+	madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+	plan = malloc(sizeof(*plan));
+	if (!plan) {
+		lbe_log_errno("malloc");
+		munmap(map, (size_t)st.st_size);
+		return NULL;
+	}
+	plan->map = map;
+	plan->size = (size_t)st.st_size;
+	plan->info.model = (enum lbe_model)h[10];
+	plan->info.output = h[11];
+	plan->info.count = get_le(&h[16], 8);
+	plan->info.total_dwell_us = get_le(&h[24], 8);
+	return plan;
+}
+
+void lbe_plan_close(struct lbe_plan *plan) {
+	if (plan) {
+		munmap((void *)plan->map, plan->size);
+		free(plan);
+	}
+}
+
+void lbe_plan_get_info(const struct lbe_plan *plan, struct lbe_plan_info *info) {
+	*info = plan->info;
+}
+
+/* Same schedule as lbe_sweep_run, sending the mapped reports as they are */
+int lbe_plan_run(struct lbe_device* dev, const struct lbe_plan *plan, uint32_t loops,
+		volatile sig_atomic_t *stop, struct lbe_sweep_stats *stats) {
+	const uint8_t *records = plan->map + PLAN_HEADER_SIZE;
+	const struct lbe_codec *codec = lbe_codec_get(plan->info.model);
+	uint8_t code = codec->set_frequency_temp[plan->info.output - 1];
+	uint64_t start_ns, deadline;
+
+	memset(stats, 0, sizeof(*stats));
+	if (lbe_get_model(dev) != plan->info.model) {
+		lbe_log(LBE_LOG_ERROR, "Plan was built for %s, the device is %s",
+			lbe_codec_get(plan->info.model)->name, lbe_codec_get(lbe_get_model(dev))->name);
+		return -1;
+	}
+	stats->latency_min_ns = UINT64_MAX;
+
+	start_ns = lbe_now_ns();
+	deadline = start_ns;
+	for (uint32_t loop = 0; loops == 0 || loop < loops; loop++) {
+		for (uint64_t i = 0; i < plan->info.count; i++) {
+			const uint8_t *record = records + i * PLAN_RECORD_SIZE;
+			uint32_t frequency = (uint32_t)get_le(&record[4 + codec->frequency_offset], 4);
+			uint64_t t0, t1;
+
+			// Only temporary changes go out, a corrupt record must never reach flash
+			if (record[4] != code || frequency < 1 || frequency > codec->max_frequency) {
+				lbe_log(LBE_LOG_ERROR, "Plan hop %" PRIu64 " is not a valid temporary frequency change", i);
+				stats->errors++;
+				goto done;
+			}
+			if (stop && *stop) goto done;
+			sleep_until(deadline);
+			if (stop && *stop) goto done;
+
+			t0 = lbe_now_ns();
+			if (lbe_send_prepared(dev, (const struct lbe_report *)&record[4]) < 0) {
+				stats->errors++;
+			}
+			t1 = lbe_now_ns();
+			account_hop(stats, &deadline, t0, t1, (uint32_t)get_le(record, 4));
+		}
+	}
+
+done:
+	return finish_stats(stats, start_ns);
+}
+
+#endif // __linux__
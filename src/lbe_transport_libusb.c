@@ -0,0 +1,354 @@
+#if defined(_WIN32) || defined(LBE_WITH_LIBUSB)
+
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "lbe_libusb.h"
+#include "lbe_codec.h"
+#include "lbe_common.h"
+#include "lbe_transport.h"
+#include "lbe_internal.h"
+#include <libusb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+
+// libusb reports carry an extra 0x4B prefix ahead of the hidraw layout
+#define USB_REPORT_SIZE (64)
+#define LBE_INTERFACE 0
+
+// Fallback definitions for constants that might be missing
+#ifndef LIBUSB_REQUEST_GET_REPORT
+#define LIBUSB_REQUEST_GET_REPORT 0x01
+#endif
+
+#ifndef LIBUSB_REQUEST_SET_REPORT
+#define LIBUSB_REQUEST_SET_REPORT 0x09
+#endif
+
+#ifndef LIBUSB_REPORT_TYPE_FEATURE
+#define LIBUSB_REPORT_TYPE_FEATURE 0x03
+#endif
+
+struct libusb_transport {
+	libusb_context *usb; // own context, so events are only handled for this unit
+	libusb_device_handle *handle;
+	unsigned int timeout_ms;
+	int claimed;
+};
+
+struct status_request {
+	lbe_libusb_status_cb cb;
+	void *arg;
+	unsigned char buf[LIBUSB_CONTROL_SETUP_SIZE + USB_REPORT_SIZE];
+};
+
+static int is_lbe_id(uint16_t vendor, uint16_t product) {
+	return vendor == VID_LBE && (product == PID_LBE_1420 || product == PID_LBE_1421);
+}
+
+/* Bus-port path such as "1-2.3", the sysfs name of the USB device */
+static void get_port_path(libusb_device *device, char *buf, size_t len) {
+	uint8_t ports[8];
+	int n = libusb_get_port_numbers(device, ports, (int)sizeof(ports));
+	int off = snprintf(buf, len, "%u", libusb_get_bus_number(device));
+
+	for (int i = 0; i < n && off > 0 && (size_t)off < len; i++) {
+		off += snprintf(buf + off, len - (size_t)off, "%c%u", i ? '.' : '-', ports[i]);
+	}
+}
+
+int lbe_libusb_enumerate(struct lbe_device_info *list, int max) {
+	libusb_context *usb;
+	libusb_device **devs;
+	ssize_t cnt;
+	int count = 0;
+	int ret;
+
+	ret = libusb_init(&usb);
+	if (ret < 0) {
+		lbe_log(LBE_LOG_ERROR, "Failed to initialize libusb: %s", libusb_error_name(ret));
+		return -1;
+	}
+
+	cnt = libusb_get_device_list(usb, &devs);
+	if (cnt < 0) {
+		lbe_log(LBE_LOG_ERROR, "Failed to get device list: %s", libusb_error_name((int)cnt));
+		libusb_exit(usb);
+		return -1;
+	}
+
+	for (ssize_t i = 0; i < cnt && count < max; i++) {
+		struct libusb_device_descriptor desc;
+		struct lbe_device_info *info = &list[count];
+		libusb_device_handle *handle;
+
+		if (libusb_get_device_descriptor(devs[i], &desc) < 0)
+			continue;
+		if (!is_lbe_id(desc.idVendor, desc.idProduct))
+			continue;
+
+		memset(info, 0, sizeof(*info));
+		get_port_path(devs[i], info->path, sizeof(info->path));
+		memcpy(info->usb_path, info->path, sizeof(info->usb_path));
+		if (desc.iSerialNumber && libusb_open(devs[i], &handle) == 0) {
+			libusb_get_string_descriptor_ascii(handle, desc.iSerialNumber,
+				(unsigned char *)info->serial, (int)sizeof(info->serial));
+			libusb_close(handle);
+		}
+		info->vendor_id = desc.idVendor;
+		info->product_id = desc.idProduct;
+		info->model = (desc.idProduct == PID_LBE_1420) ? LBE_1420 : LBE_1421_DUALOUT;
+		count++;
+	}
+
+	libusb_free_device_list(devs, 1);
+	libusb_exit(usb);
+	return count;
+}
+
+static int usb_get_feature(void *ctx, uint8_t *buf, size_t len) {
+	struct libusb_transport *t = ctx;
+	uint8_t usb_buf[USB_REPORT_SIZE] = {0};
+	int ret;
+
+	if (len > USB_REPORT_SIZE - 1) {
+		lbe_log(LBE_LOG_ERROR, "Feature report too long");
+		return -1;
+	}
+
+	usb_buf[0] = buf[0]; // Report Number
+	ret = libusb_control_transfer(t->handle,
+				LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_CLASS | LIBUSB_RECIPIENT_INTERFACE,
+				LIBUSB_REQUEST_GET_REPORT,
+				(LIBUSB_REPORT_TYPE_FEATURE << 8) | buf[0],
+				LBE_INTERFACE,
+				usb_buf,
+				USB_REPORT_SIZE,
+				t->timeout_ms);
+
+	if (ret < 0) {
+		lbe_log(LBE_LOG_ERROR, "Failed to get feature report: %s", libusb_error_name(ret));
+		return -1;
+	}
+
+	// Payload starts one byte later than on hidraw
+	memcpy(buf + 1, usb_buf + 2, len - 1);
+	return 0;
+}
+
+static int usb_set_feature(void *ctx, const uint8_t *buf, size_t len) {
+	struct libusb_transport *t = ctx;
+	uint8_t usb_buf[USB_REPORT_SIZE] = {0};
+	int ret;
+
+	if (len > USB_REPORT_SIZE - 1) {
+		lbe_log(LBE_LOG_ERROR, "Feature report too long");
+		return -1;
+	}
+
+	usb_buf[0] = LBE_STATUS_REPORT_ID; // Report ID
+	memcpy(usb_buf + 1, buf, len);
+	ret = libusb_control_transfer(t->handle,
+				LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_CLASS | LIBUSB_RECIPIENT_INTERFACE,
+				LIBUSB_REQUEST_SET_REPORT,
+				(LIBUSB_REPORT_TYPE_FEATURE << 8) | usb_buf[0],
+				LBE_INTERFACE,
+				usb_buf,
+				USB_REPORT_SIZE,
+				t->timeout_ms);
+
+	if (ret < 0) {
+		lbe_log(LBE_LOG_ERROR, "Failed to send feature report: %s", libusb_error_name(ret));
+		return -1;
+	}
+	return 0;
+}
+
+static void usb_close(void *ctx) {
+	struct libusb_transport *t = ctx;
+
+	// With auto detach, releasing hands the interface back to usbhid
+	if (t->claimed) libusb_release_interface(t->handle, LBE_INTERFACE);
+	libusb_close(t->handle);
+	libusb_exit(t->usb);
+	free(t);
+}
+
+static const struct lbe_transport_ops libusb_ops = {
+	"libusb",
+	usb_get_feature,
+	usb_set_feature,
+	usb_close,
+	NULL, // WinUSB hands a device to one process at a time, usbfs claims are exclusive
+};
+
+/* usbfs rejects interface requests while usbhid is bound to the interface */
+static int claim_interface(struct libusb_transport *t) {
+#ifdef _WIN32
+	(void)t;
+	return 0;
+#else
+	int ret;
+
+	libusb_set_auto_detach_kernel_driver(t->handle, 1);
+	ret = libusb_claim_interface(t->handle, LBE_INTERFACE);
+	if (ret < 0) {
+		lbe_log(LBE_LOG_ERROR, "Failed to claim interface: %s", libusb_error_name(ret));
+		return -1;
+	}
+	t->claimed = 1;
+	return 0;
+#endif
+}
+
+/* port_path is NULL to open the first LBE-142x found */
+struct lbe_device* lbe_libusb_open(const char *port_path) {
+	struct libusb_transport *t = calloc(1, sizeof(struct libusb_transport));
+	if (!t) return NULL;
+
+	libusb_device **devs;
+	ssize_t cnt;
+	int ret;
+	char path[LBE_PATH_MAX];
+
+	t->timeout_ms = LBE_LIBUSB_DEFAULT_TIMEOUT_MS;
+	ret = libusb_init(&t->usb);
+	if (ret < 0) {
+		lbe_log(LBE_LOG_ERROR, "Failed to initialize libusb: %s", libusb_error_name(ret));
+		free(t);
+		return NULL;
+	}
+
+	cnt = libusb_get_device_list(t->usb, &devs);
+	if (cnt < 0) {
+		lbe_log(LBE_LOG_ERROR, "Failed to get device list: %s", libusb_error_name((int)cnt));
+		libusb_exit(t->usb);
+		free(t);
+		return NULL;
+	}
+
+	for (ssize_t i = 0; i < cnt; i++) {
+		struct libusb_device_descriptor desc;
+		libusb_device *device = devs[i];
+
+		if (libusb_get_device_descriptor(device, &desc) < 0)
+			continue;
+
+		if (is_lbe_id(desc.idVendor, desc.idProduct)) {
+			get_port_path(device, path, sizeof(path));
+			if (port_path && strcmp(port_path, path) != 0)
+				continue;
+			ret = libusb_open(device, &t->handle);
+			if (ret < 0) {
+				lbe_log(LBE_LOG_ERROR, "Failed to open device: %s", libusb_error_name(ret));
+				continue;
+			}
+			if (claim_interface(t) < 0) {
+				libusb_close(t->handle);
+				continue;
+			}
+			enum lbe_model model = (desc.idProduct == PID_LBE_1420) ? LBE_1420 : LBE_1421_DUALOUT;
+			struct lbe_device *dev;
+
+			libusb_free_device_list(devs, 1);
+			dev = lbe_open_transport(&libusb_ops, t, model, path);
+			if (dev) lbe_set_codec(dev, lbe_codec_get_libusb(model));
+			return dev;
+		}
+	}
+
+	lbe_log(LBE_LOG_ERROR, "LBE-142x device not found");
+	libusb_free_device_list(devs, 1);
+	libusb_exit(t->usb);
+	free(t);
+	return NULL;
+}
+
+static struct libusb_transport* get_transport(struct lbe_device *dev) {
+	if (strcmp(lbe_get_transport_name(dev), libusb_ops.name) != 0) {
+		lbe_log(LBE_LOG_ERROR, "%s is not a libusb device", lbe_get_path(dev));
+		return NULL;
+	}
+	return lbe_get_transport_ctx(dev);
+}
+
+int lbe_libusb_set_timeout(struct lbe_device *dev, unsigned int timeout_ms) {
+	struct libusb_transport *t = get_transport(dev);
+
+	if (!t) return -1;
+	t->timeout_ms = timeout_ms;
+	return 0;
+}
+
+static void LIBUSB_CALL status_done(struct libusb_transfer *xfer) {
+	struct status_request *req = xfer->user_data;
+	uint8_t report[LBE_REPORT_SIZE];
+	int result = -1;
+
+	if (xfer->status == LIBUSB_TRANSFER_COMPLETED) {
+		// Same translation as usb_get_feature()
+		report[0] = LBE_STATUS_REPORT_ID;
+		memcpy(report + 1, req->buf + LIBUSB_CONTROL_SETUP_SIZE + 2, LBE_REPORT_SIZE - 1);
+		result = 0;
+	}
+	req->cb(result, report, req->arg);
+	free(req);
+	libusb_free_transfer(xfer);
+}
+
+int lbe_libusb_submit_status(struct lbe_device *dev, lbe_libusb_status_cb cb, void *arg) {
+	struct libusb_transport *t = get_transport(dev);
+	struct libusb_transfer *xfer;
+	struct status_request *req;
+	int ret;
+
+	if (!t) return -1;
+	req = calloc(1, sizeof(struct status_request));
+	xfer = libusb_alloc_transfer(0);
+	if (!req || !xfer) {
+		free(req);
+		if (xfer) libusb_free_transfer(xfer);
+		return -1;
+	}
+	req->cb = cb;
+	req->arg = arg;
+	libusb_fill_control_setup(req->buf,
+		LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_CLASS | LIBUSB_RECIPIENT_INTERFACE,
+		LIBUSB_REQUEST_GET_REPORT, (LIBUSB_REPORT_TYPE_FEATURE << 8) | LBE_STATUS_REPORT_ID,
+		LBE_INTERFACE, USB_REPORT_SIZE);
+	libusb_fill_control_transfer(xfer, t->handle, req->buf, status_done, req, t->timeout_ms);
+
+	ret = libusb_submit_transfer(xfer);
+	if (ret < 0) {
+		lbe_log(LBE_LOG_ERROR, "Failed to submit status read: %s", libusb_error_name(ret));
+		free(req);
+		libusb_free_transfer(xfer);
+		return -1;
+	}
+	return 0;
+}
+
+int lbe_libusb_handle_events(struct lbe_device *dev, int timeout_ms) {
+	struct libusb_transport *t = get_transport(dev);
+	struct timeval tv;
+	int ret;
+
+	if (!t) return -1;
+	tv.tv_sec = timeout_ms / 1000;
+	tv.tv_usec = (timeout_ms % 1000) * 1000;
+	ret = libusb_handle_events_timeout_completed(t->usb, &tv, NULL);
+	if (ret < 0) {
+		lbe_log(LBE_LOG_ERROR, "Failed to handle USB events: %s", libusb_error_name(ret));
+		return -1;
+	}
+	return 0;
+}
+
+#endif // _WIN32 || LBE_WITH_LIBUSB
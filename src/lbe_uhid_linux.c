@@ -0,0 +1,195 @@
+#ifdef __linux__
+
+/*
+ * lbe-142x-uhid: creates a virtual LBE-1420/1421 through /dev/uhid so the
+ * tools, lbe142xd and lbe-142x-bench can run against the real hidraw path
+ * without hardware. Feature report requests are answered by lbe_sim.
+ */
+
+#include "lbe_common.h"
+#include "lbe_clock.h"
+#include "lbe_sim.h"
+#include <linux/uhid.h>
+#include <poll.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+
+#ifndef BUS_USB
+#define BUS_USB 0x03
+#endif
+
+/* Vendor defined collection with a 59 byte feature report 0x4B */
+static const uint8_t report_descriptor[] = {
+	0x06, 0x00, 0xFF, // Usage Page (Vendor Defined 0xFF00)
+	0x09, 0x01,       // Usage (0x01)
+	0xA1, 0x01,       // Collection (Application)
+	0x85, 0x4B,       //   Report ID (0x4B)
+	0x15, 0x00,       //   Logical Minimum (0)
+	0x26, 0xFF, 0x00, //   Logical Maximum (255)
+	0x75, 0x08,       //   Report Size (8)
+	0x95, 0x3B,       //   Report Count (59)
+	0x09, 0x01,       //   Usage (0x01)
+	0xB1, 0x02,       //   Feature (Data,Var,Abs)
+	0xC0,             // End Collection
+};
+
+static volatile sig_atomic_t running = 1;
+
+static void on_signal(int sig) {
+	(void)sig;
+	running = 0;
+}
+
+static void print_usage(void) {
+	printf("Usage: lbe-142x-uhid [OPTIONS]\n");
+	printf("Options:\n");
+	printf("  --model <1420|1421> Model to emulate (default 1421)\n");
+	printf("  --serial <sn> USB serial number reported to udev (default EMU0001)\n");
+	printf("  --latency-us <us> Delay every feature report reply\n");
+	printf("  --relock-ms <ms> Drop PLL lock for <ms> after a frequency or loop mode change\n");
+	printf("  --help Show this help\n");
+}
+
+static int write_event(int fd, const struct uhid_event *ev) {
+	ssize_t w = write(fd, ev, sizeof(*ev));
+
+	if (w != (ssize_t)sizeof(*ev)) {
+		perror("uhid write");
+		return -1;
+	}
+	return 0;
+}
+
+static void delay_us(unsigned int us) {
+	struct timespec ts;
+
+	if (!us) return;
+	ts.tv_sec = us / 1000000;
+	ts.tv_nsec = (long)(us % 1000000) * 1000;
+	nanosleep(&ts, NULL);
+}
+
+static int handle_event(int fd, struct lbe_sim *sim, const struct uhid_event *ev, unsigned int latency_us) {
+	struct uhid_event reply;
+
+	memset(&reply, 0, sizeof(reply));
+	lbe_sim_tick(sim, lbe_now_ns());
+	switch (ev->type) {
+	case UHID_GET_REPORT:
+		delay_us(latency_us);
+		reply.type = UHID_GET_REPORT_REPLY;
+		reply.u.get_report_reply.id = ev->u.get_report.id;
+		if (ev->u.get_report.rtype != UHID_FEATURE_REPORT || ev->u.get_report.rnum != 0x4B) {
+			reply.u.get_report_reply.err = EIO;
+		} else {
+			int n = lbe_sim_get_feature(sim, reply.u.get_report_reply.data,
+				sizeof(reply.u.get_report_reply.data));
+			reply.u.get_report_reply.size = (uint16_t)n;
+		}
+		return write_event(fd, &reply);
+	case UHID_SET_REPORT:
+		delay_us(latency_us);
+		reply.type = UHID_SET_REPORT_REPLY;
+		reply.u.set_report_reply.id = ev->u.set_report.id;
+		if (ev->u.set_report.rtype != UHID_FEATURE_REPORT ||
+		    lbe_sim_set_feature(sim, ev->u.set_report.data, ev->u.set_report.size) < 0) {
+			reply.u.set_report_reply.err = EIO;
+		}
+		return write_event(fd, &reply);
+	default:
+		return 0;
+	}
+}
+
+int main(int argc, char *argv[]) {
+	struct lbe_sim sim;
+	struct uhid_event ev;
+	enum lbe_model model = LBE_1421_DUALOUT;
+	const char *serial = "EMU0001";
+	unsigned int latency_us = 0;
+	unsigned int relock_ms = 0;
+	int fd;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--model") == 0 && i + 1 < argc) {
+			model = atoi(argv[++i]) == 1420 ? LBE_1420 : LBE_1421_DUALOUT;
+		} else if (strcmp(argv[i], "--serial") == 0 && i + 1 < argc) {
+			serial = argv[++i];
+		} else if (strcmp(argv[i], "--latency-us") == 0 && i + 1 < argc) {
+			latency_us = (unsigned int)strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--relock-ms") == 0 && i + 1 < argc) {
+			relock_ms = (unsigned int)strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--help") == 0) {
+			print_usage();
+			return 0;
+		} else {
+			fprintf(stderr, "Unknown option: %s\n", argv[i]);
+			print_usage();
+			return 1;
+		}
+	}
+
+	fd = open("/dev/uhid", O_RDWR | O_CLOEXEC);
+	if (fd < 0) {
+		perror("Failed to open /dev/uhid");
+		return 1;
+	}
+
+	lbe_sim_init(&sim, model);
+	sim.relock_ns = (uint64_t)relock_ms * 1000000;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.type = UHID_CREATE2;
+	snprintf((char *)ev.u.create2.name, sizeof(ev.u.create2.name), "LBE-%s emulated",
+		model == LBE_1420 ? "1420" : "1421");
+	snprintf((char *)ev.u.create2.uniq, sizeof(ev.u.create2.uniq), "%s", serial);
+	ev.u.create2.rd_size = sizeof(report_descriptor);
+	ev.u.create2.bus = BUS_USB;
+	ev.u.create2.vendor = VID_LBE;
+	ev.u.create2.product = model == LBE_1420 ? PID_LBE_1420 : PID_LBE_1421;
+	memcpy(ev.u.create2.rd_data, report_descriptor, sizeof(report_descriptor));
+	if (write_event(fd, &ev) < 0) {
+		close(fd);
+		return 1;
+	}
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+	fprintf(stderr, "Emulating LBE-%s (serial %s), Ctrl-C to stop\n", model == LBE_1420 ? "1420" : "1421", serial);
+
+	while (running) {
+		struct pollfd pfd = { .fd = fd, .events = POLLIN };
+		ssize_t r;
+
+		if (poll(&pfd, 1, -1) < 0) {
+			if (errno == EINTR) continue;
+			perror("poll");
+			break;
+		}
+		r = read(fd, &ev, sizeof(ev));
+		if (r < 0) {
+			if (errno == EINTR || errno == EAGAIN) continue;
+			perror("uhid read");
+			break;
+		}
+		if (handle_event(fd, &sim, &ev, latency_us) < 0) break;
+	}
+
+	memset(&ev, 0, sizeof(ev));
+	ev.type = UHID_DESTROY;
+	write_event(fd, &ev);
+	close(fd);
+
+	fprintf(stderr, "%llu GET, %llu SET reports, %llu flash writes\n",
+		(unsigned long long)sim.get_reports, (unsigned long long)sim.set_reports,
+		(unsigned long long)sim.flash_writes);
+	return 0;
+}
+
+#endif // __linux__
@@ -1,8 +1,78 @@
 #include "lbe_device.h"
+#include "lbe_clock.h"
 #include "lbe_common.h"
+#include "lbe_config.h"
+#include "lbe_histogram.h"
+#include "lbe_settle.h"
+#include "lbe_stats.h"
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+#ifdef __linux__
+#include "lbe_cmd.h"
+#include "lbe_events.h"
+#include "lbe_failover.h"
+#include "lbe_fleet.h"
+#include "lbe_ipc.h"
+#include "lbe_metrics.h"
+#include "lbe_monitor.h"
+#include "lbe_poller.h"
+#include "lbe_record.h"
+#include "lbe_schedule.h"
+#include "lbe_shm.h"
+#include "lbe_sweep.h"
+#include <signal.h>
+#include <unistd.h>
+
+#define MONITOR_DEFAULT_RATE 10.0
+#define FAILOVER_DEFAULT_RATE 100.0
+#define FAILOVER_DEFAULT_FAIL 3
+#define FAILOVER_DEFAULT_RECOVER 100
+#define AT_DEFAULT_INTERVAL_MS 1000
+#endif
+
+static double now_ms(void) {
+	return lbe_now_ns() / 1e6;
+}
+
+// Cross-process device lock, from --lock-wait / --no-lock
+static int lock_wait_ms = LBE_LOCK_WAIT_FOREVER;
+static int use_lock = 1;
+
+static int lock_device(struct lbe_device *dev, enum lbe_lock_mode mode) {
+	if (!use_lock) return 0;
+	if (lbe_lock_device(dev, mode, lock_wait_ms) < 0) {
+		fprintf(stderr, "%s is locked by another process\n", lbe_get_path(dev));
+		return -1;
+	}
+	return 0;
+}
+
+/* Only worth a line when another process actually held the device */
+static void print_lock_stats(struct lbe_device *dev) {
+	struct lbe_lock_stats stats;
+
+	lbe_get_lock_stats(dev, &stats);
+	if (stats.contended || stats.timeouts) {
+		fprintf(stderr, "Lock: %llu acquired, %llu after waiting, %llu timed out, "
+			"waited %.3f ms total, %.3f ms max\n",
+			(unsigned long long)stats.acquired, (unsigned long long)stats.contended,
+			(unsigned long long)stats.timeouts, stats.wait_ns / 1e6, stats.max_wait_ns / 1e6);
+	}
+}
+
+/* --stats: one entry per command code the run sent, status reads included */
+static void print_cmd_stats(struct lbe_device *dev) {
+	struct lbe_cmd_stats list[LBE_CMD_STATS_MAX];
+
+	lbe_cmd_stats_print(stderr, list, lbe_get_cmd_stats(dev, list, LBE_CMD_STATS_MAX));
+}
 
 void print_usage(int model) {
 	unsigned long max_freq = LBE_1421_MAX_FREQ;
@@ -24,6 +94,1145 @@ void print_usage(int model) {
 	printf("  --pwr2 <0|1> Set OUT2 power level: normal(0) or low(1) (LBE-1421 only)\n");
 	printf("  --blink Blink output LED(s) for 3 seconds\n");
 	printf("  --status Display current device status\n");
+	printf("  --apply <file> Apply a config file, sending only the settings that differ\n");
+	printf("  --timing Print device open, command and total run time to stderr\n");
+	printf("  --stats Print per-command report counts, errors and latency to stderr\n");
+	printf("  --lock-wait <ms> Give up when another process holds the device longer (default: wait)\n");
+	printf("  --no-lock Do not take the cross-process device lock\n");
+	printf("  --wait-lock After each frequency change, wait until it reads back and the PLL is locked\n");
+	printf("  --wait-timeout <ms> Give up waiting after <ms> (default %d)\n", LBE_SETTLE_DEFAULT_TIMEOUT_MS);
+	printf("  --settle-stats <n> Cycle through the --f1t/--f2t values n times and print the\n");
+	printf("                     distribution of settle times\n");
+#ifdef __linux__
+	printf("  --batch <file|-> Run one command per line (f1t 10000000, status, sleep <ms>,\n");
+	printf("                   sleep-until <ms from start>, ...) on one open device\n");
+	printf("  --socket <path> Send the other options to a running lbe142xd instead of opening the device\n");
+	printf("  --list List all connected LBE-142x units\n");
+	printf("  --device <sel> Apply the other options to the selected units in parallel\n");
+	printf("                 (all, serial:<sn>, path:<node>, usb:<port>, comma separated)\n");
+	printf("  --workers <n> Worker threads (or reports in flight) for --device (default: one per unit)\n");
+	printf("  --monitor <hz> Stream status samples at <hz> until interrupted\n");
+	printf("  --count <n> Stop --monitor after <n> samples\n");
+	printf("  --binary Write --monitor samples as fixed size binary records\n");
+	printf("  --events Only report --monitor status transitions (lock, antenna, outputs, frequency...)\n");
+	printf("  --publish <name> Publish status to shared memory page <name> (e.g. %s)\n", LBE_SHM_DEFAULT_NAME);
+	printf("                   instead of printing samples, polling at the --monitor rate (default %g Hz)\n", MONITOR_DEFAULT_RATE);
+	printf("  --record <file> Append raw status reports to a compressed recording instead of printing\n");
+	printf("                  samples (read it back with lbe-142x-replay)\n");
+	printf("  --sweep <start:stop:step:dwell_ms> Step a temporary frequency on a fixed schedule\n");
+	printf("  --hop-list <file> Hop through \"<freq> [dwell_ms]\" lines on a fixed schedule\n");
+	printf("  --hop-out <1|2> Output used by --sweep/--hop-list (default 1)\n");
+	printf("  --loops <n> Repeat the sweep/hop list or plan n times, 0 = until interrupted (default 1)\n");
+	printf("  --write-plan <file> Encode the --sweep/--hop-list hops into a plan file instead of running them\n");
+	printf("  --plan-model <1420|1421> Model --write-plan encodes for (default: the connected unit)\n");
+	printf("  --plan <file> Play back a plan file on the --sweep schedule\n");
+	printf("  --failover <primary>,<standby> Keep outputs enabled on exactly one locked unit\n");
+	printf("  --poll-hz <hz> --failover status poll rate per unit (default %g)\n", FAILOVER_DEFAULT_RATE);
+	printf("  --fail-samples <n> Bad polls in a row before switching away (default %d)\n", FAILOVER_DEFAULT_FAIL);
+	printf("  --recover-samples <n> Good polls in a row before a unit is used again (default %d)\n", FAILOVER_DEFAULT_RECOVER);
+	printf("  --revert Move back to the primary once it has recovered\n");
+	printf("  --adaptive-poll <min_hz>:<max_hz> Poll the --device units (default: the first one),\n");
+	printf("                  backing off to min_hz while stable and back to max_hz on a change;\n");
+	printf("                  prints changes only, SIGUSR1 forces max_hz (e.g. before a command)\n");
+	printf("  --at <time> Send the --f1t, --f2t or --out command at a UTC instant\n");
+	printf("              (YYYY-MM-DDTHH:MM:SS[.frac][Z], @<epoch s> or +<s from now>)\n");
+	printf("  --at-repeat <n> Send it n times, --at-interval apart, and print an issue error histogram\n");
+	printf("  --at-interval <ms> Time between --at-repeat sends (default %d)\n", AT_DEFAULT_INTERVAL_MS);
+	printf("  --rt-prio <1-99> Run --at under SCHED_FIFO at this priority\n");
+	printf("  --cpu <n> Pin --at to CPU n\n");
+	printf("  --spin-us <us> Busy-wait the last <us> before an --at send (default %d)\n", LBE_SCHEDULE_DEFAULT_SPIN_US);
+	printf("  --no-mlock Do not lock memory for --at\n");
+	printf("  --metrics <host:port> Serve Prometheus metrics for the --device units on /metrics\n");
+	printf("                        (e.g. %s), polling at the --adaptive-poll rates (default %g:%g)\n",
+		LBE_METRICS_DEFAULT_LISTEN, LBE_METRICS_DEFAULT_MIN_HZ, LBE_METRICS_DEFAULT_MAX_HZ);
+#endif
+}
+
+#ifdef __linux__
+static volatile sig_atomic_t stop_requested;
+
+static void on_stop_signal(int sig) {
+	(void)sig;
+	stop_requested = 1;
+}
+
+/* Without SA_RESTART so blocking waits return EINTR and notice the stop flag */
+static void install_stop_handler(void) {
+	struct sigaction sa;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = on_stop_signal;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	signal(SIGPIPE, SIG_IGN);
+}
+
+struct mode_option {
+	const char *name;
+	int has_arg;
+};
+
+/* Options that select how lbe-142x runs rather than commands for the device */
+static const struct mode_option mode_options[] = {
+	{ "--batch", 1 },
+	{ "--socket", 1 },
+	{ "--device", 1 },
+	{ "--workers", 1 },
+	{ "--list", 0 },
+	{ "--apply", 1 },
+	{ "--monitor", 1 },
+	{ "--count", 1 },
+	{ "--binary", 0 },
+	{ "--events", 0 },
+	{ "--publish", 1 },
+	{ "--record", 1 },
+	{ "--sweep", 1 },
+	{ "--hop-list", 1 },
+	{ "--hop-out", 1 },
+	{ "--loops", 1 },
+	{ "--write-plan", 1 },
+	{ "--plan-model", 1 },
+	{ "--plan", 1 },
+	{ "--timing", 0 },
+	{ "--stats", 0 },
+	{ "--lock-wait", 1 },
+	{ "--no-lock", 0 },
+	{ "--wait-lock", 0 },
+	{ "--wait-timeout", 1 },
+	{ "--settle-stats", 1 },
+	{ "--failover", 1 },
+	{ "--poll-hz", 1 },
+	{ "--fail-samples", 1 },
+	{ "--recover-samples", 1 },
+	{ "--revert", 0 },
+	{ "--adaptive-poll", 1 },
+	{ "--metrics", 1 },
+	{ "--at", 1 },
+	{ "--at-repeat", 1 },
+	{ "--at-interval", 1 },
+	{ "--rt-prio", 1 },
+	{ "--cpu", 1 },
+	{ "--spin-us", 1 },
+	{ "--no-mlock", 0 },
+	{ NULL, 0 }
+};
+
+/* Turn the option at argv[*i] into a protocol line ("--f1 100" -> "f1 100").
+ * Returns 1 with a line, 0 for a mode option and -1 on a stray argument. */
+static int option_to_line(int argc, char *argv[], int *i, char *line, size_t len) {
+	const char *arg = argv[*i];
+
+	for (const struct mode_option *opt = mode_options; opt->name; opt++) {
+		if (strcmp(arg, opt->name) == 0) {
+			*i += opt->has_arg;
+			return 0;
+		}
+	}
+	if (strncmp(arg, "--", 2) != 0) {
+		fprintf(stderr, "Unexpected argument: %s\n", arg);
+		return -1;
+	}
+	if (*i + 1 < argc && strncmp(argv[*i + 1], "--", 2) != 0) {
+		snprintf(line, len, "%s %s", arg + 2, argv[++*i]);
+	} else {
+		snprintf(line, len, "%s", arg + 2);
+	}
+	return 1;
+}
+
+/* Thin client mode: each option becomes one request line for lbe142xd */
+static int run_client(const char *socket_path, int argc, char *argv[]) {
+	char line[LBE_CMD_LINE_MAX];
+	char reply[LBE_CMD_LINE_MAX];
+	int failed = 0;
+	int fd;
+
+	fd = lbe_ipc_connect(socket_path);
+	if (fd < 0) {
+		return 1;
+	}
+
+	for (int i = 1; i < argc; i++) {
+		int res = option_to_line(argc, argv, &i, line, sizeof(line));
+
+		if (res <= 0) {
+			if (res < 0) failed = 1;
+			continue;
+		}
+		if (lbe_ipc_request(fd, line, reply, sizeof(reply)) < 0) {
+			failed = 1;
+			break;
+		}
+		printf("%s: %s\n", line, reply);
+		if (strncmp(reply, "OK", 2) != 0) {
+			failed = 1;
+		}
+	}
+
+	close(fd);
+	return failed;
+}
+
+static uint64_t mono_ms(void) {
+	return lbe_now_ns() / 1000000;
+}
+
+/* Sleep until deadline_ms on CLOCK_MONOTONIC, returns -1 if interrupted by a stop request */
+static int sleep_until_ms(uint64_t deadline_ms) {
+	struct timespec ts;
+
+	ts.tv_sec = (time_t)(deadline_ms / 1000);
+	ts.tv_nsec = (long)(deadline_ms % 1000) * 1000000;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0) {
+		if (stop_requested) return -1;
+	}
+	return 0;
+}
+
+/* Batch commands handled here rather than by the device protocol.
+ * Returns 1 if line was one of them, with the reply filled in. */
+static int batch_builtin(const char *line, uint64_t start_ms, char *reply, size_t len) {
+	unsigned long long ms;
+	char *end;
+	int until;
+
+	if (strncmp(line, "sleep-until ", 12) == 0) {
+		until = 1;
+		line += 12;
+	} else if (strncmp(line, "sleep ", 6) == 0) {
+		until = 0;
+		line += 6;
+	} else {
+		return 0;
+	}
+
+	ms = strtoull(line, &end, 10);
+	if (end == line || *end != '\0') {
+		snprintf(reply, len, "ERR invalid command");
+	} else if (sleep_until_ms(until ? start_ms + ms : mono_ms() + ms) < 0) {
+		snprintf(reply, len, "ERR interrupted");
+	} else {
+		snprintf(reply, len, "OK");
+	}
+	return 1;
+}
+
+/* Batch mode: one device open for the whole script. Every non-empty,
+ * non-comment line gets one "<line no> <ms since start> OK|ERR ..." result. */
+static int run_batch(const char *path) {
+	char line[LBE_CMD_LINE_MAX + 2];
+	char reply[LBE_CMD_LINE_MAX];
+	struct lbe_device *dev;
+	FILE *in = stdin;
+	unsigned long lineno = 0;
+	uint64_t start_ms;
+	int failed = 0;
+
+	if (strcmp(path, "-") != 0) {
+		in = fopen(path, "r");
+		if (!in) {
+			perror(path);
+			return 1;
+		}
+	}
+
+	dev = lbe_open_device();
+	if (!dev) {
+		fprintf(stderr, "Failed to open LBE-142x device\n");
+		if (in != stdin) fclose(in);
+		return 1;
+	}
+	// The whole script is one sequence, keep other processes out until it ends
+	if (lock_device(dev, LBE_LOCK_EXCLUSIVE) < 0) {
+		lbe_close_device(dev);
+		if (in != stdin) fclose(in);
+		return 1;
+	}
+
+	install_stop_handler();
+	start_ms = mono_ms();
+	while (!stop_requested && fgets(line, sizeof(line), in)) {
+		size_t n = strlen(line);
+		char *p = line;
+
+		lineno++;
+		if (n && line[n - 1] != '\n' && !feof(in)) {
+			int c;
+
+			// Drop the rest of an overlong line so it is reported once
+			while ((c = fgetc(in)) != EOF && c != '\n') {
+			}
+			snprintf(reply, sizeof(reply), "ERR line too long");
+		} else {
+			while (n && (line[n - 1] == '\n' || line[n - 1] == '\r' || line[n - 1] == ' ' || line[n - 1] == '\t')) {
+				line[--n] = '\0';
+			}
+			while (*p == ' ' || *p == '\t') p++;
+			if (!*p || *p == '#') continue;
+
+			if (!batch_builtin(p, start_ms, reply, sizeof(reply))) {
+				lbe_cmd_run_line(dev, p, reply, sizeof(reply));
+			}
+		}
+
+		printf("%lu %" PRIu64 " %s\n", lineno, mono_ms() - start_ms, reply);
+		fflush(stdout);
+		if (strncmp(reply, "OK", 2) != 0) {
+			failed = 1;
+		}
+	}
+
+	print_lock_stats(dev);
+	lbe_close_device(dev);
+	if (in != stdin) fclose(in);
+	return failed || stop_requested;
+}
+
+static int run_list(void) {
+	struct lbe_device_info infos[LBE_FLEET_MAX_DEVICES];
+	int count = lbe_enumerate_devices(infos, LBE_FLEET_MAX_DEVICES);
+
+	if (count < 0) {
+		return 1;
+	}
+	printf("%-16s %-12s %-20s %s\n", "PATH", "USB", "SERIAL", "MODEL");
+	for (int i = 0; i < count; i++) {
+		printf("%-16s %-12s %-20s LBE-%s\n", infos[i].path, infos[i].usb_path,
+			infos[i].serial[0] ? infos[i].serial : "-",
+			infos[i].model == LBE_1420 ? "1420" : "1421");
+	}
+	return 0;
+}
+
+struct fleet_work {
+	const struct lbe_config *config; // applied before the commands when set
+	const struct lbe_cmd *cmds;
+	int ncmds;
+};
+
+static int fleet_job(struct lbe_device* dev, void *arg, struct lbe_fleet_result *result) {
+	const struct fleet_work *work = arg;
+
+	if (lock_device(dev, LBE_LOCK_EXCLUSIVE) < 0) {
+		return -1;
+	}
+	if (work->config) {
+		int sent = lbe_apply_config(dev, work->config);
+
+		if (sent < 0) {
+			result->commands_failed++;
+			return -1;
+		}
+		result->commands_ok += sent;
+	}
+	return lbe_fleet_exec_commands(dev, work->cmds, work->ncmds, result);
+}
+
+/* Fleet mode: run the command options on every selected unit in parallel */
+static int run_fleet(const char *selector, int workers, const char *apply_path, int argc, char *argv[]) {
+	struct lbe_device_info all[LBE_FLEET_MAX_DEVICES];
+	struct lbe_device_info selected[LBE_FLEET_MAX_DEVICES];
+	struct lbe_fleet_result results[LBE_FLEET_MAX_DEVICES];
+	struct lbe_cmd cmds[64];
+	char line[LBE_CMD_LINE_MAX];
+	char status_line[LBE_CMD_LINE_MAX];
+	struct lbe_config config;
+	struct fleet_work work;
+	enum lbe_lock_mode lock_mode = LBE_LOCK_SHARED;
+	int ncmds = 0;
+	int count, failed;
+
+	for (int i = 1; i < argc; i++) {
+		int res = option_to_line(argc, argv, &i, line, sizeof(line));
+
+		if (res == 0) continue;
+		if (res < 0) {
+			return 1;
+		}
+		if (ncmds == (int)(sizeof(cmds) / sizeof(cmds[0]))) {
+			fprintf(stderr, "Too many commands\n");
+			return 1;
+		}
+		if (lbe_cmd_parse(line, &cmds[ncmds]) < 0) {
+			fprintf(stderr, "Invalid command: %s\n", line);
+			return 1;
+		}
+		ncmds++;
+	}
+
+	if (apply_path && lbe_config_load(apply_path, &config) < 0) {
+		return 1;
+	}
+	work.config = apply_path ? &config : NULL;
+	work.cmds = cmds;
+	work.ncmds = ncmds;
+
+	count = lbe_enumerate_devices(all, LBE_FLEET_MAX_DEVICES);
+	if (count < 0) {
+		return 1;
+	}
+	count = lbe_select_devices(selector, all, count, selected, LBE_FLEET_MAX_DEVICES);
+	if (count <= 0) {
+		fprintf(stderr, "No LBE-142x device selected\n");
+		return 1;
+	}
+
+	// Plain command lists go through the async engine, workers then caps reports in flight
+	if (work.config) {
+		failed = lbe_fleet_run(selected, count, workers, fleet_job, &work, results);
+	} else {
+		// Status only runs may share the units, anything else is a command sequence
+		for (int i = 0; i < ncmds; i++) {
+			if (cmds[i].op != LBE_CMD_STATUS) lock_mode = LBE_LOCK_EXCLUSIVE;
+		}
+		failed = lbe_fleet_run_commands(selected, count, workers, cmds, ncmds,
+			use_lock ? lock_mode : LBE_LOCK_UNLOCKED, lock_wait_ms, results);
+	}
+
+	printf("%-16s %-12s %-20s %-6s %-6s %4s %4s %9s\n",
+		"PATH", "USB", "SERIAL", "MODEL", "RESULT", "OK", "FAIL", "TIME(ms)");
+	for (int i = 0; i < count; i++) {
+		const struct lbe_fleet_result *r = &results[i];
+
+		printf("%-16s %-12s %-20s %-6s %-6s %4d %4d %9.1f\n", r->info.path, r->info.usb_path,
+			r->info.serial[0] ? r->info.serial : "-",
+			r->info.model == LBE_1420 ? "1420" : "1421",
+			r->result == 0 ? "OK" : "FAIL", r->commands_ok, r->commands_failed, r->elapsed_ms);
+	}
+	for (int i = 0; i < count; i++) {
+		if (!results[i].have_status) continue;
+		lbe_cmd_format_status(&results[i].status, status_line, sizeof(status_line));
+		printf("%s %s\n", results[i].info.path, status_line);
+	}
+	return failed ? 1 : 0;
+}
+
+struct monitor_output {
+	int binary;
+	int events;
+	struct lbe_shm_publisher *shm; // samples go to shared memory instead of stdout
+	struct lbe_recorder *recorder; // samples go to a recording instead of stdout
+	uint64_t real_ns; // wall clock of the sample being processed
+	struct lbe_event_tracker tracker;
+};
+
+static void print_event(const struct lbe_event *event, void *arg) {
+	const struct monitor_output *out = arg;
+
+	printf("%" PRIu64 " %" PRIu64 " %s", event->timestamp_ns, out->real_ns, lbe_event_name(event->type));
+	if (event->output) {
+		printf(" out=%d", event->output);
+	}
+	printf(" old=%u new=%u prior_ms=%.3f\n", event->old_value, event->new_value,
+		event->prior_duration_ns / 1e6);
+}
+
+static int write_sample(const struct lbe_sample *sample, void *arg) {
+	struct monitor_output *out = arg;
+
+	if (out->shm) {
+		lbe_shm_publish(out->shm, sample);
+	}
+	if (out->recorder) {
+		struct lbe_rec_sample rec;
+
+		rec.mono_ns = sample->mono_ns;
+		rec.real_ns = sample->real_ns;
+		memcpy(rec.report, sample->report, sizeof(rec.report));
+		lbe_recorder_push(out->recorder, &rec);
+	}
+	if (out->events) {
+		out->real_ns = sample->real_ns;
+		if (lbe_events_update(&out->tracker, &sample->status, sample->mono_ns, print_event, out) > 0) {
+			fflush(stdout);
+		}
+	} else if (out->shm || out->recorder) {
+		return 0;
+	} else if (out->binary) {
+		struct lbe_sample_record record;
+
+		lbe_sample_to_record(sample, &record);
+		fwrite(&record, sizeof(record), 1, stdout);
+	} else {
+		lbe_sample_print(stdout, sample);
+	}
+	// Stop once the consumer goes away
+	return ferror(stdout) ? 1 : 0;
+}
+
+/* Monitor mode: all diagnostics go to stderr, stdout only carries samples */
+static int run_monitor(double rate_hz, uint64_t count, int binary, int events, const char *publish,
+		const char *record) {
+	struct lbe_monitor_opts opts = { rate_hz, count, &stop_requested, use_lock, lock_wait_ms };
+	struct lbe_monitor_stats stats;
+	struct lbe_recorder_stats rec_stats;
+	struct monitor_output out;
+	struct lbe_device *dev;
+	int res;
+
+	dev = lbe_open_device();
+	if (!dev) {
+		fprintf(stderr, "Failed to open LBE-142x device\n");
+		return 1;
+	}
+	fprintf(stderr, "Monitoring LBE-%s at %g Hz\n", lbe_get_model(dev) == LBE_1420 ? "1420" : "1421", rate_hz);
+
+	out.binary = binary;
+	out.events = events;
+	out.shm = NULL;
+	out.recorder = NULL;
+	lbe_events_init(&out.tracker, LBE_EVENT_MASK_ALL);
+	if (publish) {
+		out.shm = lbe_shm_publisher_new(publish, lbe_get_model(dev), (uint64_t)(1e9 / rate_hz));
+		if (!out.shm) {
+			lbe_close_device(dev);
+			return 1;
+		}
+		fprintf(stderr, "Publishing status to shared memory %s\n", publish);
+	}
+	if (record) {
+		out.recorder = lbe_recorder_start(record, lbe_get_model(dev), LBE_RECORDER_DEFAULT_RING);
+		if (!out.recorder) {
+			lbe_shm_publisher_free(out.shm);
+			lbe_close_device(dev);
+			return 1;
+		}
+		fprintf(stderr, "Recording status to %s\n", record);
+	}
+
+	install_stop_handler();
+	res = lbe_monitor_run(dev, &opts, write_sample, &out, &stats);
+	fflush(stdout);
+	lbe_shm_publisher_free(out.shm);
+	print_lock_stats(dev);
+	lbe_close_device(dev);
+
+	fprintf(stderr, "%" PRIu64 " samples in %.3f s (%.1f Hz achieved, %g Hz requested), "
+		"%" PRIu64 " missed ticks, %" PRIu64 " errors\n",
+		stats.samples, stats.elapsed_s, stats.achieved_hz, rate_hz, stats.missed_ticks, stats.errors);
+	if (stats.lock_timeouts) {
+		fprintf(stderr, "%" PRIu64 " ticks skipped while another process held the device\n", stats.lock_timeouts);
+	}
+	if (out.recorder) {
+		if (lbe_recorder_stop(out.recorder, &rec_stats) < 0) res = -1;
+		fprintf(stderr, "%" PRIu64 " samples recorded in %" PRIu64 " bytes, %" PRIu64 " dropped%s\n",
+			rec_stats.samples, rec_stats.bytes, rec_stats.overruns,
+			rec_stats.write_error ? ", write error" : "");
+	}
+	return res < 0 ? 1 : 0;
+}
+
+static uint64_t real_ns(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void print_switch(const struct lbe_failover_switch *sw, void *arg) {
+	const struct lbe_device_info *units = arg;
+	const char *reason;
+
+	if (sw->from == sw->to) {
+		printf("%" PRIu64 " active %s raw=0x%02X\n", real_ns(), units[sw->to].path, sw->raw_status);
+		fflush(stdout);
+		return;
+	}
+	if (sw->reverted) {
+		reason = "revert";
+	} else if (sw->read_failed) {
+		reason = "read-failed";
+	} else if (!(sw->raw_status & LBE_GPS_LOCK_BIT)) {
+		reason = "gps-lost";
+	} else {
+		reason = "pll-lost";
+	}
+	printf("%" PRIu64 " switch %s -> %s reason=%s raw=0x%02X detect_to_switch_ms=%.3f "
+		"decide_to_switch_ms=%.3f errors=%d\n",
+		real_ns(), units[sw->from].path, units[sw->to].path, reason, sw->raw_status,
+		(sw->switched_ns - sw->detect_ns) / 1e6, (sw->switched_ns - sw->decide_ns) / 1e6, sw->errors);
+	fflush(stdout);
+}
+
+/* Failover mode: "<primary>,<standby>", each side a --device selector term
+ * that must match exactly one unit */
+static int run_failover(const char *pair, const struct lbe_failover_opts *opts) {
+	struct lbe_device_info all[LBE_FLEET_MAX_DEVICES];
+	struct lbe_device_info units[2];
+	struct lbe_device *devs[2];
+	struct lbe_failover_stats stats;
+	char selectors[2][128];
+	const char *comma = strchr(pair, ',');
+	int count, res;
+
+	if (!comma || comma == pair || !comma[1] || strchr(comma + 1, ',') ||
+	    (size_t)(comma - pair) >= sizeof(selectors[0]) || strlen(comma + 1) >= sizeof(selectors[1])) {
+		fprintf(stderr, "Invalid failover pair: %s (expected <primary>,<standby>)\n", pair);
+		return 1;
+	}
+	snprintf(selectors[0], sizeof(selectors[0]), "%.*s", (int)(comma - pair), pair);
+	snprintf(selectors[1], sizeof(selectors[1]), "%s", comma + 1);
+
+	count = lbe_enumerate_devices(all, LBE_FLEET_MAX_DEVICES);
+	if (count < 0) {
+		return 1;
+	}
+	for (int i = 0; i < 2; i++) {
+		struct lbe_device_info match[2];
+
+		res = lbe_select_devices(selectors[i], all, count, match, 2);
+		if (res != 1) {
+			if (res > 1) fprintf(stderr, "'%s' matches more than one unit\n", selectors[i]);
+			return 1;
+		}
+		units[i] = match[0];
+	}
+	if (strcmp(units[0].path, units[1].path) == 0) {
+		fprintf(stderr, "Primary and standby are the same unit\n");
+		return 1;
+	}
+
+	devs[0] = lbe_open_device_path(units[0].path);
+	devs[1] = devs[0] ? lbe_open_device_path(units[1].path) : NULL;
+	if (!devs[1]) {
+		lbe_close_device(devs[0]);
+		return 1;
+	}
+
+	fprintf(stderr, "Supervising primary %s and standby %s at %g Hz, switching after %u bad polls\n",
+		units[0].path, units[1].path, opts->rate_hz, opts->fail_samples);
+	install_stop_handler();
+	res = lbe_failover_run(devs, opts, print_switch, units, &stats);
+	lbe_close_device(devs[0]);
+	lbe_close_device(devs[1]);
+
+	printf("%" PRIu64 " polls in %.3f s, %" PRIu64 " read errors, %" PRIu64 " switches (%" PRIu64
+		" report errors), %" PRIu64 " late polls\n",
+		stats.polls, stats.elapsed_s, stats.read_errors, stats.switches, stats.switch_errors,
+		stats.deadline_misses);
+	if (stats.detect_to_switch.count) {
+		lbe_histogram_print(stdout, "detect->switch", &stats.detect_to_switch);
+	}
+	if (stats.decide_to_switch.count) {
+		lbe_histogram_print(stdout, "decide->switch", &stats.decide_to_switch);
+	}
+	return res < 0 ? 1 : 0;
+}
+
+struct poll_output {
+	const char *paths[LBE_POLLER_MAX_DEVICES];
+};
+
+static struct lbe_poller *kick_poller;
+
+static void on_kick_signal(int sig) {
+	(void)sig;
+	if (kick_poller) lbe_poller_kick(kick_poller, -1);
+}
+
+/* The first poll of each unit and every change after it, tagged with the unit */
+static int print_poll(const struct lbe_poller_sample *sample, void *arg) {
+	const struct poll_output *out = arg;
+	const struct lbe_status *st = &sample->status;
+
+	if (sample->failed || (!sample->changed && sample->interval_ns)) return 0;
+	printf("%" PRIu64 " %" PRIu64 " %s 0x%02X %u %u %d %d %d since_last_ms=%.3f\n",
+		sample->mono_ns, sample->real_ns, out->paths[sample->index], st->raw_status,
+		st->frequency1, st->frequency2, st->fll_enabled, st->out1_power_low, st->out2_power_low,
+		sample->interval_ns / 1e6);
+	fflush(stdout);
+	return ferror(stdout) ? 1 : 0;
+}
+
+/* The --device units, or the first unit found without --device. Returns
+ * the number opened, -1 with nothing left open on failure. */
+static int open_units(const char *selector, struct lbe_device **devs) {
+	struct lbe_device_info all[LBE_FLEET_MAX_DEVICES];
+	struct lbe_device_info selected[LBE_FLEET_MAX_DEVICES];
+	int count;
+
+	if (!selector) {
+		devs[0] = lbe_open_device();
+		if (!devs[0]) {
+			fprintf(stderr, "Failed to open LBE-142x device\n");
+			return -1;
+		}
+		return 1;
+	}
+	count = lbe_enumerate_devices(all, LBE_FLEET_MAX_DEVICES);
+	if (count < 0) return -1;
+	count = lbe_select_devices(selector, all, count, selected, LBE_FLEET_MAX_DEVICES);
+	if (count <= 0) {
+		fprintf(stderr, "No LBE-142x device selected\n");
+		return -1;
+	}
+	for (int i = 0; i < count; i++) {
+		devs[i] = lbe_open_device_path(selected[i].path);
+		if (!devs[i]) {
+			while (i--) lbe_close_device(devs[i]);
+			return -1;
+		}
+	}
+	return count;
+}
+
+static void close_units(struct lbe_device **devs, int count) {
+	for (int i = 0; i < count; i++) {
+		print_lock_stats(devs[i]);
+		lbe_close_device(devs[i]);
+	}
+}
+
+/* "<min_hz>:<max_hz>" */
+static int parse_poll_rates(const char *spec, struct lbe_poller_opts *opts) {
+	if (sscanf(spec, "%lf:%lf", &opts->min_hz, &opts->max_hz) != 2 || opts->min_hz <= 0 ||
+	    opts->max_hz < opts->min_hz || opts->max_hz > LBE_MONITOR_MAX_RATE) {
+		fprintf(stderr, "Invalid adaptive poll rates: %s (expected <min_hz>:<max_hz>)\n", spec);
+		return -1;
+	}
+	return 0;
+}
+
+/* Adaptive poll mode: "<min_hz>:<max_hz>" over the --device units */
+static int run_adaptive_poll(const char *spec, const char *selector) {
+	struct lbe_device *devs[LBE_POLLER_MAX_DEVICES];
+	struct lbe_poller_opts opts = {
+		0, 0, LBE_POLLER_DEFAULT_BACKOFF, &stop_requested, use_lock, lock_wait_ms
+	};
+	struct poll_output out;
+	struct lbe_poller *poller;
+	int count, res;
+
+	if (parse_poll_rates(spec, &opts) < 0) return 1;
+	count = open_units(selector, devs);
+	if (count < 0) return 1;
+	for (int i = 0; i < count; i++) {
+		out.paths[i] = lbe_get_path(devs[i]);
+	}
+
+	poller = lbe_poller_new(devs, count, &opts);
+	if (!poller) {
+		close_units(devs, count);
+		return 1;
+	}
+	fprintf(stderr, "Polling %d unit(s) at %g-%g Hz\n", count, opts.min_hz, opts.max_hz);
+	install_stop_handler();
+	kick_poller = poller;
+	signal(SIGUSR1, on_kick_signal);
+	res = lbe_poller_run(poller, print_poll, &out) < 0 ? 1 : 0;
+	signal(SIGUSR1, SIG_DFL);
+	kick_poller = NULL;
+
+	for (int i = 0; i < count; i++) {
+		const struct lbe_poller_stats *st = lbe_poller_get_stats(poller, i);
+
+		fprintf(stderr, "%s: %" PRIu64 " polls (%.2f Hz achieved, now every %.1f ms), %" PRIu64
+			" changes, %" PRIu64 " errors, %" PRIu64 " kicks\n",
+			out.paths[i], st->polls, st->achieved_hz, st->interval_ns / 1e6, st->changes,
+			st->errors, st->kicks);
+		if (st->lock_timeouts) {
+			fprintf(stderr, "%s: %" PRIu64 " polls skipped while another process held the device\n",
+				out.paths[i], st->lock_timeouts);
+		}
+		if (st->detect_ns.count) {
+			lbe_histogram_print(stderr, "detect latency bound", &st->detect_ns);
+		}
+	}
+	lbe_poller_free(poller);
+	close_units(devs, count);
+	return res;
+}
+
+/* Exporter mode: serve /metrics on address, polling the --device units in
+ * the background at the --adaptive-poll rates */
+static int run_metrics(const char *address, const char *rates, const char *selector) {
+	struct lbe_device *devs[LBE_POLLER_MAX_DEVICES];
+	struct lbe_metrics_opts opts = {
+		address,
+		{ LBE_METRICS_DEFAULT_MIN_HZ, LBE_METRICS_DEFAULT_MAX_HZ, LBE_POLLER_DEFAULT_BACKOFF,
+		  &stop_requested, use_lock, lock_wait_ms }
+	};
+	struct lbe_metrics *metrics;
+	int count, res;
+
+	if (rates && parse_poll_rates(rates, &opts.poll) < 0) return 1;
+	count = open_units(selector, devs);
+	if (count < 0) return 1;
+
+	metrics = lbe_metrics_new(devs, count, &opts);
+	if (!metrics) {
+		close_units(devs, count);
+		return 1;
+	}
+	fprintf(stderr, "Serving metrics for %d unit(s) on http://%s/metrics, polling at %g-%g Hz\n",
+		count, address, opts.poll.min_hz, opts.poll.max_hz);
+	install_stop_handler();
+	res = lbe_metrics_run(metrics);
+	lbe_metrics_free(metrics);
+	close_units(devs, count);
+	return res < 0 ? 1 : 0;
+}
+
+/* Builds the --sweep or --hop-list hops, the caller frees *hops */
+static int load_hops(const char *spec, const char *hop_list, struct lbe_hop **hops, uint32_t *count) {
+	if (spec) {
+		unsigned long start, stop, step;
+		double dwell_ms;
+
+		if (sscanf(spec, "%lu:%lu:%lu:%lf", &start, &stop, &step, &dwell_ms) != 4 ||
+		    start == 0 || stop == 0 || start > 0xFFFFFFFFUL || stop > 0xFFFFFFFFUL ||
+		    step > 0xFFFFFFFFUL || !(dwell_ms >= 0 && dwell_ms * 1000.0 <= 0xFFFFFFFFUL)) {
+			fprintf(stderr, "Invalid sweep: %s (expected start:stop:step:dwell_ms)\n", spec);
+			return -1;
+		}
+		return lbe_sweep_build((uint32_t)start, (uint32_t)stop, (uint32_t)step,
+			(uint32_t)(dwell_ms * 1000.0), hops, count);
+	}
+	return lbe_hop_list_load(hop_list, 0, hops, count);
+}
+
+static void print_sweep_stats(const struct lbe_sweep_stats *stats) {
+	printf("%" PRIu64 " hops in %.3f s (%.1f hops/s), %" PRIu64 " deadline misses, %" PRIu64 " errors\n",
+		stats->hops, stats->elapsed_s, stats->hop_rate, stats->deadline_misses, stats->errors);
+	printf("Report latency: min %.1f us, avg %.1f us, max %.1f us; worst lateness %.1f us\n",
+		stats->latency_min_ns / 1e3, stats->hops ? stats->latency_sum_ns / 1e3 / stats->hops : 0.0,
+		stats->latency_max_ns / 1e3, stats->lateness_max_ns / 1e3);
+}
+
+/* Sweep/hop mode: hops are built up front so the loop only does I/O */
+static int run_sweep(const char *spec, const char *hop_list, int output, uint32_t loops) {
+	struct lbe_sweep_stats stats;
+	struct lbe_hop *hops = NULL;
+	struct lbe_device *dev;
+	unsigned long max_freq;
+	uint32_t count;
+	int res;
+
+	if (load_hops(spec, hop_list, &hops, &count) < 0) {
+		return 1;
+	}
+
+	dev = lbe_open_device();
+	if (!dev) {
+		fprintf(stderr, "Failed to open LBE-142x device\n");
+		free(hops);
+		return 1;
+	}
+	if (output == 2 && lbe_get_model(dev) == LBE_1420) {
+		fprintf(stderr, "LBE-1420 does not support output 2\n");
+		lbe_close_device(dev);
+		free(hops);
+		return 1;
+	}
+
+	max_freq = lbe_get_model(dev) == LBE_1420 ? LBE_1420_MAX_FREQ : LBE_1421_MAX_FREQ;
+	for (uint32_t i = 0; i < count; i++) {
+		if (hops[i].frequency < 1 || hops[i].frequency > max_freq) {
+			fprintf(stderr, "Invalid frequency: %u (range: 1-%lu Hz)\n", hops[i].frequency, max_freq);
+			lbe_close_device(dev);
+			free(hops);
+			return 1;
+		}
+	}
+
+	install_stop_handler();
+	if (lock_device(dev, LBE_LOCK_EXCLUSIVE) < 0) {
+		lbe_close_device(dev);
+		free(hops);
+		return 1;
+	}
+	print_lock_stats(dev);
+
+	printf("Hopping OUT%d through %u frequencies\n", output, count);
+	res = lbe_sweep_run(dev, output, hops, count, loops, &stop_requested, &stats);
+	lbe_close_device(dev);
+	free(hops);
+
+	print_sweep_stats(&stats);
+	return res < 0 ? 1 : 0;
+}
+
+/* Encodes the --sweep or --hop-list hops into a plan file for --plan. Without
+ * --plan-model the connected unit decides the report layout. */
+static int run_write_plan(const char *path, const char *spec, const char *hop_list, int output,
+		const char *model_name) {
+	struct lbe_hop *hops = NULL;
+	enum lbe_model model;
+	uint32_t count;
+	int res;
+
+	if (model_name) {
+		if (strcmp(model_name, "1420") == 0) {
+			model = LBE_1420;
+		} else if (strcmp(model_name, "1421") == 0) {
+			model = LBE_1421_DUALOUT;
+		} else {
+			fprintf(stderr, "Invalid plan model: %s (expected 1420 or 1421)\n", model_name);
+			return 1;
+		}
+	} else {
+		struct lbe_device *dev = lbe_open_device();
+
+		if (!dev) {
+			fprintf(stderr, "Failed to open LBE-142x device, use --plan-model to build without one\n");
+			return 1;
+		}
+		model = lbe_get_model(dev);
+		lbe_close_device(dev);
+	}
+
+	if (load_hops(spec, hop_list, &hops, &count) < 0) {
+		return 1;
+	}
+	res = lbe_plan_write(path, model, output, hops, count);
+	free(hops);
+	if (res < 0) {
+		return 1;
+	}
+	printf("Wrote %u hops for OUT%d to %s\n", count, output, path);
+	return 0;
+}
+
+/* Plan playback: the mapped reports go out as they are, nothing is encoded */
+static int run_plan(const char *path, uint32_t loops) {
+	struct lbe_sweep_stats stats;
+	struct lbe_plan_info info;
+	struct lbe_plan *plan;
+	struct lbe_device *dev;
+	int res;
+
+	plan = lbe_plan_open(path);
+	if (!plan) {
+		return 1;
+	}
+	lbe_plan_get_info(plan, &info);
+
+	dev = lbe_open_device();
+	if (!dev) {
+		fprintf(stderr, "Failed to open LBE-142x device\n");
+		lbe_plan_close(plan);
+		return 1;
+	}
+	install_stop_handler();
+	if (lock_device(dev, LBE_LOCK_EXCLUSIVE) < 0) {
+		lbe_close_device(dev);
+		lbe_plan_close(plan);
+		return 1;
+	}
+	print_lock_stats(dev);
+
+	printf("Playing %" PRIu64 " hops on OUT%d (%.3f s per pass)\n", info.count, info.output,
+		info.total_dwell_us / 1e6);
+	res = lbe_plan_run(dev, plan, loops, &stop_requested, &stats);
+	lbe_close_device(dev);
+	lbe_plan_close(plan);
+
+	print_sweep_stats(&stats);
+	return res < 0 ? 1 : 0;
+}
+
+/* Scheduled mode: one temporary frequency or output enable command, encoded
+ * before the wait and sent at the --at instant (repeat times) */
+static int run_at(const char *at, const char *selector, unsigned long repeat, uint32_t interval_ms,
+		struct lbe_schedule_opts *opts, int argc, char *argv[]) {
+	struct lbe_schedule_result result;
+	struct lbe_histogram hist;
+	struct lbe_report report;
+	struct lbe_device *devs[LBE_FLEET_MAX_DEVICES];
+	struct lbe_device *dev;
+	int count;
+	const char *command = NULL;
+	unsigned long value = 0;
+	unsigned long errors = 0;
+	uint64_t at_ns;
+	int res;
+
+	for (int i = 1; i < argc; i++) {
+		if ((strcmp(argv[i], "--f1t") == 0 || strcmp(argv[i], "--f2t") == 0 ||
+		     strcmp(argv[i], "--out") == 0) && i + 1 < argc) {
+			if (command) {
+				fprintf(stderr, "--at sends exactly one --f1t, --f2t or --out command\n");
+				return 1;
+			}
+			command = argv[i];
+			value = strtoul(argv[++i], NULL, 10);
+		}
+	}
+	if (!command) {
+		fprintf(stderr, "--at needs a --f1t, --f2t or --out command\n");
+		return 1;
+	}
+	if (lbe_parse_utc(at, &at_ns) < 0 || repeat == 0) {
+		return 1;
+	}
+
+	count = open_units(selector, devs);
+	if (count < 0) {
+		return 1;
+	}
+	if (count != 1) {
+		fprintf(stderr, "--at drives a single unit, --device selected %d\n", count);
+		close_units(devs, count);
+		return 1;
+	}
+	dev = devs[0];
+	if (strcmp(command, "--out") == 0) {
+		res = lbe_prepare_outputs_enable(dev, value != 0, &report);
+	} else {
+		unsigned long max_freq = lbe_get_model(dev) == LBE_1420 ? LBE_1420_MAX_FREQ : LBE_1421_MAX_FREQ;
+
+		if (value < 1 || value > max_freq) {
+			fprintf(stderr, "Invalid frequency: %lu (range: 1-%lu Hz)\n", value, max_freq);
+			lbe_close_device(dev);
+			return 1;
+		}
+		res = lbe_prepare_frequency_temp(dev, command[3] - '0', (uint32_t)value, &report);
+	}
+	if (res < 0 || lock_device(dev, LBE_LOCK_EXCLUSIVE) < 0) {
+		lbe_close_device(dev);
+		return 1;
+	}
+
+	install_stop_handler();
+	opts->stop = &stop_requested;
+	if (lbe_schedule_prepare(opts) < 0) {
+		fprintf(stderr, "Continuing without the requested real-time setup, expect more jitter\n");
+	}
+
+	lbe_histogram_init(&hist);
+	for (unsigned long n = 0; n < repeat && !stop_requested; n++) {
+		uint64_t target = at_ns + (uint64_t)n * interval_ms * 1000000ULL;
+
+		if (lbe_schedule_send(dev, &report, target, opts, &result) < 0) {
+			errors++;
+			if (result.issued_ns == 0) break; // never issued: missed, interrupted
+			continue;
+		}
+		printf("%" PRIu64 " %s %lu issued=%" PRIu64 " issue_error_us=%.1f wake_error_us=%.1f report_us=%.1f\n",
+			target, command + 2, value, result.issued_ns, result.issue_error_ns / 1e3,
+			result.wake_error_ns / 1e3, result.report_ns / 1e3);
+		fflush(stdout);
+		lbe_histogram_add(&hist, (uint64_t)result.issue_error_ns);
+	}
+	print_lock_stats(dev);
+	lbe_close_device(dev);
+
+	if (hist.count > 1) {
+		lbe_histogram_print(stdout, "issue error", &hist);
+	}
+	return errors ? 1 : 0;
+}
+#endif
+
+static void print_settle(const struct lbe_settle_result *result) {
+	if (result->timed_out) {
+		printf("  Not settled after %.3f ms (%u polls): f1=%u f2=%u pll=%d\n",
+			result->settle_ns / 1e6, result->polls, result->status.frequency1, result->status.frequency2,
+			(result->status.raw_status & LBE_PLL_LOCK_BIT) != 0);
+	} else {
+		printf("  Settled in %.3f ms (%u polls)\n", result->settle_ns / 1e6, result->polls);
+	}
+}
+
+/* Cycles through the temporary frequencies given on the command line, waits
+ * for each change to settle and prints the settle time distribution. Flash
+ * writes (--f1/--f2) are refused, this would wear it out. */
+static int run_settle_stats(unsigned long changes, const struct lbe_settle_opts *opts, int argc, char *argv[]) {
+	struct { int output; uint32_t frequency; } steps[64];
+	struct lbe_histogram hist;
+	struct lbe_settle_result result;
+	struct lbe_device *dev;
+	unsigned long timeouts = 0, errors = 0;
+	int nsteps = 0;
+#ifdef __linux__
+	struct lbe_device *devs[LBE_FLEET_MAX_DEVICES];
+	const char *selector = NULL;
+	int count;
+#endif
+
+	for (int i = 1; i < argc; i++) {
+		if ((strcmp(argv[i], "--f1t") == 0 || strcmp(argv[i], "--f2t") == 0) && i + 1 < argc) {
+			if (nsteps == (int)(sizeof(steps) / sizeof(steps[0]))) {
+				fprintf(stderr, "Too many frequencies\n");
+				return 1;
+			}
+			steps[nsteps].output = argv[i][3] - '0';
+			steps[nsteps].frequency = (uint32_t)strtoul(argv[++i], NULL, 10);
+			nsteps++;
+		} else if (strcmp(argv[i], "--f1") == 0 || strcmp(argv[i], "--f2") == 0) {
+			fprintf(stderr, "--settle-stats only uses temporary frequencies (--f1t/--f2t)\n");
+			return 1;
+		}
+	}
+	if (nsteps < 2) {
+		fprintf(stderr, "--settle-stats needs at least two --f1t/--f2t values to cycle through\n");
+		return 1;
+	}
+
+#ifdef __linux__
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--device") == 0 && i + 1 < argc) {
+			selector = argv[++i];
+		}
+	}
+	count = open_units(selector, devs);
+	if (count < 0) {
+		return 1;
+	}
+	if (count != 1) {
+		fprintf(stderr, "--settle-stats drives a single unit, --device selected %d\n", count);
+		close_units(devs, count);
+		return 1;
+	}
+	dev = devs[0];
+#else
+	dev = lbe_open_device();
+	if (!dev) {
+		fprintf(stderr, "Failed to open LBE-142x device\n");
+		return 1;
+	}
+#endif
+	for (int i = 0; i < nsteps; i++) {
+		unsigned long max_freq = lbe_get_model(dev) == LBE_1420 ? LBE_1420_MAX_FREQ : LBE_1421_MAX_FREQ;
+
+		if ((steps[i].output == 2 && lbe_get_model(dev) == LBE_1420) ||
+		    steps[i].frequency < 1 || steps[i].frequency > max_freq) {
+			fprintf(stderr, "Invalid frequency for OUT%d: %u\n", steps[i].output, steps[i].frequency);
+			lbe_close_device(dev);
+			return 1;
+		}
+	}
+	if (lock_device(dev, LBE_LOCK_EXCLUSIVE) < 0) {
+		lbe_close_device(dev);
+		return 1;
+	}
+
+	lbe_histogram_init(&hist);
+	for (unsigned long n = 0; n < changes; n++) {
+		int step = (int)(n % (unsigned long)nsteps);
+
+		if (lbe_set_frequency_wait(dev, steps[step].output, steps[step].frequency, 1, opts, &result) == 0) {
+			lbe_histogram_add(&hist, result.settle_ns);
+		} else if (result.timed_out) {
+			timeouts++;
+			print_settle(&result);
+		} else {
+			errors++;
+		}
+	}
+	print_lock_stats(dev);
+	lbe_close_device(dev);
+
+	printf("%lu changes, %" PRIu64 " settled, %lu timed out, %lu errors\n",
+		changes, hist.count, timeouts, errors);
+	if (hist.count) {
+		printf("Settle time: p50 %.3f ms, p90 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+			lbe_histogram_percentile(&hist, 50) / 1e6, lbe_histogram_percentile(&hist, 90) / 1e6,
+			lbe_histogram_percentile(&hist, 99) / 1e6, hist.max / 1e6);
+		lbe_histogram_print(stdout, "settle", &hist);
+	}
+	return timeouts || errors ? 1 : 0;
 }
 
 int main(int argc, char *argv[]) {
@@ -31,11 +1240,219 @@ int main(int argc, char *argv[]) {
 	struct lbe_status status;
 	enum lbe_model model;
 	int changed = 0;
+	int failed = 0;
 	unsigned long max_freq = LBE_1421_MAX_FREQ;
+	double start_ms = now_ms();
+	double open_ms, commands_ms;
+	int timing = 0;
+	int stats = 0;
+	int writes = 0;
+	int wait_lock = 0;
+	unsigned long settle_changes = 0;
+	struct lbe_settle_opts settle_opts;
+	struct lbe_settle_result settle;
+
+	lbe_settle_opts_init(&settle_opts);
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--lock-wait") == 0 && i + 1 < argc) {
+			lock_wait_ms = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--no-lock") == 0) {
+			use_lock = 0;
+		} else if (strcmp(argv[i], "--wait-lock") == 0) {
+			wait_lock = 1;
+		} else if (strcmp(argv[i], "--wait-timeout") == 0 && i + 1 < argc) {
+			settle_opts.timeout_ms = (uint32_t)strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--settle-stats") == 0 && i + 1 < argc) {
+			settle_changes = strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--timing") != 0 && strcmp(argv[i], "--stats") != 0 &&
+		           strcmp(argv[i], "--status") != 0 && strncmp(argv[i], "--", 2) == 0) {
+			writes = 1;
+		}
+	}
+	if (settle_changes) {
+		return run_settle_stats(settle_changes, &settle_opts, argc, argv);
+	}
+
+#ifdef __linux__
+	const char *batch_path = NULL;
+	const char *socket_path = NULL;
+	const char *selector = NULL;
+	const char *apply_path = NULL;
+	int workers = 0;
+	double monitor_rate = 0;
+	uint64_t monitor_count = 0;
+	int binary = 0;
+	int events = 0;
+	const char *publish = NULL;
+	const char *record = NULL;
+	const char *sweep_spec = NULL;
+	const char *hop_list = NULL;
+	int hop_out = 1;
+	uint32_t loops = 1;
+	const char *write_plan = NULL;
+	const char *plan_model = NULL;
+	const char *plan = NULL;
+	const char *failover = NULL;
+	const char *adaptive_poll = NULL;
+	const char *metrics = NULL;
+	const char *at = NULL;
+	unsigned long at_repeat = 1;
+	uint32_t at_interval_ms = AT_DEFAULT_INTERVAL_MS;
+	struct lbe_schedule_opts schedule_opts;
+	struct lbe_failover_opts failover_opts = {
+		FAILOVER_DEFAULT_RATE, FAILOVER_DEFAULT_FAIL, FAILOVER_DEFAULT_RECOVER, 0, &stop_requested,
+		1, LBE_LOCK_WAIT_FOREVER
+	};
+
+	lbe_schedule_opts_init(&schedule_opts);
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--list") == 0) {
+			return run_list();
+		} else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+			batch_path = argv[++i];
+		} else if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+			socket_path = argv[++i];
+		} else if (strcmp(argv[i], "--device") == 0 && i + 1 < argc) {
+			selector = argv[++i];
+		} else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+			workers = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--apply") == 0 && i + 1 < argc) {
+			apply_path = argv[++i];
+		} else if (strcmp(argv[i], "--monitor") == 0 && i + 1 < argc) {
+			char *end;
+
+			monitor_rate = strtod(argv[++i], &end);
+			if (end == argv[i] || *end || !(monitor_rate > 0 && monitor_rate <= LBE_MONITOR_MAX_RATE)) {
+				fprintf(stderr, "Invalid monitor rate: %s (range: >0-%g Hz)\n", argv[i], LBE_MONITOR_MAX_RATE);
+				return 1;
+			}
+		} else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc) {
+			monitor_count = strtoull(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--binary") == 0) {
+			binary = 1;
+		} else if (strcmp(argv[i], "--events") == 0) {
+			events = 1;
+		} else if (strcmp(argv[i], "--publish") == 0 && i + 1 < argc) {
+			publish = argv[++i];
+		} else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+			record = argv[++i];
+		} else if (strcmp(argv[i], "--sweep") == 0 && i + 1 < argc) {
+			sweep_spec = argv[++i];
+		} else if (strcmp(argv[i], "--hop-list") == 0 && i + 1 < argc) {
+			hop_list = argv[++i];
+		} else if (strcmp(argv[i], "--hop-out") == 0 && i + 1 < argc) {
+			hop_out = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--loops") == 0 && i + 1 < argc) {
+			loops = (uint32_t)strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--write-plan") == 0 && i + 1 < argc) {
+			write_plan = argv[++i];
+		} else if (strcmp(argv[i], "--plan-model") == 0 && i + 1 < argc) {
+			plan_model = argv[++i];
+		} else if (strcmp(argv[i], "--plan") == 0 && i + 1 < argc) {
+			plan = argv[++i];
+		} else if (strcmp(argv[i], "--failover") == 0 && i + 1 < argc) {
+			failover = argv[++i];
+		} else if (strcmp(argv[i], "--poll-hz") == 0 && i + 1 < argc) {
+			failover_opts.rate_hz = atof(argv[++i]);
+		} else if (strcmp(argv[i], "--fail-samples") == 0 && i + 1 < argc) {
+			failover_opts.fail_samples = (uint32_t)strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--recover-samples") == 0 && i + 1 < argc) {
+			failover_opts.recover_samples = (uint32_t)strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--revert") == 0) {
+			failover_opts.revert = 1;
+		} else if (strcmp(argv[i], "--adaptive-poll") == 0 && i + 1 < argc) {
+			adaptive_poll = argv[++i];
+		} else if (strcmp(argv[i], "--metrics") == 0 && i + 1 < argc) {
+			metrics = argv[++i];
+		} else if (strcmp(argv[i], "--at") == 0 && i + 1 < argc) {
+			at = argv[++i];
+		} else if (strcmp(argv[i], "--at-repeat") == 0 && i + 1 < argc) {
+			at_repeat = strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--at-interval") == 0 && i + 1 < argc) {
+			at_interval_ms = (uint32_t)strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--rt-prio") == 0 && i + 1 < argc) {
+			schedule_opts.rt_priority = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--cpu") == 0 && i + 1 < argc) {
+			schedule_opts.cpu = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--spin-us") == 0 && i + 1 < argc) {
+			schedule_opts.spin_us = (uint32_t)strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--no-mlock") == 0) {
+			schedule_opts.lock_memory = 0;
+		}
+	}
+	if (selector) {
+		const char *single = NULL;
+
+		if (batch_path) single = "--batch";
+		else if (failover) single = "--failover";
+		else if (plan) single = "--plan";
+		else if ((sweep_spec || hop_list) && !write_plan) single = "--sweep/--hop-list";
+		else if (monitor_rate > 0 || publish || record) single = "--monitor/--record";
+		else if (socket_path) single = "--socket";
+		if (single) {
+			fprintf(stderr, "%s does not take --device\n", single);
+			return 1;
+		}
+	}
+	if (batch_path) {
+		return run_batch(batch_path);
+	}
+	if (failover) {
+		if (failover_opts.rate_hz <= 0 || failover_opts.rate_hz > LBE_MONITOR_MAX_RATE ||
+		    failover_opts.fail_samples == 0) {
+			fprintf(stderr, "Invalid failover poll rate or sample count\n");
+			return 1;
+		}
+		failover_opts.lock = use_lock;
+		failover_opts.lock_wait_ms = lock_wait_ms;
+		return run_failover(failover, &failover_opts);
+	}
+	if (at) {
+		return run_at(at, selector, at_repeat, at_interval_ms, &schedule_opts, argc, argv);
+	}
+	if (metrics) {
+		return run_metrics(metrics, adaptive_poll, selector);
+	}
+	if (adaptive_poll) {
+		return run_adaptive_poll(adaptive_poll, selector);
+	}
+	if (plan) {
+		return run_plan(plan, loops);
+	}
+	if (sweep_spec || hop_list) {
+		if (hop_out != 1 && hop_out != 2) {
+			fprintf(stderr, "Invalid hop output: %d\n", hop_out);
+			return 1;
+		}
+		if (write_plan) {
+			return run_write_plan(write_plan, sweep_spec, hop_list, hop_out, plan_model);
+		}
+		return run_sweep(sweep_spec, hop_list, hop_out, loops);
+	}
+	if ((publish || record) && monitor_rate <= 0) {
+		monitor_rate = MONITOR_DEFAULT_RATE;
+	}
+	if (monitor_rate > 0) {
+		return run_monitor(monitor_rate, monitor_count, binary, events, publish, record);
+	}
+	if (socket_path) {
+		return run_client(socket_path, argc, argv);
+	}
+	if (selector) {
+		return run_fleet(selector, workers, apply_path, argc, argv);
+	}
+#endif
 
 	printf("lbe-142x v1.0 13 Dec 2024 Leo Bodnar LBE-142x GPS locked clock source config\n");
 
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--timing") == 0) timing = 1;
+		if (strcmp(argv[i], "--stats") == 0) stats = 1;
+	}
+
+	open_ms = now_ms();
 	dev = lbe_open_device();
+	open_ms = now_ms() - open_ms;
 	if (!dev) {
 		fprintf(stderr, "Failed to open LBE-142x device\n");
 		return 1;
@@ -50,12 +1467,25 @@ int main(int argc, char *argv[]) {
 
 	printf("Connected to LBE-%s\n", model == LBE_1420 ? "1420" : "1421 dual output");
 
+	// Status only runs may share the unit, anything else is a command sequence
+	if (lock_device(dev, writes ? LBE_LOCK_EXCLUSIVE : LBE_LOCK_SHARED) < 0) {
+		lbe_close_device(dev);
+		return 1;
+	}
+
 	if (model == LBE_1420) {
 		max_freq = LBE_1420_MAX_FREQ;
 	}
 
+	commands_ms = now_ms();
 	for (int i = 1; i < argc; i++) {
-		if (strcmp(argv[i], "--f1") == 0 || strcmp(argv[i], "--f2") == 0 || 
+		if (strcmp(argv[i], "--timing") == 0 || strcmp(argv[i], "--stats") == 0 ||
+		    strcmp(argv[i], "--no-lock") == 0 || strcmp(argv[i], "--wait-lock") == 0) {
+			continue;
+		} else if (strcmp(argv[i], "--lock-wait") == 0 || strcmp(argv[i], "--wait-timeout") == 0) {
+			i++;
+			continue;
+		} else if (strcmp(argv[i], "--f1") == 0 || strcmp(argv[i], "--f2") == 0 || 
 			strcmp(argv[i], "--f1t") == 0 || strcmp(argv[i], "--f2t") == 0) {
 			if (i + 1 < argc) {
 				int out_no = (argv[i][3] == '1') ? 1 : 2;
@@ -67,7 +1497,18 @@ int main(int argc, char *argv[]) {
 				}
 
 				uint32_t new_freq = atoi(argv[++i]);
-				if (new_freq >= 1 && new_freq <= max_freq) {
+				if (new_freq >= 1 && new_freq <= max_freq && wait_lock) {
+					int res = lbe_set_frequency_wait(dev, out_no, new_freq, temp, &settle_opts, &settle);
+
+					// Not settled in time, or the change or a read failed
+					if (res < 0) failed = 1;
+					if (res == 0 || settle.polls) {
+						printf("  Setting OUT%d %s frequency: %u Hz\n", out_no,
+							temp ? "temporary" : "flash", new_freq);
+						print_settle(&settle);
+						changed = 1;
+					}
+				} else if (new_freq >= 1 && new_freq <= max_freq) {
 					if (temp) {
 						if (lbe_set_frequency_temp(dev, out_no, new_freq) == 0) {
 							printf("  Setting OUT%d temporary frequency: %u Hz\n", out_no, new_freq);
@@ -145,6 +1586,21 @@ int main(int argc, char *argv[]) {
 				printf("  Blink LED(s)\n");
 				changed = 1;
 			}
+		} else if (strcmp(argv[i], "--apply") == 0) {
+			if (i + 1 < argc) {
+				struct lbe_config config;
+				const char *path = argv[++i];
+
+				if (lbe_config_load(path, &config) == 0) {
+					int sent = lbe_apply_config(dev, &config);
+					if (sent >= 0) {
+						printf("  Applied %s: %d report(s) sent\n", path, sent);
+						if (sent > 0) changed = 1;
+					} else {
+						fprintf(stderr, "Failed to apply %s\n", path);
+					}
+				}
+			}
 		} else if (strcmp(argv[i], "--status") == 0) {
 			if (lbe_get_device_status(dev, &status) == 0) {
 				printf("Device Status (0x%02X):\n", status.raw_status);
@@ -173,6 +1629,16 @@ int main(int argc, char *argv[]) {
 		printf("No changes made\n");
 	}
 
+	commands_ms = now_ms() - commands_ms;
+	if (timing) {
+		fprintf(stderr, "Timing: open %.3f ms (%s), commands %.3f ms, total %.3f ms\n",
+			open_ms, lbe_get_path(dev), commands_ms, now_ms() - start_ms);
+	}
+	if (stats) {
+		print_cmd_stats(dev);
+	}
+	print_lock_stats(dev);
+
 	lbe_close_device(dev);
-	return 0;
+	return failed ? 1 : 0;
 }
\ No newline at end of file
@@ -0,0 +1,52 @@
+#ifndef LBE_TEST_H
+#define LBE_TEST_H
+
+/*
+ * Minimal check macros for the unit tests. A failed check prints its
+ * location and the test keeps going; lbe_test_done() turns the failure
+ * count into the exit status ctest looks at.
+ */
+
+#include "lbe_log.h"
+#include <inttypes.h>
+#include <stdio.h>
+
+static int lbe_test_failures;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+		lbe_test_failures++; \
+	} \
+} while (0)
+
+#define CHECK_EQ(a, b) do { \
+	uint64_t lbe_a_ = (uint64_t)(a), lbe_b_ = (uint64_t)(b); \
+	if (lbe_a_ != lbe_b_) { \
+		fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %" PRIu64 " != %" PRIu64 "\n", \
+			__FILE__, __LINE__, #a, #b, lbe_a_, lbe_b_); \
+		lbe_test_failures++; \
+	} \
+} while (0)
+
+/* Library errors are expected in the failure cases, keep them out of the output */
+static void lbe_test_quiet(enum lbe_log_level level, const char *msg, void *arg) {
+	(void)level;
+	(void)msg;
+	(void)arg;
+}
+
+static void lbe_test_init(void) {
+	lbe_set_log_handler(lbe_test_quiet, NULL);
+}
+
+static int lbe_test_done(const char *name) {
+	if (lbe_test_failures) {
+		fprintf(stderr, "%s: %d check(s) failed\n", name, lbe_test_failures);
+		return 1;
+	}
+	printf("%s: ok\n", name);
+	return 0;
+}
+
+#endif // LBE_TEST_H
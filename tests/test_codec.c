@@ -0,0 +1,189 @@
+/*
+ * Codec round trips: every SET report built by the codec is applied to the
+ * simulator, whose status report is decoded again by the same codec.
+ */
+
+#include "lbe_codec.h"
+#include "lbe_common.h"
+#include "lbe_sim.h"
+#include "lbe_test.h"
+#include <string.h>
+
+static int apply(struct lbe_sim *sim, const uint8_t *buf) {
+	return lbe_sim_set_feature(sim, buf, LBE_REPORT_SIZE);
+}
+
+static void read_status(struct lbe_sim *sim, const struct lbe_codec *codec, struct lbe_status *status) {
+	uint8_t buf[LBE_REPORT_SIZE];
+
+	memset(status, 0, sizeof(*status));
+	CHECK(lbe_sim_get_feature(sim, buf, sizeof(buf)) >= 0);
+	lbe_codec_decode(codec, buf, status);
+}
+
+static void test_model(enum lbe_model model) {
+	const struct lbe_codec *codec = lbe_codec_get(model);
+	struct lbe_sim sim;
+	struct lbe_status status;
+	uint8_t buf[LBE_REPORT_SIZE];
+
+	lbe_sim_init(&sim, model);
+	CHECK(codec->model == model);
+
+	// Temporary change: running copy moves, flash stays
+	CHECK(lbe_codec_frequency(codec, 1, 12345678, 1, buf) == 0);
+	CHECK(apply(&sim, buf) == 0);
+	CHECK_EQ(sim.frequency[0], 12345678);
+	CHECK_EQ(sim.flash_frequency[0], 10000000);
+	CHECK_EQ(sim.flash_writes, 0);
+	read_status(&sim, codec, &status);
+	CHECK_EQ(status.frequency1, 12345678);
+
+	// Persistent change, including the top of the range
+	CHECK(lbe_codec_frequency(codec, 1, codec->max_frequency, 0, buf) == 0);
+	CHECK(apply(&sim, buf) == 0);
+	CHECK_EQ(sim.flash_frequency[0], codec->max_frequency);
+	CHECK_EQ(sim.flash_writes, 1);
+	read_status(&sim, codec, &status);
+	CHECK_EQ(status.frequency1, codec->max_frequency);
+
+	CHECK(lbe_codec_power(codec, 1, 1, buf) == 0);
+	CHECK(apply(&sim, buf) == 0);
+	read_status(&sim, codec, &status);
+	CHECK(status.out1_power_low == 1);
+	CHECK(status.out2_power_low == 0);
+	CHECK(lbe_codec_power(codec, 1, 0, buf) == 0);
+	CHECK(apply(&sim, buf) == 0);
+	read_status(&sim, codec, &status);
+	CHECK(status.out1_power_low == 0);
+
+	lbe_codec_pll_mode(1, buf);
+	CHECK(apply(&sim, buf) == 0);
+	read_status(&sim, codec, &status);
+	CHECK(status.fll_enabled == 1);
+	lbe_codec_pll_mode(0, buf);
+	CHECK(apply(&sim, buf) == 0);
+	read_status(&sim, codec, &status);
+	CHECK(status.fll_enabled == 0);
+
+	lbe_codec_blink(buf);
+	CHECK(apply(&sim, buf) == 0);
+
+	// Output numbers beyond the model are refused without touching buf[0]
+	CHECK(lbe_codec_frequency(codec, 0, 1000000, 1, buf) < 0);
+	CHECK(buf[0] == 0);
+	CHECK(lbe_codec_frequency(codec, codec->outputs + 1, 1000000, 1, buf) < 0);
+	CHECK(lbe_codec_power(codec, codec->outputs + 1, 1, buf) < 0);
+
+	if (model == LBE_1420) {
+		CHECK(lbe_codec_pps(codec, 1, buf) < 0);
+		lbe_codec_outputs_enable(codec, 0, buf);
+		CHECK(apply(&sim, buf) == 0);
+		read_status(&sim, codec, &status);
+		CHECK(status.outputs_enabled == 1); // always reported on
+		CHECK(status.frequency2 == 0);
+		CHECK(status.pps_enabled == 0);
+		return;
+	}
+
+	CHECK(lbe_codec_frequency(codec, 2, 25000000, 1, buf) == 0);
+	CHECK(apply(&sim, buf) == 0);
+	read_status(&sim, codec, &status);
+	CHECK_EQ(status.frequency2, 25000000);
+	CHECK_EQ(status.frequency1, codec->max_frequency);
+
+	CHECK(lbe_codec_power(codec, 2, 1, buf) == 0);
+	CHECK(apply(&sim, buf) == 0);
+	read_status(&sim, codec, &status);
+	CHECK(status.out1_power_low == 0);
+	CHECK(status.out2_power_low == 1);
+
+	CHECK(lbe_codec_pps(codec, 1, buf) == 0);
+	CHECK(apply(&sim, buf) == 0);
+	read_status(&sim, codec, &status);
+	CHECK(status.pps_enabled == 1);
+	CHECK(lbe_codec_pps(codec, 0, buf) == 0);
+	CHECK(apply(&sim, buf) == 0);
+	read_status(&sim, codec, &status);
+	CHECK(status.pps_enabled == 0);
+
+	lbe_codec_outputs_enable(codec, 0, buf);
+	CHECK(apply(&sim, buf) == 0);
+	read_status(&sim, codec, &status);
+	CHECK(status.outputs_enabled == 0);
+	CHECK((status.raw_status & (LBE_OUT1_EN_BIT | LBE_OUT2_EN_BIT)) == 0);
+	lbe_codec_outputs_enable(codec, 1, buf);
+	CHECK(apply(&sim, buf) == 0);
+	read_status(&sim, codec, &status);
+	CHECK((status.raw_status & (LBE_OUT1_EN_BIT | LBE_OUT2_EN_BIT)) == (LBE_OUT1_EN_BIT | LBE_OUT2_EN_BIT));
+	CHECK(status.pll_locked == ((status.raw_status & LBE_PLL_LOCK_BIT) != 0));
+}
+
+/* The libusb LBE-1420 sends the LBE-1421 power command and reads pwr1 at byte 19 */
+static void test_libusb_1420(void) {
+	const struct lbe_codec *codec = lbe_codec_get_libusb(LBE_1420);
+	struct lbe_status status;
+	uint8_t buf[LBE_REPORT_SIZE];
+
+	CHECK(codec != lbe_codec_get(LBE_1420));
+	CHECK(lbe_codec_get_libusb(LBE_1421_DUALOUT) == lbe_codec_get(LBE_1421_DUALOUT));
+
+	CHECK(lbe_codec_power(codec, 1, 1, buf) == 0);
+	CHECK(buf[0] == LBE_1421_SET_PWR1);
+	CHECK(buf[1] == 0x01);
+	CHECK(lbe_codec_power(codec, 2, 1, buf) < 0);
+
+	CHECK(lbe_codec_frequency(codec, 1, 0x01020304, 1, buf) == 0);
+	CHECK(buf[0] == LBE_1420_SET_F1_TEMP);
+	CHECK(buf[1] == 0x04 && buf[2] == 0x03 && buf[3] == 0x02 && buf[4] == 0x01);
+
+	memset(buf, 0, sizeof(buf));
+	buf[0] = LBE_STATUS_REPORT_ID;
+	buf[6] = 0x80; buf[7] = 0x96; buf[8] = 0x98; // 10 MHz
+	buf[10] = 1;
+	lbe_codec_decode(codec, buf, &status);
+	CHECK_EQ(status.frequency1, 10000000);
+	CHECK(status.out1_power_low == 0);
+	buf[10] = 0;
+	buf[19] = 1;
+	lbe_codec_decode(codec, buf, &status);
+	CHECK(status.out1_power_low == 1);
+	CHECK(status.out2_power_low == 0);
+
+	// The hidraw layout reads the same report the other way round
+	lbe_codec_decode(lbe_codec_get(LBE_1420), buf, &status);
+	CHECK(status.out1_power_low == 0);
+}
+
+/* The public calls go through the same codec on a simulator handle */
+static void test_device(enum lbe_model model) {
+	struct lbe_sim sim;
+	struct lbe_device *dev;
+	struct lbe_status status;
+
+	lbe_sim_init(&sim, model);
+	dev = lbe_open_simulator(&sim, 0);
+	CHECK(dev != NULL);
+	if (!dev) {
+		return;
+	}
+	CHECK(lbe_get_model(dev) == model);
+	CHECK(lbe_set_frequency_temp(dev, 1, 27000000) == 0);
+	CHECK(lbe_set_power_level(dev, 1, 1) == 0);
+	CHECK(lbe_get_device_status(dev, &status) == 0);
+	CHECK_EQ(status.frequency1, 27000000);
+	CHECK(status.out1_power_low == 1);
+	CHECK(lbe_set_frequency_temp(dev, 2, 27000000) == (model == LBE_1420 ? -1 : 0));
+	CHECK(lbe_set_1pps(dev, 1) == (model == LBE_1420 ? -1 : 0));
+	lbe_close_device(dev);
+}
+
+int main(void) {
+	lbe_test_init();
+	test_model(LBE_1420);
+	test_model(LBE_1421_DUALOUT);
+	test_libusb_1420();
+	test_device(LBE_1420);
+	test_device(LBE_1421_DUALOUT);
+	return lbe_test_done("test_codec");
+}
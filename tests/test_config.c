@@ -0,0 +1,222 @@
+/*
+ * Config diff: command order, the no-op case, persist and the checks that
+ * must fail before any command is produced. Applied to the simulator too.
+ */
+
+#include "lbe_common.h"
+#include "lbe_config.h"
+#include "lbe_sim.h"
+#include "lbe_test.h"
+#include <stdio.h>
+#include <string.h>
+
+#define CONFIG_PATH "test_config.conf"
+
+static void expect_cmd(const struct lbe_cmd *cmd, enum lbe_cmd_op op, int output, uint32_t value) {
+	CHECK(cmd->op == op);
+	CHECK(cmd->output == output);
+	CHECK_EQ(cmd->value, value);
+}
+
+/* A 1421 at its defaults: 10 MHz, PLL, no 1PPS, full power, outputs on */
+static void default_status(struct lbe_status *status) {
+	memset(status, 0, sizeof(*status));
+	status->raw_status = LBE_GPS_LOCK_BIT | LBE_PLL_LOCK_BIT | LBE_ANT_OK_BIT | LBE_OUT1_EN_BIT | LBE_OUT2_EN_BIT;
+	status->frequency1 = 10000000;
+	status->frequency2 = 10000000;
+	status->outputs_enabled = 1;
+}
+
+static void full_config(struct lbe_config *cfg, int outputs) {
+	memset(cfg, 0, sizeof(*cfg));
+	cfg->set = LBE_CONFIG_F1 | LBE_CONFIG_F2 | LBE_CONFIG_OUTPUTS | LBE_CONFIG_FLL |
+		LBE_CONFIG_PPS | LBE_CONFIG_PWR1 | LBE_CONFIG_PWR2;
+	cfg->frequency1 = 12000000;
+	cfg->frequency2 = 27000000;
+	cfg->outputs_enabled = outputs;
+	cfg->fll_enabled = 1;
+	cfg->pps_enabled = 1;
+	cfg->out1_power_low = 1;
+	cfg->out2_power_low = 1;
+}
+
+static void test_order(void) {
+	struct lbe_cmd cmds[LBE_CONFIG_MAX_CMDS];
+	struct lbe_status status;
+	struct lbe_config cfg;
+
+	// Disabling goes out before anything else
+	default_status(&status);
+	full_config(&cfg, 0);
+	CHECK(lbe_config_diff(&cfg, &status, LBE_1421_DUALOUT, cmds, LBE_CONFIG_MAX_CMDS) == 7);
+	expect_cmd(&cmds[0], LBE_CMD_OUTPUTS, 0, 0);
+	expect_cmd(&cmds[1], LBE_CMD_SET_FREQ_TEMP, 1, 12000000);
+	expect_cmd(&cmds[2], LBE_CMD_SET_FREQ_TEMP, 2, 27000000);
+	expect_cmd(&cmds[3], LBE_CMD_PLL, 0, 1);
+	expect_cmd(&cmds[4], LBE_CMD_PPS, 0, 1);
+	expect_cmd(&cmds[5], LBE_CMD_POWER, 1, 1);
+	expect_cmd(&cmds[6], LBE_CMD_POWER, 2, 1);
+
+	// Enabling comes last, once everything else is in place
+	status.raw_status &= (uint8_t)~(LBE_OUT1_EN_BIT | LBE_OUT2_EN_BIT);
+	status.outputs_enabled = 0;
+	full_config(&cfg, 1);
+	CHECK(lbe_config_diff(&cfg, &status, LBE_1421_DUALOUT, cmds, LBE_CONFIG_MAX_CMDS) == 7);
+	expect_cmd(&cmds[0], LBE_CMD_SET_FREQ_TEMP, 1, 12000000);
+	expect_cmd(&cmds[5], LBE_CMD_POWER, 2, 1);
+	expect_cmd(&cmds[6], LBE_CMD_OUTPUTS, 0, 1);
+
+	// Only one output enabled still needs the enable report
+	status.raw_status |= LBE_OUT1_EN_BIT;
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.set = LBE_CONFIG_OUTPUTS;
+	cfg.outputs_enabled = 1;
+	CHECK(lbe_config_diff(&cfg, &status, LBE_1421_DUALOUT, cmds, LBE_CONFIG_MAX_CMDS) == 1);
+	expect_cmd(&cmds[0], LBE_CMD_OUTPUTS, 0, 1);
+}
+
+static void test_unchanged(void) {
+	struct lbe_cmd cmds[LBE_CONFIG_MAX_CMDS];
+	struct lbe_status status;
+	struct lbe_config cfg;
+
+	default_status(&status);
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.set = LBE_CONFIG_F1 | LBE_CONFIG_F2 | LBE_CONFIG_OUTPUTS | LBE_CONFIG_FLL |
+		LBE_CONFIG_PPS | LBE_CONFIG_PWR1 | LBE_CONFIG_PWR2;
+	cfg.frequency1 = 10000000;
+	cfg.frequency2 = 10000000;
+	cfg.outputs_enabled = 1;
+	CHECK(lbe_config_diff(&cfg, &status, LBE_1421_DUALOUT, cmds, LBE_CONFIG_MAX_CMDS) == 0);
+
+	// Running frequency says nothing about flash, persist always writes
+	cfg.persist = 1;
+	CHECK(lbe_config_diff(&cfg, &status, LBE_1421_DUALOUT, cmds, LBE_CONFIG_MAX_CMDS) == 2);
+	expect_cmd(&cmds[0], LBE_CMD_SET_FREQ, 1, 10000000);
+	expect_cmd(&cmds[1], LBE_CMD_SET_FREQ, 2, 10000000);
+
+	// The LBE-1420 output state is unknown, so outputs are always sent
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.set = LBE_CONFIG_OUTPUTS;
+	cfg.outputs_enabled = 1;
+	CHECK(lbe_config_diff(&cfg, &status, LBE_1420, cmds, LBE_CONFIG_MAX_CMDS) == 1);
+	expect_cmd(&cmds[0], LBE_CMD_OUTPUTS, 0, 1);
+}
+
+static void test_invalid(void) {
+	struct lbe_cmd cmds[LBE_CONFIG_MAX_CMDS];
+	struct lbe_status status;
+	struct lbe_config cfg;
+
+	default_status(&status);
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.set = LBE_CONFIG_F1 | LBE_CONFIG_OUTPUTS;
+	cfg.outputs_enabled = 0;
+
+	cfg.frequency1 = 0;
+	CHECK(lbe_config_diff(&cfg, &status, LBE_1421_DUALOUT, cmds, LBE_CONFIG_MAX_CMDS) < 0);
+	cfg.frequency1 = LBE_1421_MAX_FREQ + 1;
+	CHECK(lbe_config_diff(&cfg, &status, LBE_1421_DUALOUT, cmds, LBE_CONFIG_MAX_CMDS) < 0);
+	cfg.frequency1 = LBE_1421_MAX_FREQ;
+	CHECK(lbe_config_diff(&cfg, &status, LBE_1421_DUALOUT, cmds, LBE_CONFIG_MAX_CMDS) == 2);
+	// The LBE-1420 goes higher
+	cfg.frequency1 = LBE_1420_MAX_FREQ;
+	CHECK(lbe_config_diff(&cfg, &status, LBE_1420, cmds, LBE_CONFIG_MAX_CMDS) == 2);
+	cfg.frequency1 = LBE_1420_MAX_FREQ + 1;
+	CHECK(lbe_config_diff(&cfg, &status, LBE_1420, cmds, LBE_CONFIG_MAX_CMDS) < 0);
+
+	cfg.frequency1 = 10000000;
+	CHECK(lbe_config_diff(&cfg, &status, LBE_1421_DUALOUT, cmds, LBE_CONFIG_MAX_CMDS - 1) < 0);
+
+	cfg.set = LBE_CONFIG_F2;
+	cfg.frequency2 = 10000000;
+	CHECK(lbe_config_diff(&cfg, &status, LBE_1420, cmds, LBE_CONFIG_MAX_CMDS) < 0);
+	cfg.set = LBE_CONFIG_PPS;
+	CHECK(lbe_config_diff(&cfg, &status, LBE_1420, cmds, LBE_CONFIG_MAX_CMDS) < 0);
+	cfg.set = LBE_CONFIG_PWR2;
+	CHECK(lbe_config_diff(&cfg, &status, LBE_1420, cmds, LBE_CONFIG_MAX_CMDS) < 0);
+}
+
+static int write_config(const char *text) {
+	FILE *f = fopen(CONFIG_PATH, "w");
+
+	if (!f) return -1;
+	fputs(text, f);
+	fclose(f);
+	return 0;
+}
+
+static void test_load(void) {
+	struct lbe_config cfg;
+
+	CHECK(write_config("# reference\n"
+		"f1 = 12000000\n"
+		"  f2=27000000   # second output\n"
+		"\n"
+		"persist = 1\n"
+		"out 1\n"
+		"pll = 0\n"
+		"pwr2 = 1\n") == 0);
+	CHECK(lbe_config_load(CONFIG_PATH, &cfg) == 0);
+	CHECK(cfg.set == (LBE_CONFIG_F1 | LBE_CONFIG_F2 | LBE_CONFIG_OUTPUTS | LBE_CONFIG_FLL | LBE_CONFIG_PWR2));
+	CHECK_EQ(cfg.frequency1, 12000000);
+	CHECK_EQ(cfg.frequency2, 27000000);
+	CHECK(cfg.persist == 1);
+	CHECK(cfg.outputs_enabled == 1);
+	CHECK(cfg.fll_enabled == 0);
+	CHECK(cfg.out2_power_low == 1);
+
+	CHECK(write_config("f1 = 10M\n") == 0);
+	CHECK(lbe_config_load(CONFIG_PATH, &cfg) < 0);
+	CHECK(write_config("pps = 2\n") == 0);
+	CHECK(lbe_config_load(CONFIG_PATH, &cfg) < 0);
+	CHECK(write_config("f3 = 10000000\n") == 0);
+	CHECK(lbe_config_load(CONFIG_PATH, &cfg) < 0);
+	CHECK(write_config("f1 = 4294967296\n") == 0);
+	CHECK(lbe_config_load(CONFIG_PATH, &cfg) < 0);
+	CHECK(write_config("out\n") == 0);
+	CHECK(lbe_config_load(CONFIG_PATH, &cfg) < 0);
+
+	remove(CONFIG_PATH);
+	CHECK(lbe_config_load(CONFIG_PATH, &cfg) < 0);
+}
+
+static void test_apply(void) {
+	struct lbe_sim sim;
+	struct lbe_device *dev;
+	struct lbe_config cfg;
+	uint64_t reports;
+
+	lbe_sim_init(&sim, LBE_1421_DUALOUT);
+	dev = lbe_open_simulator(&sim, 0);
+	CHECK(dev != NULL);
+	if (!dev) return;
+
+	full_config(&cfg, 1);
+	CHECK(lbe_apply_config(dev, &cfg) == 6);
+	CHECK_EQ(sim.frequency[0], 12000000);
+	CHECK_EQ(sim.frequency[1], 27000000);
+	CHECK_EQ(sim.flash_frequency[0], 10000000);
+	CHECK(sim.fll_enabled && sim.pps_enabled && sim.power_low[0] && sim.power_low[1]);
+	CHECK(lbe_apply_config(dev, &cfg) == 0);
+
+	// A bad f2 must not leave the outputs disabled by a half applied config
+	full_config(&cfg, 0);
+	cfg.frequency2 = LBE_1421_MAX_FREQ + 1;
+	reports = sim.set_reports;
+	CHECK(lbe_apply_config(dev, &cfg) < 0);
+	CHECK_EQ(sim.set_reports, reports);
+	CHECK(sim.outputs_enabled == 1);
+
+	lbe_close_device(dev);
+}
+
+int main(void) {
+	lbe_test_init();
+	test_order();
+	test_unchanged();
+	test_invalid();
+	test_load();
+	test_apply();
+	return lbe_test_done("test_config");
+}
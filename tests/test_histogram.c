@@ -0,0 +1,123 @@
+/*
+ * Histogram buckets: every value lands in the bucket whose bounds hold it,
+ * and percentiles stay within one bucket (1/16) of the exact answer.
+ */
+
+#include "lbe_histogram.h"
+#include "lbe_test.h"
+
+/* Index of the only bucket a histogram holding one value has filled */
+static int bucket_of(uint64_t value) {
+	static struct lbe_histogram h;
+	int found = -1;
+
+	lbe_histogram_init(&h);
+	lbe_histogram_add(&h, value);
+	for (int i = 0; i < LBE_HIST_BUCKETS; i++) {
+		if (h.buckets[i]) {
+			CHECK(found < 0);
+			found = i;
+		}
+	}
+	return found;
+}
+
+static void check_bucket(uint64_t value) {
+	int i = bucket_of(value);
+
+	CHECK(i >= 0);
+	if (i < 0) return;
+	if (i == LBE_HIST_BUCKETS - 1 && value > lbe_histogram_bucket_upper(i)) {
+		return; // everything past 2^40 shares the last bucket
+	}
+	if (value > lbe_histogram_bucket_upper(i) || (i > 0 && value <= lbe_histogram_bucket_upper(i - 1))) {
+		fprintf(stderr, "value %llu in bucket %d\n", (unsigned long long)value, i);
+		CHECK(0);
+	}
+}
+
+static void test_bounds(void) {
+	// Exact below 16, then 16 buckets per power of two
+	for (int i = 0; i < LBE_HIST_SUB_COUNT; i++) {
+		CHECK_EQ(lbe_histogram_bucket_upper(i), i);
+	}
+	for (int i = 1; i < LBE_HIST_BUCKETS; i++) {
+		uint64_t lo = lbe_histogram_bucket_upper(i - 1) + 1;
+		uint64_t hi = lbe_histogram_bucket_upper(i);
+
+		CHECK(hi >= lo);
+		// Width at most 1/16 of the values it holds
+		CHECK((hi - lo + 1) * LBE_HIST_SUB_COUNT <= lo || lo < LBE_HIST_SUB_COUNT);
+	}
+	CHECK_EQ(lbe_histogram_bucket_upper(LBE_HIST_BUCKETS - 1), (1ULL << LBE_HIST_MAX_BITS) - 1);
+
+	for (uint64_t v = 0; v < 5000; v++) {
+		check_bucket(v);
+	}
+	for (int bit = 4; bit < 63; bit++) {
+		uint64_t p = 1ULL << bit;
+
+		check_bucket(p - 1);
+		check_bucket(p);
+		check_bucket(p + 1);
+		check_bucket(p + p / 3);
+	}
+	CHECK(bucket_of(1ULL << 50) == LBE_HIST_BUCKETS - 1);
+	CHECK(bucket_of(UINT64_MAX) == LBE_HIST_BUCKETS - 1);
+}
+
+static void check_near(uint64_t got, uint64_t exact) {
+	// Upper bound of the bucket: never below, at most one bucket width above
+	if (got < exact || (got - exact) * LBE_HIST_SUB_COUNT > exact) {
+		fprintf(stderr, "percentile %llu, exact %llu\n", (unsigned long long)got, (unsigned long long)exact);
+		CHECK(0);
+	}
+}
+
+static void test_percentiles(void) {
+	static struct lbe_histogram h, a, b;
+
+	lbe_histogram_init(&h);
+	CHECK(lbe_histogram_percentile(&h, 50) == 0);
+	CHECK(lbe_histogram_mean(&h) == 0.0);
+
+	// 1 us .. 1 ms, split over two histograms to check merge as well
+	lbe_histogram_init(&a);
+	lbe_histogram_init(&b);
+	for (uint64_t us = 1; us <= 1000; us++) {
+		lbe_histogram_add(&h, us * 1000);
+		lbe_histogram_add(us % 3 ? &a : &b, us * 1000);
+	}
+	CHECK_EQ(h.count, 1000);
+	CHECK_EQ(lbe_histogram_percentile(&h, 0), 1000);
+	CHECK_EQ(lbe_histogram_percentile(&h, 100), 1000000);
+	check_near(lbe_histogram_percentile(&h, 50), 500000);
+	check_near(lbe_histogram_percentile(&h, 90), 900000);
+	check_near(lbe_histogram_percentile(&h, 99), 990000);
+	check_near(lbe_histogram_percentile(&h, 0.1), 1000);
+	CHECK(lbe_histogram_percentile(&h, 99.99) <= 1000000);
+	CHECK(lbe_histogram_mean(&h) == 500500.0);
+
+	lbe_histogram_merge(&a, &b);
+	CHECK_EQ(a.count, h.count);
+	CHECK_EQ(a.sum, h.sum);
+	CHECK_EQ(a.min, h.min);
+	CHECK_EQ(a.max, h.max);
+	for (int i = 0; i < LBE_HIST_BUCKETS; i++) {
+		CHECK_EQ(a.buckets[i], h.buckets[i]);
+	}
+
+	// A single sample is every percentile
+	lbe_histogram_init(&h);
+	lbe_histogram_add(&h, 123456);
+	CHECK_EQ(lbe_histogram_percentile(&h, 1), 123456);
+	CHECK_EQ(lbe_histogram_percentile(&h, 50), 123456);
+	CHECK_EQ(lbe_histogram_percentile(&h, 99), 123456);
+}
+
+int main(void) {
+	lbe_test_init();
+	test_bounds();
+	test_percentiles();
+	return lbe_test_done("test_histogram");
+}
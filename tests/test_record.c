@@ -0,0 +1,228 @@
+/*
+ * Recording format: samples go through the writer's key/delta/run frames
+ * and varint delta-of-delta timestamps and must come back bit for bit, also
+ * from a data file cut anywhere inside its last block.
+ */
+
+#include "lbe_common.h"
+#include "lbe_record.h"
+#include "lbe_test.h"
+#include <string.h>
+
+#define REC_PATH "test_record.lbr"
+#define TORN_PATH "test_record_torn.lbr"
+#define REC_SAMPLES (2 * LBE_REC_BLOCK_SAMPLES + 700)
+
+// The reader rebuilds wall time from the key frame, so keep it a fixed step from mono
+#define REAL_OFFSET 1790000000000000000ULL
+
+static struct lbe_rec_sample samples[REC_SAMPLES];
+
+static uint32_t rand_state = 12345;
+
+static uint32_t next_rand(void) {
+	rand_state = rand_state * 1103515245 + 12345;
+	return rand_state >> 8;
+}
+
+static void make_samples(void) {
+	uint64_t mono = 5000000000ULL;
+	uint8_t report[LBE_REPORT_SIZE];
+
+	memset(report, 0, sizeof(report));
+	report[0] = LBE_STATUS_REPORT_ID;
+	report[1] = LBE_GPS_LOCK_BIT | LBE_PLL_LOCK_BIT | LBE_ANT_OK_BIT;
+	report[6] = 0x80; report[7] = 0x96; report[8] = 0x98;
+
+	for (int i = 0; i < REC_SAMPLES; i++) {
+		uint32_t r = next_rand();
+
+		// Mostly 1 ms polls with small jitter, sometimes a stall or a long gap
+		if (i == 0) {
+			// first sample, key frame
+		} else if (i == 3000) {
+			mono += 90 * 1000000000ULL; // ends the block on wall time
+		} else if (r % 97 == 0) {
+			mono += 250000000 + r % 1000000;
+		} else if (r % 13 == 0) {
+			mono += 1; // negative delta-of-delta after a normal step
+		} else {
+			mono += 1000000 - 500 + r % 1000;
+		}
+
+		// Changed reports split the runs: lock flaps and frequency changes
+		if (r % 211 == 0) report[1] ^= LBE_PLL_LOCK_BIT;
+		if (r % 503 == 0) {
+			report[6] = (uint8_t)r;
+			report[9] = (uint8_t)(r >> 8);
+		}
+		if (r % 1009 == 0) report[59] ^= 0xFF; // run at the very end of the report
+
+		samples[i].mono_ns = mono;
+		samples[i].real_ns = mono + REAL_OFFSET;
+		memcpy(samples[i].report, report, sizeof(report));
+	}
+}
+
+static int same_sample(const struct lbe_rec_sample *a, const struct lbe_rec_sample *b) {
+	return a->mono_ns == b->mono_ns && a->real_ns == b->real_ns &&
+		memcmp(a->report, b->report, LBE_REPORT_SIZE) == 0;
+}
+
+static int write_samples(const char *path, int first, int count) {
+	struct lbe_rec_writer *w = lbe_rec_writer_open(path, LBE_1421_DUALOUT);
+	uint64_t written = 0;
+
+	if (!w) return -1;
+	for (int i = first; i < first + count; i++) {
+		if (lbe_rec_writer_add(w, &samples[i]) < 0) {
+			lbe_rec_writer_close(w, NULL, NULL);
+			return -1;
+		}
+	}
+	if (lbe_rec_writer_close(w, &written, NULL) < 0 || written != (uint64_t)count) return -1;
+	return 0;
+}
+
+/* Reads the whole file, checking it against samples[first..]; returns the
+ * sample count, or -1 on a mismatch or corrupt data */
+static int read_samples(const char *path, int first) {
+	struct lbe_rec_reader *r = lbe_rec_reader_open(path);
+	struct lbe_rec_sample s;
+	int n = 0, res;
+
+	if (!r) return -1;
+	while ((res = lbe_rec_reader_next(r, &s)) == 1) {
+		if (first + n >= REC_SAMPLES || !same_sample(&s, &samples[first + n])) {
+			res = -1;
+			break;
+		}
+		n++;
+	}
+	lbe_rec_reader_close(r);
+	return res < 0 ? -1 : n;
+}
+
+/* Copies length bytes (all with -1) from offset, mode "wb" or "ab" */
+static long copy_file(const char *from, const char *to, long offset, long length, const char *mode) {
+	FILE *in = fopen(from, "rb");
+	FILE *out = fopen(to, mode);
+	char buf[4096];
+	long done = 0;
+
+	if (in && out && fseek(in, offset, SEEK_SET) == 0) {
+		while (done < length || length < 0) {
+			size_t want = sizeof(buf);
+			size_t got;
+
+			if (length >= 0 && (long)want > length - done) want = (size_t)(length - done);
+			got = fread(buf, 1, want, in);
+			if (!got || fwrite(buf, 1, got, out) != got) break;
+			done += (long)got;
+		}
+	}
+	if (in) fclose(in);
+	if (out) fclose(out);
+	return done;
+}
+
+static void remove_recording(const char *path) {
+	char idx[256];
+
+	snprintf(idx, sizeof(idx), "%s%s", path, LBE_REC_INDEX_SUFFIX);
+	remove(path);
+	remove(idx);
+}
+
+int main(void) {
+	const struct lbe_rec_index_entry *entries;
+	struct lbe_rec_index_entry last;
+	struct lbe_rec_reader *r;
+	struct lbe_rec_sample s;
+	char idx_path[256];
+	size_t nindex;
+	int block_start[16];
+	uint64_t total = 0;
+
+	lbe_test_init();
+	make_samples();
+	remove_recording(REC_PATH);
+	snprintf(idx_path, sizeof(idx_path), "%s%s", REC_PATH, LBE_REC_INDEX_SUFFIX);
+
+	CHECK(write_samples(REC_PATH, 0, REC_SAMPLES) == 0);
+	CHECK(read_samples(REC_PATH, 0) == REC_SAMPLES);
+
+	// Index: contiguous blocks covering every sample, split on count and on wall time
+	r = lbe_rec_reader_open(REC_PATH);
+	CHECK(r != NULL);
+	if (!r) return lbe_test_done("test_record");
+	CHECK(lbe_rec_reader_model(r) == LBE_1421_DUALOUT);
+	nindex = lbe_rec_reader_index(r, &entries);
+	CHECK(nindex >= 3 && nindex < sizeof(block_start) / sizeof(block_start[0]));
+	if (nindex < 3 || nindex >= sizeof(block_start) / sizeof(block_start[0])) {
+		lbe_rec_reader_close(r);
+		return lbe_test_done("test_record");
+	}
+	for (size_t i = 0; i < nindex; i++) {
+		block_start[i] = (int)total;
+		CHECK(entries[i].samples > 0 && entries[i].samples <= LBE_REC_BLOCK_SAMPLES);
+		CHECK_EQ(entries[i].offset, i ? entries[i - 1].offset + entries[i - 1].length : LBE_REC_HEADER_SIZE);
+		CHECK_EQ(entries[i].first_real_ns, samples[total].real_ns);
+		CHECK_EQ(entries[i].first_mono_ns, samples[total].mono_ns);
+		total += entries[i].samples;
+		CHECK_EQ(entries[i].last_real_ns, samples[total - 1].real_ns);
+		CHECK((entries[i].lock_all & ~entries[i].lock_any) == 0);
+	}
+	CHECK_EQ(total, REC_SAMPLES);
+	// The sample after the gap is the last one of block 0
+	CHECK_EQ(entries[1].first_real_ns, samples[3001].real_ns);
+
+	// Seeking by block and by time lands on a key frame
+	CHECK(lbe_rec_reader_seek_block(r, 2) == 0);
+	CHECK(lbe_rec_reader_next(r, &s) == 1 && same_sample(&s, &samples[block_start[2]]));
+	CHECK(lbe_rec_reader_seek(r, samples[block_start[2] + 10].real_ns) == 0);
+	CHECK(lbe_rec_reader_next(r, &s) == 1 && same_sample(&s, &samples[block_start[2]]));
+	CHECK(lbe_rec_reader_seek_block(r, nindex) == 0);
+	CHECK(lbe_rec_reader_next(r, &s) == 0);
+	CHECK(lbe_rec_reader_seek_block(r, nindex + 1) < 0);
+	last = entries[nindex - 1];
+	lbe_rec_reader_close(r);
+
+	// Torn final block: a key frame at the header offset reads on its own, so
+	// every cut of the last block must give an exact prefix and then the end
+	for (long cut = 0; cut < (long)last.length; cut++) {
+		int n;
+
+		copy_file(REC_PATH, TORN_PATH, 0, LBE_REC_HEADER_SIZE, "wb");
+		copy_file(REC_PATH, TORN_PATH, (long)last.offset, cut, "ab");
+		n = read_samples(TORN_PATH, block_start[nindex - 1]);
+		if (n < 0 || n > (int)last.samples) {
+			fprintf(stderr, "torn block cut at %ld: read %d\n", cut, n);
+			CHECK(0);
+			break;
+		}
+	}
+	remove_recording(TORN_PATH);
+
+	// Crash before the last index entry: the reader finds the tail past the
+	// index, and appending drops it and carries on where the index stops
+	copy_file(idx_path, TORN_PATH, 0, (long)((nindex - 1) * LBE_REC_INDEX_ENTRY_SIZE), "wb");
+	copy_file(TORN_PATH, idx_path, 0, -1, "wb");
+	remove(TORN_PATH);
+	r = lbe_rec_reader_open(REC_PATH);
+	CHECK(r != NULL);
+	if (r) {
+		CHECK(lbe_rec_reader_index(r, &entries) == nindex - 1);
+		CHECK(lbe_rec_reader_seek_block(r, nindex - 1) == 0);
+		CHECK(lbe_rec_reader_next(r, &s) == 1 && same_sample(&s, &samples[block_start[nindex - 1]]));
+		lbe_rec_reader_close(r);
+	}
+	CHECK(write_samples(REC_PATH, block_start[nindex - 1], (int)last.samples) == 0);
+	CHECK(read_samples(REC_PATH, 0) == REC_SAMPLES);
+
+	// A recording of the other model is not appended to
+	CHECK(lbe_rec_writer_open(REC_PATH, LBE_1420) == NULL);
+
+	remove_recording(REC_PATH);
+	return lbe_test_done("test_record");
+}
@@ -0,0 +1,72 @@
+/*
+ * lbe_parse_utc(): accepted forms and the input it has to reject.
+ */
+
+#include "lbe_clock.h"
+#include "lbe_schedule.h"
+#include "lbe_test.h"
+
+static void expect(const char *text, uint64_t real_ns) {
+	uint64_t got = 0;
+
+	if (lbe_parse_utc(text, &got) < 0 || got != real_ns) {
+		fprintf(stderr, "\"%s\": got %llu, expected %llu\n", text,
+			(unsigned long long)got, (unsigned long long)real_ns);
+		CHECK(0);
+	}
+}
+
+static void reject(const char *text) {
+	uint64_t got;
+
+	if (lbe_parse_utc(text, &got) == 0) {
+		fprintf(stderr, "\"%s\" accepted\n", text);
+		CHECK(0);
+	}
+}
+
+int main(void) {
+	uint64_t now, got = 0;
+
+	lbe_test_init();
+
+	expect("1970-01-01T00:00:00Z", 0);
+	expect("2026-10-17T12:00:00Z", 1792238400000000000ULL);
+	expect("2026-10-17T12:00:00.25Z", 1792238400250000000ULL);
+	expect("2026-10-17 12:00:00", 1792238400000000000ULL);
+	expect("2026-10-17T12:00:00.000000001", 1792238400000000001ULL);
+	expect("2024-02-29T00:00:00Z", 1709164800000000000ULL);
+	// A leap second reads as the first second of the next minute
+	expect("2026-12-31T23:59:60Z", 1798761600000000000ULL);
+	expect("@0", 0);
+	expect("@1.5", 1500000000ULL);
+	expect("@1792238400", 1792238400000000000ULL);
+
+	reject("");
+	reject("2026-10-17");
+	reject("2026-10-17T12:00");
+	reject("2026-02-30T00:00:00Z");
+	reject("2025-02-29T00:00:00Z");
+	reject("2026-13-01T00:00:00Z");
+	reject("2026-00-10T00:00:00Z");
+	reject("2026-10-32T00:00:00Z");
+	reject("2026-10-17T24:00:00Z");
+	reject("2026-10-17T12:60:00Z");
+	reject("2026-10-17T12:00:61Z");
+	reject("2026-10-17T12:00:00Zjunk");
+	reject("2026-10-17T12:00:00 ");
+	reject("2026-10-17X12:00:00");
+	reject("1960-01-01T00:00:00Z");
+	reject("@-1");
+	reject("@1e30");
+	reject("@12abc");
+	reject("+");
+	reject("+-5");
+	reject("tomorrow");
+
+	now = lbe_clock_ns(CLOCK_REALTIME);
+	CHECK(lbe_parse_utc("+1", &got) == 0);
+	CHECK(got >= now + 1000000000ULL && got < now + 3000000000ULL);
+
+	return lbe_test_done("test_schedule");
+}